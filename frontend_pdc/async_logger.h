@@ -0,0 +1,417 @@
+#ifndef ASYNC_LOGGER_H
+#define ASYNC_LOGGER_H
+
+// Asynchronous, level-gated logger for the PMU simulator.
+//
+// Producers never format or write anything: a log call copies its arguments
+// in binary form (or, for PMU_LOG_HEX, the raw payload bytes) into a slot of
+// a bounded lock-free MPSC ring and returns. A background thread drains the
+// ring, renders "{}" placeholders / hex dumps and writes to stdout (stderr
+// for warnings and errors). When the ring is full records are dropped and
+// counted rather than blocking the caller.
+//
+// Levels are gated twice: PMU_LOG_COMPILE_LEVEL removes calls below it at
+// compile time, the runtime level (setLevel) costs one relaxed load and one
+// branch per call.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <type_traits>
+
+enum class LogLevel : uint8_t {
+    Trace = 0,
+    Debug = 1,
+    Info = 2,
+    Warn = 3,
+    Error = 4,
+    Off = 5
+};
+
+#ifndef PMU_LOG_COMPILE_LEVEL
+#define PMU_LOG_COMPILE_LEVEL 0  // Trace: everything compiled in
+#endif
+
+constexpr bool log_level_compiled(int level) { return level >= PMU_LOG_COMPILE_LEVEL; }
+
+inline bool parse_log_level(const std::string& text, LogLevel& level) {
+    static const char* const NAMES[] = {"trace", "debug", "info", "warn", "error", "off"};
+    for (int i = 0; i <= static_cast<int>(LogLevel::Off); ++i) {
+        if (text == NAMES[i]) {
+            level = static_cast<LogLevel>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Formats an integer argument as hex digits: PMU_LOG_DEBUG("CMD 0x{}", LogHex{cmd}).
+struct LogHex {
+    uint64_t value;
+};
+
+// --- Argument encoding ---
+namespace log_detail {
+
+template<typename T>
+struct is_log_string : std::integral_constant<bool,
+    std::is_same<T, const char*>::value || std::is_same<T, char*>::value ||
+    std::is_same<T, std::string>::value> {};
+
+template<typename T>
+struct is_log_fixed : std::integral_constant<bool,
+    std::is_arithmetic<T>::value || std::is_enum<T>::value || std::is_same<T, LogHex>::value> {};
+
+// Bytes an argument needs no matter how much string data fits.
+template<typename T>
+constexpr size_t fixed_size() {
+    static_assert(is_log_string<T>::value || is_log_fixed<T>::value, "unsupported log argument type");
+    return is_log_string<T>::value ? sizeof(uint16_t) : sizeof(T);
+}
+
+struct Writer {
+    unsigned char* p;
+    size_t used;
+    size_t cap;
+    size_t fixedLeft;  // Still owed to the remaining arguments
+
+    void putString(const char* s, size_t n) {
+        fixedLeft -= sizeof(uint16_t);
+        size_t room = cap - used - sizeof(uint16_t) - fixedLeft;
+        uint16_t len = static_cast<uint16_t>(std::min(n, std::min<size_t>(room, 0xFFFF)));
+        std::memcpy(p + used, &len, sizeof(len));
+        std::memcpy(p + used + sizeof(len), s, len);
+        used += sizeof(len) + len;
+    }
+
+    void put(const char* s) { putString(s ? s : "(null)", s ? std::strlen(s) : 6); }
+    void put(char* s) { put(static_cast<const char*>(s)); }
+    void put(const std::string& s) { putString(s.data(), s.size()); }
+
+    template<typename T>
+    typename std::enable_if<is_log_fixed<T>::value>::type put(const T& v) {
+        fixedLeft -= sizeof(T);
+        std::memcpy(p + used, &v, sizeof(T));
+        used += sizeof(T);
+    }
+};
+
+struct Reader {
+    const unsigned char* p;
+
+    template<typename T>
+    T fixed() {
+        T v;
+        std::memcpy(&v, p, sizeof(T));
+        p += sizeof(T);
+        return v;
+    }
+
+    void string(std::string& out) {
+        uint16_t len = fixed<uint16_t>();
+        out.append(reinterpret_cast<const char*>(p), len);
+        p += len;
+    }
+};
+
+inline void append_value(std::string& out, bool v) { out += v ? "true" : "false"; }
+inline void append_value(std::string& out, char v) { out += v; }
+inline void append_value(std::string& out, LogHex v) {
+    char buf[20];
+    std::snprintf(buf, sizeof(buf), "%llx", static_cast<unsigned long long>(v.value));
+    out += buf;
+}
+
+template<typename T>
+typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value>::type
+append_value(std::string& out, T v) {
+    using U = typename std::conditional<std::is_enum<T>::value, long long, T>::type;
+    out += std::to_string(static_cast<U>(v));
+}
+
+template<typename T>
+typename std::enable_if<std::is_floating_point<T>::value>::type
+append_value(std::string& out, T v) {
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%g", static_cast<double>(v));
+    out += buf;
+}
+
+// Copies fmt up to the next "{}", then renders the next argument there.
+template<typename T>
+void append_next(std::string& out, const char*& fmt, Reader& r) {
+    const char* mark = std::strstr(fmt, "{}");
+    if (mark) {
+        out.append(fmt, mark - fmt);
+        fmt = mark + 2;
+    }
+    if (is_log_string<T>::value)
+        r.string(out);
+    else
+        append_value(out, r.fixed<typename std::conditional<is_log_string<T>::value, char, T>::type>());
+}
+
+template<typename... Args>
+void format_record(std::string& out, const char* fmt, const unsigned char* payload) {
+    Reader r{payload};
+    int expand[] = {0, (append_next<Args>(out, fmt, r), 0)...};
+    (void)expand;
+    (void)r;
+    out += fmt;
+}
+
+} // namespace log_detail
+
+// --- Logger ---
+class AsyncLogger
+{
+public:
+    static constexpr size_t SLOT_COUNT = 4096;  // Power of two
+    static constexpr size_t PAYLOAD_BYTES = 480;
+
+    AsyncLogger() : slots(new Slot[SLOT_COUNT]) {
+        for (size_t i = 0; i < SLOT_COUNT; ++i)
+            slots[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+    ~AsyncLogger() { stop(); }
+
+    AsyncLogger(const AsyncLogger&) = delete;
+    AsyncLogger& operator=(const AsyncLogger&) = delete;
+
+    void start() {
+        if (drainer.joinable()) return;
+        running.store(true, std::memory_order_release);
+        drainer = std::thread([this]() { drainLoop(); });
+    }
+
+    // Writes out everything queued so far and joins the drain thread.
+    void stop() {
+        if (!drainer.joinable()) return;
+        running.store(false, std::memory_order_release);
+        drainer.join();
+    }
+
+    void setLevel(LogLevel level) { minLevel.store(static_cast<uint8_t>(level), std::memory_order_relaxed); }
+    LogLevel level() const { return static_cast<LogLevel>(minLevel.load(std::memory_order_relaxed)); }
+
+    bool enabled(LogLevel level) const {
+        return static_cast<uint8_t>(level) >= minLevel.load(std::memory_order_relaxed);
+    }
+
+    uint64_t droppedRecords() const { return dropped.load(std::memory_order_relaxed); }
+
+    // fmt must be a string literal (or otherwise outlive the logger); it is
+    // only read by the drain thread.
+    template<typename... Args>
+    void write(LogLevel level, const char* fmt, const Args&... args) {
+        static_assert(sum_fixed<typename std::decay<Args>::type...>() <= PAYLOAD_BYTES, "too many log arguments");
+        Slot* slot = claim();
+        if (!slot) return;
+        slot->level = level;
+        slot->format = fmt;
+        slot->formatter = &log_detail::format_record<typename std::decay<Args>::type...>;
+        log_detail::Writer w{slot->payload, 0, PAYLOAD_BYTES,
+                             sum_fixed<typename std::decay<Args>::type...>()};
+        int expand[] = {0, (w.put(args), 0)...};
+        (void)expand;
+        slot->length = static_cast<uint32_t>(w.used);
+        slot->totalLength = slot->length;
+        publish(slot);
+    }
+
+    // Payload is copied raw (truncated to PAYLOAD_BYTES) and hex-formatted
+    // by the drain thread.
+    void writeHex(LogLevel level, const char* label, const void* data, size_t len) {
+        Slot* slot = claim();
+        if (!slot) return;
+        size_t n = std::min(len, PAYLOAD_BYTES);
+        slot->level = level;
+        slot->format = label;
+        slot->formatter = nullptr;
+        std::memcpy(slot->payload, data, n);
+        slot->length = static_cast<uint32_t>(n);
+        slot->totalLength = static_cast<uint32_t>(len);
+        publish(slot);
+    }
+
+private:
+    using Formatter = void (*)(std::string&, const char*, const unsigned char*);
+
+    struct Slot {
+        std::atomic<size_t> seq;
+        int64_t timeNs;
+        LogLevel level;
+        const char* format;
+        Formatter formatter;  // nullptr: hex dump record
+        uint32_t length;
+        uint32_t totalLength;
+        unsigned char payload[PAYLOAD_BYTES];
+    };
+
+    template<typename... Args>
+    static constexpr size_t sum_fixed() {
+        size_t sizes[] = {0, log_detail::fixed_size<Args>()...};
+        size_t total = 0;
+        for (size_t s : sizes) total += s;
+        return total;
+    }
+
+    // Bounded MPSC queue (Vyukov): a slot is free for position pos when its
+    // sequence equals pos, and holds a record for the consumer at pos + 1.
+    Slot* claim() {
+        size_t pos = tail.load(std::memory_order_relaxed);
+        while (true) {
+            Slot& slot = slots[pos & (SLOT_COUNT - 1)];
+            size_t seq = slot.seq.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    slot.timeNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::system_clock::now().time_since_epoch()).count();
+                    return &slot;
+                }
+            }
+            else if (diff < 0) {
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return nullptr;
+            }
+            else {
+                pos = tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    void publish(Slot* slot) {
+        size_t pos = slot->seq.load(std::memory_order_relaxed);
+        slot->seq.store(pos + 1, std::memory_order_release);
+    }
+
+    void drainLoop() {
+        std::string line;
+        uint64_t reportedDrops = 0;
+        while (true) {
+            bool stopping = !running.load(std::memory_order_acquire);
+            size_t n = drain(line);
+            uint64_t drops = droppedRecords();
+            if (drops != reportedDrops) {
+                std::cerr << "[LOG] " << (drops - reportedDrops) << " record(s) dropped, ring full\n";
+                reportedDrops = drops;
+            }
+            if (n > 0) {
+                std::cout.flush();
+                continue;
+            }
+            if (stopping) break;
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        }
+        std::cout.flush();
+    }
+
+    size_t drain(std::string& line) {
+        size_t count = 0;
+        while (true) {
+            Slot& slot = slots[head & (SLOT_COUNT - 1)];
+            if (slot.seq.load(std::memory_order_acquire) != head + 1) break;
+
+            line.clear();
+            appendTime(line, slot.timeNs);
+            line += (slot.level <= LogLevel::Debug) ? "[DEBUG] " : "[PMU] ";
+            if (slot.formatter) {
+                slot.formatter(line, slot.format, slot.payload);
+            }
+            else {
+                appendHex(line, slot);
+            }
+            line += '\n';
+            (slot.level >= LogLevel::Warn ? std::cerr : std::cout) << line;
+
+            slot.seq.store(head + SLOT_COUNT, std::memory_order_release);
+            ++head;
+            ++count;
+        }
+        return count;
+    }
+
+    static void appendTime(std::string& out, int64_t ns) {
+        time_t sec = static_cast<time_t>(ns / 1000000000);
+        std::tm tm{};
+#ifdef _WIN32
+        gmtime_s(&tm, &sec);
+#else
+        gmtime_r(&sec, &tm);
+#endif
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), "%02d:%02d:%02d.%06d ", tm.tm_hour, tm.tm_min, tm.tm_sec,
+                      static_cast<int>((ns % 1000000000) / 1000));
+        out += buf;
+    }
+
+    static void appendHex(std::string& out, const Slot& slot) {
+        static const char DIGITS[] = "0123456789abcdef";
+        out += slot.format;
+        out += " (" + std::to_string(slot.totalLength) + " bytes): ";
+        for (uint32_t i = 0; i < slot.length; ++i) {
+            out += DIGITS[slot.payload[i] >> 4];
+            out += DIGITS[slot.payload[i] & 0x0F];
+            out += ' ';
+        }
+        if (slot.totalLength > slot.length) out += "...";
+    }
+
+    std::unique_ptr<Slot[]> slots;
+    alignas(64) std::atomic<size_t> tail{0};
+    alignas(64) size_t head = 0;  // Drain thread only
+    std::atomic<uint8_t> minLevel{static_cast<uint8_t>(LogLevel::Info)};
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<bool> running{false};
+    std::thread drainer;
+};
+
+// Process-wide logger used by the PMU_LOG_* macros; start() it in main().
+inline AsyncLogger pmuLogger;
+
+// Runs a logger for the lifetime of a scope, so every return path writes
+// out what was queued before it, errors on the way out included.
+class LoggerScope
+{
+public:
+    explicit LoggerScope(AsyncLogger& logger) : logger(logger) { logger.start(); }
+    ~LoggerScope() { logger.stop(); }
+
+    LoggerScope(const LoggerScope&) = delete;
+    LoggerScope& operator=(const LoggerScope&) = delete;
+
+private:
+    AsyncLogger& logger;
+};
+
+#define PMU_LOG(level, ...)                                                     \
+    do {                                                                        \
+        if (log_level_compiled(static_cast<int>(level)) &&                      \
+            pmuLogger.enabled(level))                                           \
+            pmuLogger.write(level, __VA_ARGS__);                                \
+    } while (0)
+
+#define PMU_LOG_HEX(level, label, data, len)                                    \
+    do {                                                                        \
+        if (log_level_compiled(static_cast<int>(level)) &&                      \
+            pmuLogger.enabled(level))                                           \
+            pmuLogger.writeHex(level, label, data, len);                        \
+    } while (0)
+
+#define PMU_LOG_TRACE(...) PMU_LOG(LogLevel::Trace, __VA_ARGS__)
+#define PMU_LOG_DEBUG(...) PMU_LOG(LogLevel::Debug, __VA_ARGS__)
+#define PMU_LOG_INFO(...)  PMU_LOG(LogLevel::Info, __VA_ARGS__)
+#define PMU_LOG_WARN(...)  PMU_LOG(LogLevel::Warn, __VA_ARGS__)
+#define PMU_LOG_ERROR(...) PMU_LOG(LogLevel::Error, __VA_ARGS__)
+
+#endif // ASYNC_LOGGER_H
@@ -1,6 +1,3 @@
-#define _WINSOCK_DEPRECATED_NO_WARNINGS
-#include <winsock2.h>
-#include <ws2tcpip.h>
 #include <iostream>
 #include <cstdint>
 #include <cstring>
@@ -15,36 +12,31 @@
 #include <algorithm>
 #include <thread>
 #include <chrono>
-
-#pragma comment(lib, "ws2_32.lib")
-
-#ifndef M_PI
-#define M_PI 3.14159265358979323846
-#endif
-
-// --- Constants based on IEEE C37.118.2 ---
-const uint8_t SYNC_DATA = 0xAA;
-const uint8_t SYNC_HDR = 0xAA;
-const uint8_t SYNC_CFG1 = 0xAA;
-const uint8_t SYNC_CFG2 = 0xAA;
-const uint8_t SYNC_CMD = 0xAA;
-
-const uint8_t TYPE_DATA = 0x01;
-const uint8_t TYPE_HDR = 0x11;
-const uint8_t TYPE_CFG1 = 0x21;
-const uint8_t TYPE_CFG2 = 0x31;
-const uint8_t TYPE_CMD = 0x41;
-
-const uint16_t CMD_TURN_OFF_TX = 0x0001;
-const uint16_t CMD_TURN_ON_TX = 0x0002;
-const uint16_t CMD_SEND_HDR = 0x0003;
-const uint16_t CMD_SEND_CFG1 = 0x0004;
-const uint16_t CMD_SEND_CFG2 = 0x0005;
+#include <unordered_map>
+#include <fstream>
+#include <memory>
+#include <limits>
+
+#include "c37118_layout.h"
+#include "crc_ccitt.h"
+#include "data_frame_encoder.h"
+#include "socket_compat.h"
+#include "socket_poller.h"
+#include "pmu_sim_engine.h"
+#include "udp_sender.h"
+#include "frame_scheduler.h"
+#include "async_logger.h"
+#include "c37118_framer.h"
+#include "frame_capture.h"
+#include "frame_publisher.h"
+#include "sim_frames.h"
+#include "sim_metrics.h"
 
 // --- Configuration ---
 const int PMU_ID_CODE = 1;
 const std::string STATION_NAME = "SIM_PMU_1       ";
 const uint16_t DATA_RATE = 50;
+const uint32_t TIME_BASE = 1000000; // FRACSEC resolution: microseconds
 
 const bool USE_FLOAT_FORMAT = true;
 const bool USE_POLAR_FORMAT = true;
@@ -53,461 +45,1359 @@ const uint16_t PHASOR_COUNT = 3;
 const uint16_t ANALOG_COUNT = 4;
 const uint16_t DIGITAL_COUNT = 0;
 
-uint16_t calculate_crc(const unsigned char* data, size_t len) {
-    uint16_t crc = 0xFFFF;
-    for (size_t i = 0; i < len; i++) {
-        crc = crc ^ (data[i] << 8);
-        for (int j = 0; j < 8; j++) {
-            if (crc & 0x8000)
-                crc = (crc << 1) ^ 0x1021;
-            else
-                crc = crc << 1;
-        }
-    }
-    return crc;
+const uint16_t TCP_PORT = 4712;
+const uint16_t UDP_PORT = 4713;
+
+// --- Options ---
+// tcp:   commands and data on the TCP connection (default)
+// udp:   commands on UDP port 4713, data to the command sender via UDP
+// mixed: commands and CFG-2 on TCP, data to the client's IP on the UDP port
+enum class TransportMode { Tcp, Udp, Mixed };
+
+// What happens to a TCP client whose send queue is full:
+// drop-oldest: queued frames not yet started make room for the new tick
+// drop-newest: the new tick is not queued for it
+// disconnect:  it is dropped once its queue is full or has not emptied for --max-lag-ms
+enum class OverloadPolicy { DropOldest, DropNewest, Disconnect };
+
+struct SimOptions {
+    TransportMode mode = TransportMode::Tcp;
+    uint16_t tcpPort = TCP_PORT;
+    uint16_t udpPort = UDP_PORT;
+    int multicastTtl = 1;
+    std::vector<sockaddr_in> udpDestinations;  // Spontaneous, always streaming
+
+    size_t pmuCount = 1;
+    uint16_t dataRate = DATA_RATE;
+    std::string pmuFile;
+    int workers = -1;  // -1 = one per spare core when hosting several PMUs
+    bool pinWorkers = true;
+    int jitterReportSec = 10;  // 0 = report only at shutdown
+    uint16_t metricsPort = 0;  // Prometheus endpoint on localhost, 0 = off
+    OverloadPolicy overload = OverloadPolicy::DropOldest;
+    size_t clientQueueBytes = 4u << 20;  // Send queue bound per TCP client
+    int maxLagMs = 2000;                 // Disconnect policy
+    LogLevel logLevel = LogLevel::Info;
+
+    std::string recordPath;    // Capture of every frame sent
+    std::string replayPath;    // Capture to send instead of simulated frames
+    double replaySpeed = 1.0;  // Multiple of the captured pace, 0 = as fast as possible
+    bool replayLoop = false;
+    bool restamp = false;      // Shift SOC of replayed frames to the present
+    std::string convertInput;  // Raw C37.118.2 stream to convert to convertOutput
+    std::string convertOutput;
+};
+
+void print_usage(const char* prog) {
+    std::cout << "Usage: " << prog << " [options]\n"
+              << "  --mode tcp|udp|mixed   Transport for data frames (default tcp)\n"
+              << "  --tcp-port N           TCP command/data port (default " << TCP_PORT << ")\n"
+              << "  --udp-port N           UDP port (default " << UDP_PORT << ")\n"
+              << "  --udp-dest HOST:PORT   Stream data spontaneously to HOST:PORT, unicast or\n"
+              << "                         multicast; may be repeated\n"
+              << "  --mcast-ttl N          Multicast TTL (default 1)\n"
+              << "  --pmus N               Number of virtual PMUs, IDCODE 1..N (default 1)\n"
+              << "  --rate N               Reporting rate of generated PMUs (default " << DATA_RATE << ")\n"
+              << "  --pmu-file PATH        PMU list, one 'idcode,name,rate,phasors,analogs,digitals'\n"
+              << "                         per line; overrides --pmus/--rate\n"
+              << "  --workers N            Encoder threads, 0 = encode on the network thread\n"
+              << "  --no-pin               Do not pin encoder threads to CPUs\n"
+              << "  --jitter-report N      Print the frame jitter histogram every N seconds,\n"
+              << "                         0 = only at shutdown (default 10)\n"
+              << "  --log-level LEVEL      trace|debug|info|warn|error|off (default info);\n"
+              << "                         debug adds hex dumps of every frame\n"
+              << "  --metrics-port N       Serve Prometheus metrics at http://127.0.0.1:N/metrics\n"
+              << "  --overload POLICY      drop-oldest|drop-newest|disconnect: what a TCP client that\n"
+              << "                         falls behind loses (default drop-oldest)\n"
+              << "  --client-queue-kb N    Send queue bound per TCP client (default 4096)\n"
+              << "  --max-lag-ms N         disconnect: longest a client may stay behind (default 2000)\n"
+              << "  --record PATH          Capture every frame sent, with its send time\n"
+              << "  --replay PATH          Send the frames of a capture instead of simulating;\n"
+              << "                         the PMUs are the ones configured in the capture\n"
+              << "  --speed X|max          Replay at X times the captured pace (default 1), or\n"
+              << "                         as fast as the sockets take frames\n"
+              << "  --loop                 Start the replay over at the end of the capture\n"
+              << "  --restamp              Shift SOC of replayed frames so they carry the present\n"
+              << "                         time; FRACSEC is kept\n"
+              << "  --convert RAW OUT      Convert a raw C37.118.2 byte stream to a capture and exit\n";
 }
 
-void append_uint16_be(std::vector<unsigned char>& buffer, uint16_t value) {
-    buffer.push_back((value >> 8) & 0xFF);
-    buffer.push_back(value & 0xFF);
+bool parse_endpoint(const std::string& text, sockaddr_in& addr) {
+    size_t colon = text.rfind(':');
+    if (colon == std::string::npos) return false;
+    std::string host = text.substr(0, colon);
+    int port = std::atoi(text.c_str() + colon + 1);
+    if (port <= 0 || port > 65535) return false;
+
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<uint16_t>(port));
+    return inet_pton(AF_INET, host.c_str(), &addr.sin_addr) == 1;
 }
 
-void append_int16_be(std::vector<unsigned char>& buffer, int16_t value) {
-    append_uint16_be(buffer, static_cast<uint16_t>(value));
+bool parse_options(int argc, char** argv, SimOptions& opts) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--mode" && hasValue) {
+            std::string mode = argv[++i];
+            if (mode == "tcp") opts.mode = TransportMode::Tcp;
+            else if (mode == "udp") opts.mode = TransportMode::Udp;
+            else if (mode == "mixed") opts.mode = TransportMode::Mixed;
+            else return false;
+        }
+        else if (arg == "--tcp-port" && hasValue) {
+            opts.tcpPort = static_cast<uint16_t>(std::atoi(argv[++i]));
+        }
+        else if (arg == "--udp-port" && hasValue) {
+            opts.udpPort = static_cast<uint16_t>(std::atoi(argv[++i]));
+        }
+        else if (arg == "--udp-dest" && hasValue) {
+            sockaddr_in addr;
+            if (!parse_endpoint(argv[++i], addr)) {
+                PMU_LOG_ERROR("Invalid UDP destination: {}", argv[i]);
+                return false;
+            }
+            opts.udpDestinations.push_back(addr);
+        }
+        else if (arg == "--mcast-ttl" && hasValue) {
+            opts.multicastTtl = std::atoi(argv[++i]);
+        }
+        else if (arg == "--pmus" && hasValue) {
+            int n = std::atoi(argv[++i]);
+            if (n <= 0 || n > 65534) return false;
+            opts.pmuCount = static_cast<size_t>(n);
+        }
+        else if (arg == "--rate" && hasValue) {
+            int rate = std::atoi(argv[++i]);
+            if (rate <= 0 || rate > 1000) return false;
+            opts.dataRate = static_cast<uint16_t>(rate);
+        }
+        else if (arg == "--pmu-file" && hasValue) {
+            opts.pmuFile = argv[++i];
+        }
+        else if (arg == "--workers" && hasValue) {
+            opts.workers = std::max(0, std::atoi(argv[++i]));
+        }
+        else if (arg == "--no-pin") {
+            opts.pinWorkers = false;
+        }
+        else if (arg == "--jitter-report" && hasValue) {
+            opts.jitterReportSec = std::max(0, std::atoi(argv[++i]));
+        }
+        else if (arg == "--metrics-port" && hasValue) {
+            int port = std::atoi(argv[++i]);
+            if (port <= 0 || port > 65535) return false;
+            opts.metricsPort = static_cast<uint16_t>(port);
+        }
+        else if (arg == "--overload" && hasValue) {
+            std::string policy = argv[++i];
+            if (policy == "drop-oldest") opts.overload = OverloadPolicy::DropOldest;
+            else if (policy == "drop-newest") opts.overload = OverloadPolicy::DropNewest;
+            else if (policy == "disconnect") opts.overload = OverloadPolicy::Disconnect;
+            else return false;
+        }
+        else if (arg == "--client-queue-kb" && hasValue) {
+            int kb = std::atoi(argv[++i]);
+            if (kb < 64) return false;
+            opts.clientQueueBytes = static_cast<size_t>(kb) << 10;
+        }
+        else if (arg == "--max-lag-ms" && hasValue) {
+            opts.maxLagMs = std::atoi(argv[++i]);
+            if (opts.maxLagMs <= 0) return false;
+        }
+        else if (arg == "--log-level" && hasValue) {
+            if (!parse_log_level(argv[++i], opts.logLevel)) return false;
+        }
+        else if (arg == "--record" && hasValue) {
+            opts.recordPath = argv[++i];
+        }
+        else if (arg == "--replay" && hasValue) {
+            opts.replayPath = argv[++i];
+        }
+        else if (arg == "--speed" && hasValue) {
+            std::string speed = argv[++i];
+            if (speed == "max") {
+                opts.replaySpeed = 0.0;
+                continue;
+            }
+            opts.replaySpeed = std::atof(speed.c_str());
+            if (!(opts.replaySpeed > 0.0)) return false;
+        }
+        else if (arg == "--loop") {
+            opts.replayLoop = true;
+        }
+        else if (arg == "--restamp") {
+            opts.restamp = true;
+        }
+        else if (arg == "--convert" && i + 2 < argc) {
+            opts.convertInput = argv[++i];
+            opts.convertOutput = argv[++i];
+        }
+        else {
+            return false;
+        }
+    }
+    return true;
 }
 
-void append_uint32_be(std::vector<unsigned char>& buffer, uint32_t value) {
-    buffer.push_back((value >> 24) & 0xFF);
-    buffer.push_back((value >> 16) & 0xFF);
-    buffer.push_back((value >> 8) & 0xFF);
-    buffer.push_back(value & 0xFF);
+std::string endpoint_string(const sockaddr_in& addr) {
+    char ip[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &addr.sin_addr, ip, INET_ADDRSTRLEN);
+    return std::string(ip) + ":" + std::to_string(ntohs(addr.sin_port));
 }
 
-void append_float32_be(std::vector<unsigned char>& buffer, float value) {
-    union {
-        float f;
-        uint32_t i;
-    } u;
-    u.f = value;
-    append_uint32_be(buffer, u.i);
+VirtualPmuConfig make_pmu_config(uint16_t idCode, const std::string& name, uint16_t dataRate,
+                                 uint16_t phnmr, uint16_t annmr, uint16_t dgnmr) {
+    VirtualPmuConfig cfg;
+    cfg.idCode = idCode;
+    cfg.stationName = name;
+    cfg.stationName.resize(16, ' ');
+    cfg.dataRate = dataRate;
+    cfg.nominalFreq = nominal_frequency(dataRate);
+    cfg.phnmr = phnmr;
+    cfg.annmr = annmr;
+    cfg.dgnmr = dgnmr;
+    cfg.floatFmt = USE_FLOAT_FORMAT;
+    cfg.polarFmt = USE_POLAR_FORMAT;
+    return cfg;
 }
 
-void append_bytes(std::vector<unsigned char>& buffer, const void* data, size_t length) {
-    const unsigned char* byte_data = static_cast<const unsigned char*>(data);
-    buffer.insert(buffer.end(), byte_data, byte_data + length);
+bool load_pmu_configs(const SimOptions& opts, std::vector<VirtualPmuConfig>& pmus) {
+    pmus.clear();
+    if (opts.pmuFile.empty()) {
+        if (opts.pmuCount == 1) {
+            pmus.push_back(make_pmu_config(PMU_ID_CODE, STATION_NAME, opts.dataRate,
+                                           PHASOR_COUNT, ANALOG_COUNT, DIGITAL_COUNT));
+            return true;
+        }
+        for (size_t i = 0; i < opts.pmuCount; ++i) {
+            uint16_t id = static_cast<uint16_t>(i + 1);
+            pmus.push_back(make_pmu_config(id, "SIM_PMU_" + std::to_string(id), opts.dataRate,
+                                           PHASOR_COUNT, ANALOG_COUNT, DIGITAL_COUNT));
+        }
+        return true;
+    }
+
+    std::ifstream in(opts.pmuFile);
+    if (!in) {
+        PMU_LOG_ERROR("Cannot open PMU file {}", opts.pmuFile);
+        return false;
+    }
+    std::string line;
+    int lineNo = 0;
+    while (std::getline(in, line)) {
+        ++lineNo;
+        if (line.empty() || line[0] == '#') continue;
+        std::stringstream ss(line);
+        std::string field;
+        std::vector<std::string> fields;
+        while (std::getline(ss, field, ','))
+            fields.push_back(field);
+        if (fields.size() != 6) {
+            PMU_LOG_ERROR("{}:{}: expected 6 fields", opts.pmuFile, lineNo);
+            return false;
+        }
+        int id = std::atoi(fields[0].c_str());
+        int rate = std::atoi(fields[2].c_str());
+        if (id <= 0 || id >= 0xFFFF || rate <= 0 || rate > 1000) {
+            PMU_LOG_ERROR("{}:{}: invalid IDCODE or rate", opts.pmuFile, lineNo);
+            return false;
+        }
+        pmus.push_back(make_pmu_config(static_cast<uint16_t>(id), fields[1], static_cast<uint16_t>(rate),
+                                       static_cast<uint16_t>(std::atoi(fields[3].c_str())),
+                                       static_cast<uint16_t>(std::atoi(fields[4].c_str())),
+                                       static_cast<uint16_t>(std::atoi(fields[5].c_str()))));
+    }
+    if (pmus.empty()) {
+        PMU_LOG_ERROR("{} lists no PMUs", opts.pmuFile);
+        return false;
+    }
+    return true;
 }
 
-std::vector<unsigned char> create_config_frame2(
-    uint16_t pmuId,
-    uint32_t timeBase,
-    uint16_t numPmu,
-    const std::string& stnName,
-    uint16_t dataRate,
-    uint16_t phnmr,
-    uint16_t annmr,
-    uint16_t dgnmr,
-    bool floatFmt, bool polarFmt)
-{
-    std::vector<unsigned char> frame;
-    frame.reserve(300);
+// --- Capture replay ---
+// A replay serves the configuration frames at the start of a capture as its
+// PMUs and sends the records after them in their captured rhythm: each group
+// of records sharing a TIME is one tick, due at
+//   anchorWall + (TIME - anchorCapture) / speed.
+// The anchor is taken when streaming starts and on every pass of a looped
+// replay. --restamp shifts SOC by whole seconds, which keeps frames on their
+// nominal instants; at 1x the anchor waits for that shifted time so frames go
+// out when their new timestamp comes up. Frames are sent straight from the
+// mapped file unless restamped.
+struct ReplaySession {
+    static const size_t MAX_BURST_TICKS = 64;  // Per wakeup at --speed max
+
+    struct ConfigRecord {
+        const unsigned char* frame;
+        size_t len;
+    };
+
+    CaptureFile file;
+    double speed = 1.0;
+    bool loop = false;
+    bool restamp = false;
+    std::vector<ConfigRecord> configs;   // Per PMU index
+    size_t dataBegin = 0;                // Offset of the first record after the configurations
+    size_t cursor = 0;                   // Offset of the next record to send
+    int64_t passFirstNs = 0;             // TIME of the first and last record sent in this pass
+    int64_t passLastNs = 0;
+    int64_t anchorWallNs = 0;
+    int64_t anchorCaptureNs = 0;
+    int64_t socShift = 0;                // Seconds added to SOC when restamping
+    int64_t minSocShift = 0;             // Keeps restamped time increasing across passes
+    std::vector<EncodedFrame> frames;    // Frames of the ticks being sent
+    std::vector<unsigned char> scratch;  // Restamped copies
+    uint64_t framesSent = 0;
+    uint64_t bytesSent = 0;
+    uint64_t skippedFrames = 0;          // IDCODE without a configuration
+    int64_t startedNs = 0;
+};
+
+int64_t ceil_seconds(int64_t ns) {
+    int64_t s = ns / 1000000000;
+    if (s * 1000000000 < ns) ++s;
+    return s;
+}
 
-    frame.push_back(SYNC_CFG2);
-    frame.push_back(TYPE_CFG2);
-    append_uint16_be(frame, 0); // Placeholder for FRAMESIZE
-    append_uint16_be(frame, pmuId);
-    time_t now_soc = time(NULL);
-    append_uint32_be(frame, static_cast<uint32_t>(now_soc));
-    append_uint32_be(frame, 0); // FRACSEC
+// PMU list entry for a captured configuration frame; the frame itself is
+// served verbatim, so only what the server looks up (IDCODE, rate) matters.
+bool replay_pmu_config(const unsigned char* frame, size_t len, VirtualPmuConfig& cfg) {
+    if (len < 54) return false;
+    uint16_t format = load_be16(frame + 38);
+    int16_t rate = static_cast<int16_t>(load_be16(frame + len - 4));
+    cfg.idCode = load_be16(frame + 4);
+    cfg.stationName.assign(reinterpret_cast<const char*>(frame + 20), 16);
+    cfg.dataRate = static_cast<uint16_t>(std::max<int16_t>(1, rate));  // Negative: seconds per frame
+    cfg.nominalFreq = nominal_frequency(cfg.dataRate);
+    cfg.phnmr = load_be16(frame + 40);
+    cfg.annmr = load_be16(frame + 42);
+    cfg.dgnmr = load_be16(frame + 44);
+    cfg.floatFmt = (format & (FORMAT_PHASOR_FLOAT | FORMAT_ANALOG_FLOAT | FORMAT_FREQ_FLOAT)) ==
+                   (FORMAT_PHASOR_FLOAT | FORMAT_ANALOG_FLOAT | FORMAT_FREQ_FLOAT);
+    cfg.polarFmt = (format & FORMAT_POLAR) != 0;
+    return true;
+}
 
-    append_uint32_be(frame, timeBase);
-    append_uint16_be(frame, numPmu);
+// Maps the capture and takes its PMUs from the configuration frames it
+// starts with.
+bool open_replay(const SimOptions& opts, ReplaySession& replay, std::vector<VirtualPmuConfig>& pmus) {
+    if (!replay.file.open(opts.replayPath)) {
+        PMU_LOG_ERROR("Cannot open capture {}", opts.replayPath);
+        return false;
+    }
+    replay.speed = opts.replaySpeed;
+    replay.loop = opts.replayLoop;
+    replay.restamp = opts.restamp;
 
-    std::string fixedStnName = stnName;
-    fixedStnName.resize(16, ' ');
-    append_bytes(frame, fixedStnName.c_str(), 16);
-    append_uint16_be(frame, pmuId);
+    pmus.clear();
+    size_t offset = replay.file.begin();
+    CaptureRecord record;
+    while (true) {
+        size_t at = offset;
+        if (!replay.file.next(offset, record) || !is_config_frame(record.frame)) {
+            offset = at;
+            break;
+        }
+        VirtualPmuConfig cfg;
+        if (!replay_pmu_config(record.frame, record.len, cfg)) continue;
+        auto it = std::find_if(pmus.begin(), pmus.end(),
+                               [&](const VirtualPmuConfig& p) { return p.idCode == cfg.idCode; });
+        if (it == pmus.end()) {
+            pmus.push_back(cfg);
+            replay.configs.push_back({record.frame, record.len});
+        }
+        else {
+            *it = cfg;
+            replay.configs[it - pmus.begin()] = {record.frame, record.len};
+        }
+    }
+    if (pmus.empty()) {
+        PMU_LOG_ERROR("{} does not start with configuration frames", opts.replayPath);
+        return false;
+    }
+    replay.dataBegin = replay.cursor = offset;
+    if (!replay.file.next(offset, record)) {
+        PMU_LOG_ERROR("{} holds no frames after its configuration frames", opts.replayPath);
+        return false;
+    }
+    PMU_LOG_INFO("Replaying {} ({} MB) for {} PMU(s) at {}.", opts.replayPath,
+                 replay.file.byteSize() >> 20, pmus.size(),
+                 replay.speed > 0.0 ? std::to_string(replay.speed) + "x" : std::string("maximum speed"));
+    return true;
+}
 
-    uint16_t format = 0;
-    if (floatFmt) format |= (1 << 0);  // Data in float
-    if (polarFmt) format |= (1 << 1);  // Phasors in polar
-    if (floatFmt) format |= (1 << 2);  // Phasor format float
-    if (floatFmt) format |= (1 << 3);  // Analog format float
-    if (floatFmt) format |= (1 << 4);  // Freq/ROCOF float
-    append_uint16_be(frame, format);
+// Anchors the captured times of the records from the cursor on to nowNs.
+void anchor_replay(ReplaySession& replay, int64_t nowNs) {
+    CaptureRecord record;
+    size_t offset = replay.cursor;
+    if (!replay.file.next(offset, record)) return;
+    int64_t shift = ceil_seconds(nowNs - record.timeNs);
+    replay.anchorCaptureNs = record.timeNs;
+    // Restamped at 1x, frames leave when their new SOC comes up.
+    bool live = replay.restamp && replay.speed == 1.0;
+    replay.anchorWallNs = live ? record.timeNs + shift * 1000000000 : nowNs;
+    replay.socShift = std::max(shift, replay.minSocShift);
+    if (replay.startedNs == 0) replay.startedNs = nowNs;
+}
 
-    append_uint16_be(frame, phnmr);
-    append_uint16_be(frame, annmr);
-    append_uint16_be(frame, dgnmr);
+// Send time of the next tick; INT64_MAX at the end of the capture.
+int64_t replay_deadline(const ReplaySession& replay, int64_t nowNs) {
+    CaptureRecord record;
+    size_t offset = replay.cursor;
+    if (!replay.file.next(offset, record)) return replay.loop ? nowNs : INT64_MAX;
+    if (replay.speed <= 0.0) return nowNs;
+    return replay.anchorWallNs + static_cast<int64_t>((record.timeNs - replay.anchorCaptureNs) / replay.speed);
+}
 
-    for (uint16_t i = 0; i < phnmr; ++i) {
-        std::string name = "Phasor " + std::to_string(i + 1);
-        name.resize(16, ' ');
-        append_bytes(frame, name.c_str(), 16);
-    }
-    for (uint16_t i = 0; i < annmr; ++i) {
-        std::string name = "Analog " + std::to_string(i + 1);
-        name.resize(16, ' ');
-        append_bytes(frame, name.c_str(), 16);
+// Collects the frames of the next tick (up to MAX_BURST_TICKS at maximum
+// speed) into replay.frames. Returns false at the end of an unlooped capture.
+// At the end of a looped capture the next pass is anchored to nowNs; a paced
+// replay then returns without frames and waits for its first tick.
+bool next_replay_ticks(ReplaySession& replay, const PmuSimEngine& engine, int64_t nowNs) {
+    replay.frames.clear();
+    size_t ticks = 0;
+    size_t maxTicks = replay.speed > 0.0 ? 1 : ReplaySession::MAX_BURST_TICKS;
+    bool wrapped = false;
+    CaptureRecord record;
+    while (ticks < maxTicks) {
+        size_t offset = replay.cursor;
+        if (!replay.file.next(offset, record)) {
+            if (!replay.loop || replay.cursor == replay.dataBegin) break;
+            // The next pass is stamped at least one capture length later.
+            replay.minSocShift = replay.socShift + ceil_seconds(replay.passLastNs - replay.passFirstNs + 1);
+            replay.cursor = replay.dataBegin;
+            anchor_replay(replay, nowNs);
+            wrapped = true;
+            if (replay.speed > 0.0) break;
+            continue;
+        }
+        if (replay.cursor == replay.dataBegin) replay.passFirstNs = record.timeNs;
+        int64_t tickNs = record.timeNs;
+        do {
+            replay.cursor = offset;
+            size_t pmu = engine.findPmu(load_be16(record.frame + 4));
+            if (pmu == engine.pmuCount()) ++replay.skippedFrames;
+            else replay.frames.push_back({record.frame, record.len, pmu});
+        } while (replay.file.next(offset, record) && record.timeNs == tickNs);
+        replay.passLastNs = tickNs;
+        ++ticks;
     }
 
-    for (uint16_t i = 0; i < phnmr; ++i) {
-        uint32_t phunit = (i == 0) ? 0x00000001 : 0x01000001; // Volt: 1V, Current: 0.01A
-        append_uint32_be(frame, phunit);
+    if (replay.restamp) {
+        size_t total = 0;
+        for (const EncodedFrame& frame : replay.frames) total += frame.len;
+        replay.scratch.resize(total);
+        unsigned char* out = replay.scratch.data();
+        for (EncodedFrame& frame : replay.frames) {
+            std::memcpy(out, frame.data, frame.len);
+            shift_frame_soc(out, frame.len, replay.socShift);
+            frame.data = out;
+            out += frame.len;
+        }
     }
+    for (const EncodedFrame& frame : replay.frames) replay.bytesSent += frame.len;
+    replay.framesSent += replay.frames.size();
+    return ticks > 0 || wrapped;
+}
 
-    for (uint16_t i = 0; i < annmr; ++i) {
-        append_uint32_be(frame, 0x00000064); // 100 units
-    }
+void report_replay(const ReplaySession& replay) {
+    double seconds = std::max(1e-9, (realtime_ns() - replay.startedNs) / 1e9);
+    PMU_LOG_INFO("Replayed {} frames ({} bytes) in {} s: {} frames/s, {} MB/s; {} frames without a configuration skipped.",
+                 replay.framesSent, replay.bytesSent, seconds,
+                 static_cast<uint64_t>(replay.framesSent / seconds),
+                 replay.bytesSent / seconds / 1e6, replay.skippedFrames);
+}
+
+// --- Server ---
+// Received command bytes buffered per client; bounds the longest frame.
+const size_t COMMAND_BUFFER_SIZE = 4096;
+
+// A UDP data destination enabled via commands, sent the PMUs it holds a
+// reference on. In mixed mode every TCP client on one host maps to the same
+// target, so a PMU stays on until the last of them turns it off.
+struct UdpSubscriber {
+    sockaddr_in addr;
+    std::vector<uint32_t> refs;  // Per PMU index
+    size_t pmuCount = 0;         // PMUs with refs > 0
+};
+
+struct PmuClient {
+    SOCKET sock = INVALID_SOCKET;
+    sockaddr_in addr{};
+    std::string peer;
+    std::vector<char> subscribed;         // Per PMU index: data stream on
+    size_t subscribedCount = 0;
+    FrameQueue tx;                        // Shared frames not yet sent
+    bool waitingWritable = false;         // tx left over; the poller watches for room
+    int64_t behindSinceNs = 0;            // tx non-empty after every send since, 0 = caught up
+    uint64_t shedFrames = 0;
+    StreamFramer framer{COMMAND_BUFFER_SIZE};
+    uint64_t countedCrcErrors = 0;        // framer.crcErrors() already in the metrics
+
+    bool dataStreamActive() const { return subscribedCount > 0; }
+};
+
+struct PmuServer {
+    SimOptions opts;
+    std::unique_ptr<PmuSimEngine> engine;
+    SOCKET listenSocket = INVALID_SOCKET;
+    SocketPoller poller;
+    UdpDataSender udp;
+    std::unique_ptr<ReplaySession> replay;  // --replay; its mapping outlives the queues referencing it
+    FramePublisher publisher;               // Declared before the clients that hold its buffers
+    std::vector<IoSlice> txSlices;          // Scratch for one client's gather write
+    std::unordered_map<SOCKET, PmuClient> clients;
+    std::vector<UdpSubscriber> udpSubscribers;  // Enabled via commands (udp/mixed)
+    StreamFramer udpFramer{COMMAND_BUFFER_SIZE};
+    CaptureWriter capture;                  // --record
+    std::unique_ptr<SimMetrics> metrics;    // --metrics-port
+    MetricsShard* stats = nullptr;          // The network thread's shard, null without metrics
+    std::vector<uint32_t> tcpSubscribers;   // Per PMU index, TCP clients streaming it
+    std::vector<uint32_t> udpStreams;       // Per PMU index, UDP destinations sent it
+    uint64_t udpCountedCrcErrors = 0;
+    uint64_t shedFrames = 0;                // From all clients, --overload
+    uint64_t overloadDisconnects = 0;
+};
+
+std::vector<unsigned char> make_config_frame(const VirtualPmuConfig& pmu) {
+    return create_config_frame2(
+        pmu.idCode, TIME_BASE, 1, pmu.stationName, pmu.dataRate,
+        pmu.phnmr, pmu.annmr, pmu.dgnmr,
+        pmu.floatFmt, pmu.polarFmt);
+}
 
-    uint16_t fnom_code = (dataRate == 60) ? 1 : 0;
-    append_uint16_be(frame, fnom_code);
-    append_uint16_be(frame, 0); // CFGCNT
-    append_uint16_be(frame, dataRate);
+// CFG-2 of PMU i: generated, or as captured when replaying.
+std::vector<unsigned char> config_frame(const PmuServer& server, size_t i) {
+    if (server.replay) {
+        const ReplaySession::ConfigRecord& cfg = server.replay->configs[i];
+        return std::vector<unsigned char>(cfg.frame, cfg.frame + cfg.len);
+    }
+    return make_config_frame(server.engine->pmu(i));
+}
 
-    uint16_t frameSize = static_cast<uint16_t>(frame.size() + 2);
-    frame[2] = (frameSize >> 8) & 0xFF;
-    frame[3] = frameSize & 0xFF;
+// CFG-2 of PMU i as sent to a client: stamped with the present time, except
+// a replay's captured one, which is sent as captured unless --restamp.
+FrameRef current_config_frame(PmuServer& server, size_t i) {
+    if (server.replay && !server.replay->restamp) return server.publisher.configFrame(i);
+    int64_t now = realtime_ns();
+    return server.publisher.configFrameAt(i, static_cast<uint32_t>(now / 1000000000),
+                                          static_cast<uint32_t>(now % 1000000000 / (1000000000 / TIME_BASE)));
+}
 
-    uint16_t crc = calculate_crc(frame.data(), frame.size());
-    append_uint16_be(frame, crc);
+void dump_config_frame(const FrameRef& cfgFrame) {
+    PMU_LOG_HEX(LogLevel::Debug, "CFG-2 contents", cfgFrame.data(), cfgFrame.size());
+}
 
-    return frame;
+// Indices of the PMUs a command addresses: all for 0xFFFF, else the one
+// hosted PMU with that IDCODE, or none.
+void select_pmus(const PmuServer& server, uint16_t pmuId, std::vector<size_t>& targets) {
+    targets.clear();
+    if (pmuId != 0xFFFF) {
+        size_t index = server.engine->findPmu(pmuId);
+        if (index < server.engine->pmuCount()) targets.push_back(index);
+        return;
+    }
+    for (size_t i = 0; i < server.engine->pmuCount(); ++i)
+        targets.push_back(i);
 }
 
-float getRandomFloat(float min_val, float max_val) {
-    if (RAND_MAX == 0) return min_val;
-    float scale = static_cast<float>(rand()) / static_cast<float>(RAND_MAX);
-    return min_val + scale * (max_val - min_val);
+std::vector<UdpSubscriber>::iterator find_udp_subscriber(PmuServer& server, const sockaddr_in& addr) {
+    return std::find_if(server.udpSubscribers.begin(), server.udpSubscribers.end(),
+                        [&](const UdpSubscriber& s) { return same_endpoint(s.addr, addr); });
 }
 
-std::vector<unsigned char> create_data_frame(
-    uint16_t pmuId,
-    uint16_t phnmr, uint16_t annmr, uint16_t dgnmr,
-    bool floatFmt, bool polarFmt, uint16_t dataRate)
-{
-    std::vector<unsigned char> frame;
-    frame.reserve(128);
+// Takes (enable) or releases a reference on the given PMUs of a UDP data
+// destination; it is sent the frames of every PMU still referenced, and
+// removed when none is. Spontaneous destinations from the command line get
+// every PMU and are left alone.
+void reference_udp_subscriber(PmuServer& server, const sockaddr_in& addr, const std::vector<size_t>& pmus,
+                              bool enable) {
+    if (pmus.empty()) return;
+    auto it = find_udp_subscriber(server, addr);
+    if (it == server.udpSubscribers.end()) {
+        if (!enable) return;
+        server.udpSubscribers.push_back({addr, std::vector<uint32_t>(server.engine->pmuCount(), 0), 0});
+        it = server.udpSubscribers.end() - 1;
+    }
 
-    frame.push_back(SYNC_DATA);
-    frame.push_back(TYPE_DATA);
-    append_uint16_be(frame, 0); // Placeholder for FRAMESIZE
-    append_uint16_be(frame, pmuId);
+    bool spontaneous = std::any_of(server.opts.udpDestinations.begin(), server.opts.udpDestinations.end(),
+                                   [&](const sockaddr_in& a) { return same_endpoint(a, addr); });
+    size_t before = it->pmuCount;
+    for (size_t i : pmus) {
+        uint32_t& refs = it->refs[i];
+        if (enable && refs++ > 0) continue;
+        if (!enable && (refs == 0 || --refs > 0)) continue;
+        // PMU i just started or stopped going to addr.
+        if (enable) ++it->pmuCount;
+        else --it->pmuCount;
+        if (spontaneous) continue;
+        if (enable) ++server.udpStreams[i];
+        else --server.udpStreams[i];
+    }
+    size_t after = it->pmuCount;
+    if (after == before) return;
 
-    auto now = std::chrono::system_clock::now();
-    auto now_sec = std::chrono::system_clock::to_time_t(now);
-    auto duration = now.time_since_epoch();
-    auto subsec = std::chrono::duration_cast<std::chrono::microseconds>(duration) % 1000000;
+    if (after > 0 && !spontaneous) {
+        std::vector<char> wanted(it->refs.size(), 0);
+        for (size_t i = 0; i < wanted.size(); ++i) wanted[i] = it->refs[i] > 0;
+        server.udp.addDestination(addr, wanted);
+    }
+    if (after == 0) {
+        server.udpSubscribers.erase(it);
+        if (!spontaneous) server.udp.removeDestination(addr);
+    }
+    if (!spontaneous)
+        PMU_LOG_INFO("UDP data to {}: {} of {} PMU(s).", endpoint_string(addr), after, server.engine->pmuCount());
+}
 
-    uint32_t soc = static_cast<uint32_t>(now_sec);
-    uint32_t fracsec = static_cast<uint32_t>(subsec.count());
-    append_uint32_be(frame, soc);
-    append_uint32_be(frame, fracsec);
+// UDP mode: the sender of a command is one subscriber, each PMU on or off.
+void set_udp_subscription(PmuServer& server, const sockaddr_in& addr, const std::vector<size_t>& pmus,
+                          bool enable) {
+    auto it = find_udp_subscriber(server, addr);
+    std::vector<size_t> changed;
+    for (size_t i : pmus) {
+        bool on = it != server.udpSubscribers.end() && it->refs[i] > 0;
+        if (on != enable) changed.push_back(i);
+    }
+    reference_udp_subscriber(server, addr, changed, enable);
+}
 
-    uint16_t stat = 0;
-    stat |= (1 << 15); // Data valid
-    stat |= (1 << 14); // PMU sync
-    append_uint16_be(frame, stat);
+sockaddr_in mixed_mode_udp_target(const PmuServer& server, const PmuClient& client) {
+    sockaddr_in target = client.addr;
+    target.sin_port = htons(server.opts.udpPort);
+    return target;
+}
 
-    float nominal_mag = 230.0; // Nominal voltage magnitude
-    for (uint16_t i = 0; i < phnmr; ++i) {
-        float mag = nominal_mag + getRandomFloat(-5.0, 5.0);
-        float angle_deg = getRandomFloat(-180.0, 180.0);
-        float angle_rad = angle_deg * M_PI / 180.0;
+// In mixed mode the PMUs a client streams go to its UDP target instead.
+void set_stream_active(PmuServer& server, PmuClient& client, const std::vector<size_t>& pmus, bool active) {
+    if (client.subscribed.size() != server.engine->pmuCount())
+        client.subscribed.assign(server.engine->pmuCount(), 0);
+    std::vector<size_t> changed;
+    for (size_t i : pmus) {
+        if (static_cast<bool>(client.subscribed[i]) == active) continue;
+        client.subscribed[i] = active;
+        if (active) ++client.subscribedCount;
+        else --client.subscribedCount;
+        if (active) ++server.tcpSubscribers[i];
+        else --server.tcpSubscribers[i];
+        changed.push_back(i);
+    }
+    if (server.opts.mode == TransportMode::Mixed)
+        reference_udp_subscriber(server, mixed_mode_udp_target(server, client), changed, active);
+}
 
-        if (floatFmt && polarFmt) {
-            append_float32_be(frame, mag);      // Magnitude
-            append_float32_be(frame, angle_rad); // Angle in radians
+// Writes as much of the client's queue as the socket takes without blocking,
+// with one gather write; the rest goes out when the poller reports room.
+// Returns false if the client has to be dropped.
+bool flush_client(PmuServer& server, PmuClient& client) {
+    if (!client.tx.empty()) {
+        client.tx.gather(server.txSlices);
+        int64_t start = server.stats ? metrics_clock_ns() : 0;
+        long long bytesSent = send_gather(client.sock, server.txSlices.data(), server.txSlices.size());
+        if (bytesSent == SOCKET_ERROR) {
+            PMU_LOG_ERROR("Send to {} failed! Error: {}", client.peer, socket_last_error());
+            if (server.stats) server.stats->sendErrors.add();
+            client.tx.clear();
+            return false;
+        }
+        if (server.stats) {
+            server.stats->sendLatency[size_t(Transport::Tcp)].record(metrics_clock_ns() - start);
+            server.stats->bytesSent[size_t(Transport::Tcp)].add(static_cast<uint64_t>(bytesSent));
         }
+        client.tx.consume(static_cast<size_t>(bytesSent));
     }
 
-    float freq = (dataRate == 60 ? 60.0f : 50.0f) + getRandomFloat(-0.05f, 0.05f);
-    float rocof = getRandomFloat(-0.5f, 0.5f);
-    if (floatFmt) {
-        append_float32_be(frame, freq);
-        append_float32_be(frame, rocof);
+    bool backlog = !client.tx.empty();
+    if (backlog != client.waitingWritable) {
+        server.poller.modify(client.sock, backlog);
+        client.waitingWritable = backlog;
     }
+    if (!backlog) client.behindSinceNs = 0;
+    else if (client.behindSinceNs == 0) client.behindSinceNs = realtime_ns();
+    return true;
+}
 
-    for (uint16_t i = 0; i < annmr; ++i) {
-        float analog_val = getRandomFloat(0.0f, 10.0f);
-        if (floatFmt) {
-            append_float32_be(frame, analog_val);
-        }
+const char* overload_policy_name(OverloadPolicy policy) {
+    switch (policy) {
+    case OverloadPolicy::DropOldest: return "drop-oldest";
+    case OverloadPolicy::DropNewest: return "drop-newest";
+    default: return "disconnect";
     }
+}
 
-    uint16_t frameSize = static_cast<uint16_t>(frame.size() + 2);
-    frame[2] = (frameSize >> 8) & 0xFF;
-    frame[3] = frameSize & 0xFF;
-
-    uint16_t crc = calculate_crc(frame.data(), frame.size());
-    append_uint16_be(frame, crc);
+void count_shed_frames(PmuServer& server, PmuClient& client, size_t shed) {
+    if (shed == 0) return;
+    if (client.shedFrames == 0)
+        PMU_LOG_WARN("{} is falling behind, shedding frames ({}).", client.peer,
+                     overload_policy_name(server.opts.overload));
+    client.shedFrames += shed;
+    server.shedFrames += shed;
+    if (server.stats) server.stats->framesShed.add(shed);
+}
 
-    return frame;
+// Keeps the queue of a client that is behind within --client-queue-kb after
+// a tick was queued, as --overload says. Returns false if the client has to
+// be disconnected.
+bool apply_overload_policy(PmuServer& server, PmuClient& client, int64_t nowNs) {
+    const SimOptions& opts = server.opts;
+    bool full = client.tx.bytes() > opts.clientQueueBytes;
+    switch (opts.overload) {
+    case OverloadPolicy::DropOldest:
+        if (full)
+            count_shed_frames(server, client, client.tx.dropOldest(opts.clientQueueBytes, server.publisher.tick()));
+        return true;
+    case OverloadPolicy::DropNewest:
+        if (full) count_shed_frames(server, client, client.tx.dropNewest(server.publisher.tick()));
+        return true;
+    case OverloadPolicy::Disconnect:
+    default: {
+        int64_t behindMs = client.behindSinceNs ? (nowNs - client.behindSinceNs) / 1000000 : 0;
+        if (!full && behindMs <= opts.maxLagMs) return true;
+        PMU_LOG_WARN("Disconnecting {}: {} ms behind with {} bytes queued.", client.peer, behindMs,
+                     client.tx.bytes());
+        client.shedFrames += client.tx.frames();
+        server.shedFrames += client.tx.frames();
+        if (server.stats) server.stats->framesShed.add(client.tx.frames());
+        ++server.overloadDisconnects;
+        if (server.stats) server.stats->overloadDisconnects.add();
+        return false;
+    }
+    }
 }
 
-void processCommandFrame(unsigned char* cmdFrame, int frameSizeRecv, uint16_t localPMUId, uint16_t& command) {
-    command = 0;
-    std::cout << "[DEBUG] processCommandFrame called with frameSizeRecv = " << frameSizeRecv << std::endl;
+// Adds the framer's CHK failures since the last call to the metrics.
+void count_crc_failures(PmuServer& server, const StreamFramer& framer, uint64_t& counted) {
+    if (!server.stats || framer.crcErrors() == counted) return;
+    server.stats->crcFailures.add(framer.crcErrors() - counted);
+    counted = framer.crcErrors();
+}
 
-    std::cout << "[DEBUG] Received bytes: ";
-    for (int i = 0; i < frameSizeRecv; ++i) {
-        std::cout << std::hex << std::setw(2) << std::setfill('0') << (int)cmdFrame[i] << " ";
+bool send_config_frames(PmuServer& server, PmuClient& client, const std::vector<size_t>& pmus) {
+    for (size_t i : pmus) {
+        PMU_LOG_INFO("Sending CFG-2 frame for PMU {} to {}...", server.engine->pmu(i).idCode, client.peer);
+        FrameRef cfgFrame = current_config_frame(server, i);
+        dump_config_frame(cfgFrame);
+        client.tx.push(cfgFrame, 0, cfgFrame.size());
     }
-    std::cout << std::dec << std::endl;
+    size_t bytes = client.tx.bytes();
+    if (!flush_client(server, client)) return false;
+    PMU_LOG_INFO("CFG-2 queued ({} bytes).", bytes);
+
+    // Temporary: Enable data stream for testing
+    set_stream_active(server, client, pmus, true);
+    PMU_LOG_INFO("Data stream enabled for testing.");
+    return true;
+}
 
-    if (frameSizeRecv < 10 || cmdFrame[0] != SYNC_CMD || cmdFrame[1] != TYPE_CMD) {
-        std::cerr << "[PMU] Invalid command frame header.\n";
-        return;
+// Counts a command frame, by the CMD word received since processCommandFrame()
+// answers unknown ones with CFG-2 and reports them as SEND_CFG2, and decodes
+// it. Returns false if the frame is to be ignored.
+bool decode_command(PmuServer& server, const FrameView& frame, uint16_t& pmuId, uint16_t& command) {
+    if (server.stats) server.stats->commands[size_t(command_kind(command_code(frame.data, frame.size)))].add();
+    return processCommandFrame(frame.data, frame.size, *server.engine, pmuId, command);
+}
+
+// Returns false if the client has to be dropped.
+bool handle_client_command(PmuServer& server, PmuClient& client, const FrameView& frame) {
+    uint16_t command = 0;
+    uint16_t pmuId = 0xFFFF;
+    if (!decode_command(server, frame, pmuId, command)) return true;
+
+    std::vector<size_t> targets;
+    select_pmus(server, pmuId, targets);
+
+    switch (command) {
+    case CMD_TURN_ON_TX:
+        set_stream_active(server, client, targets, true);
+        PMU_LOG_INFO("Data stream enabled.");
+        return true;
+
+    case CMD_TURN_OFF_TX:
+        set_stream_active(server, client, targets, false);
+        PMU_LOG_INFO("Data stream disabled.");
+        return true;
+
+    case CMD_SEND_CFG1:
+    case CMD_SEND_CFG2:
+    case 0x67F2:
+    default:
+        return send_config_frames(server, client, targets);
     }
+}
 
-    uint16_t frameSize = (static_cast<uint16_t>(cmdFrame[2]) << 8) | cmdFrame[3];
-    std::cout << "[DEBUG] Frame size field (bytes 2-3) indicates: " << frameSize << " bytes.\n";
-    if (frameSize > frameSizeRecv || frameSize < 10) {
-        std::cerr << "[PMU] Invalid frame size.\n";
-        return;
+// Receives whatever the socket has straight into the client's framer and acts
+// on every complete command frame. A command may arrive split over several
+// reads, or several commands in one. Returns false if the client has to be
+// dropped.
+bool handle_client_data(PmuServer& server, PmuClient& client) {
+    StreamFramer& framer = client.framer;
+    if (framer.writable() == 0) {
+        // Only a frame that never completes can fill the buffer.
+        PMU_LOG_WARN("Command buffer of {} overflowed, resynchronizing.", client.peer);
+        framer.reset();
     }
+    int bytesReceived = recv(client.sock, (char*)framer.writePtr(), static_cast<int>(framer.writable()), 0);
+    if (bytesReceived < 0 && socket_would_block(socket_last_error())) return true;
+    if (bytesReceived <= 0) return false;
 
-    uint16_t expected_crc = (static_cast<uint16_t>(cmdFrame[frameSize - 2]) << 8) | cmdFrame[frameSize - 1];
-    uint16_t calculated_crc = calculate_crc(cmdFrame, frameSize - 2);
-    std::cout << "[DEBUG] CRC Check: Expected=0x" << std::hex << expected_crc
-              << ", Calculated=0x" << calculated_crc << std::dec
-              << " (over " << (frameSize - 2) << " bytes)\n";
-    bool crc_ok = (expected_crc == calculated_crc);
+    PMU_LOG_INFO("Received {} bytes from {}", bytesReceived, client.peer);
+    framer.commit(static_cast<size_t>(bytesReceived));
 
-    uint16_t receivedPMUId = (static_cast<uint16_t>(cmdFrame[4]) << 8) | cmdFrame[5];
-    std::cout << "[DEBUG] Received PMU ID: " << receivedPMUId << "\n";
-    if (receivedPMUId != localPMUId && receivedPMUId != 0xFFFF) {
-        std::cerr << "[PMU] PMU ID mismatch.\n";
-        return;
+    FrameView frame;
+    while (framer.next(frame)) {
+        if (!handle_client_command(server, client, frame)) return false;
     }
+    count_crc_failures(server, framer, client.countedCrcErrors);
+    return true;
+}
 
-    command = (static_cast<uint16_t>(cmdFrame[6]) << 8) | cmdFrame[7];
-    std::cout << "[DEBUG] Command Code: 0x" << std::hex << command << std::dec << "\n";
+void handle_udp_frame(PmuServer& server, const sockaddr_in& from, const FrameView& frame) {
+    uint16_t command = 0;
+    uint16_t pmuId = 0xFFFF;
+    if (!decode_command(server, frame, pmuId, command)) return;
+
+    std::vector<size_t> targets;
+    select_pmus(server, pmuId, targets);
 
     switch (command) {
-    case CMD_TURN_OFF_TX:
-        std::cout << "[PMU] Turn Off Data Transmission.\n";
-        break;
     case CMD_TURN_ON_TX:
-        std::cout << "[PMU] Turn On Data Transmission.\n";
-        break;
-    case CMD_SEND_HDR:
-        std::cout << "[PMU] Send Header Frame.\n";
+        set_udp_subscription(server, from, targets, true);
         break;
-    case CMD_SEND_CFG1:
-        std::cout << "[PMU] Send CFG-1 Frame (using CFG-2).\n";
+
+    case CMD_TURN_OFF_TX:
+        set_udp_subscription(server, from, targets, false);
         break;
-    case CMD_SEND_CFG2:
-        /* case 0x67F2:
-             std::cout << "[PMU] Send CFG-2 Frame (0x67F2 handled).\n";
-             command = CMD_SEND_CFG2;
-             break;*/
-    default:
-        std::cout << "[PMU] Send CFG-2 Frame (0x67F2 handled).\n";
-        command = CMD_SEND_CFG2;
+
+    default: {
+        for (size_t i : targets) {
+            FrameRef cfgFrame = current_config_frame(server, i);
+            dump_config_frame(cfgFrame);
+            if (sendto(server.udp.socket(), (char*)cfgFrame.data(), static_cast<int>(cfgFrame.size()), 0,
+                       (struct sockaddr*)&from, sizeof(from)) == SOCKET_ERROR) {
+                PMU_LOG_ERROR("Send CFG-2 over UDP failed! Error: {}", socket_last_error());
+                return;
+            }
+        }
+        PMU_LOG_INFO("CFG-2 sent over UDP to {}.", endpoint_string(from));
+        // Temporary: Enable data stream for testing
+        set_udp_subscription(server, from, targets, true);
         break;
     }
+    }
 }
 
-int main() {
-    WSADATA wsaData;
-    SOCKET serverSocket = INVALID_SOCKET;
-    SOCKET clientSocket = INVALID_SOCKET;
-    sockaddr_in serverAddr, clientAddr;
-    int clientAddrSize = sizeof(clientAddr);
+// Pure UDP mode: commands arrive as datagrams and are answered to the sender.
+// A datagram is self-contained, so the framer only splits and verifies the
+// frames in it and is emptied before each receive.
+void handle_udp_command(PmuServer& server) {
+    StreamFramer& framer = server.udpFramer;
+    framer.reset();
+    sockaddr_in from{};
+    socklen_t fromLen = sizeof(from);
+    int bytesReceived = recvfrom(server.udp.socket(), (char*)framer.writePtr(), static_cast<int>(framer.writable()), 0,
+                                 (struct sockaddr*)&from, &fromLen);
+    if (bytesReceived <= 0) return;
+
+    PMU_LOG_INFO("Received {} bytes over UDP from {}", bytesReceived, endpoint_string(from));
+    framer.commit(static_cast<size_t>(bytesReceived));
+
+    FrameView frame;
+    while (framer.next(frame))
+        handle_udp_frame(server, from, frame);
+    count_crc_failures(server, framer, server.udpCountedCrcErrors);
+}
 
-    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
-        std::cerr << "[PMU] WSAStartup failed! Error: " << WSAGetLastError() << "\n";
-        return 1;
+bool has_data_subscribers(const PmuServer& server) {
+    if (server.udp.destinationCount() > 0) return true;
+    if (server.opts.mode != TransportMode::Tcp) return false;
+    return std::any_of(server.clients.begin(), server.clients.end(),
+                       [](const auto& entry) { return entry.second.dataStreamActive(); });
+}
+
+// Frames are produced while someone receives them or a capture records them.
+// True while some subscriber has frames the socket did not take yet.
+bool tcp_backlog(const PmuServer& server) {
+    for (const auto& entry : server.clients)
+        if (entry.second.dataStreamActive() && entry.second.waitingWritable) return true;
+    return false;
+}
+
+bool frames_wanted(const PmuServer& server) {
+    return has_data_subscribers(server) || server.capture.isOpen();
+}
+
+void accept_clients(PmuServer& server) {
+    // The listening socket is non-blocking: drain the whole accept backlog.
+    while (true) {
+        sockaddr_in clientAddr;
+        socklen_t clientAddrSize = sizeof(clientAddr);
+        SOCKET clientSocket = accept(server.listenSocket, (struct sockaddr*)&clientAddr, &clientAddrSize);
+        if (clientSocket == INVALID_SOCKET) {
+            int err = socket_last_error();
+            if (!socket_would_block(err))
+                PMU_LOG_ERROR("Accept failed! Error: {}", err);
+            return;
+        }
+
+        // A client that stops reading must never block the network thread;
+        // what it cannot take queues up in its FrameQueue (see --overload).
+        set_nonblocking(clientSocket, true);
+        set_tcp_nodelay(clientSocket, true);
+        if (!server.poller.add(clientSocket)) {
+            PMU_LOG_ERROR("Failed to watch client socket! Error: {}", socket_last_error());
+            closesocket(clientSocket);
+            continue;
+        }
+
+        PmuClient client;
+        client.sock = clientSocket;
+        client.addr = clientAddr;
+        client.peer = endpoint_string(clientAddr);
+        client.subscribed.assign(server.engine->pmuCount(), 0);
+        PMU_LOG_INFO("Client connected: {} ({} total)", client.peer, server.clients.size() + 1);
+        server.clients.emplace(clientSocket, std::move(client));
     }
-    std::cout << "[PMU] Winsock Initialized.\n";
+}
 
-    serverSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
-    if (serverSocket == INVALID_SOCKET) {
-        std::cerr << "[PMU] Socket creation failed! Error: " << WSAGetLastError() << "\n";
-        WSACleanup();
-        return 1;
+void drop_client(PmuServer& server, SOCKET sock) {
+    auto it = server.clients.find(sock);
+    if (it == server.clients.end()) return;
+    if (it->second.shedFrames > 0)
+        PMU_LOG_INFO("Client disconnected: {} ({} frames shed)", it->second.peer, it->second.shedFrames);
+    else
+        PMU_LOG_INFO("Client disconnected: {}", it->second.peer);
+    std::vector<size_t> all;
+    select_pmus(server, 0xFFFF, all);
+    set_stream_active(server, it->second, all, false);
+    server.poller.remove(sock);
+    shutdown(sock, SD_SEND);
+    closesocket(sock);
+    server.clients.erase(it);
+}
+
+// The CFG-2 of every PMU is encoded once up front; clients that ask for it
+// get a copy restamped with the present time (current_config_frame()).
+void publish_config_frames(PmuServer& server) {
+    std::vector<std::vector<unsigned char>> frames;
+    for (size_t i = 0; i < server.engine->pmuCount(); ++i)
+        frames.push_back(config_frame(server, i));
+    server.publisher.setConfigFrames(frames);
+}
+
+bool open_tcp_listener(PmuServer& server) {
+    server.listenSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (server.listenSocket == INVALID_SOCKET) {
+        PMU_LOG_ERROR("Socket creation failed! Error: {}", socket_last_error());
+        return false;
     }
-    std::cout << "[PMU] Server socket created.\n";
+    PMU_LOG_INFO("Server socket created.");
+
+#ifndef _WIN32
+    int reuse = 1;
+    setsockopt(server.listenSocket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+#endif
 
+    sockaddr_in serverAddr{};
     serverAddr.sin_family = AF_INET;
     serverAddr.sin_addr.s_addr = INADDR_ANY;
-    serverAddr.sin_port = htons(4712);
+    serverAddr.sin_port = htons(server.opts.tcpPort);
 
-    if (bind(serverSocket, (struct sockaddr*)&serverAddr, sizeof(serverAddr)) == SOCKET_ERROR) {
-        std::cerr << "[PMU] Bind failed! Error: " << WSAGetLastError() << "\n";
-        closesocket(serverSocket);
-        WSACleanup();
-        return 1;
+    if (bind(server.listenSocket, (struct sockaddr*)&serverAddr, sizeof(serverAddr)) == SOCKET_ERROR) {
+        PMU_LOG_ERROR("Bind failed! Error: {}", socket_last_error());
+        return false;
+    }
+    PMU_LOG_INFO("Socket bound to port {}.", server.opts.tcpPort);
+
+    if (listen(server.listenSocket, SOMAXCONN) == SOCKET_ERROR) {
+        PMU_LOG_ERROR("Listen failed! Error: {}", socket_last_error());
+        return false;
+    }
+    set_nonblocking(server.listenSocket, true);
+
+    if (!server.poller.add(server.listenSocket)) {
+        PMU_LOG_ERROR("Poller setup failed! Error: {}", socket_last_error());
+        return false;
+    }
+    PMU_LOG_INFO("Listening for incoming connections...");
+    return true;
+}
+
+bool open_udp_sender(PmuServer& server) {
+    bool udpNeeded = server.opts.mode != TransportMode::Tcp || !server.opts.udpDestinations.empty();
+    if (!udpNeeded) return true;
+
+    // Pure UDP mode receives commands on the well-known port; otherwise the
+    // socket only sends and an ephemeral port is fine.
+    uint16_t bindPort = (server.opts.mode == TransportMode::Udp) ? server.opts.udpPort : 0;
+    if (!server.udp.open(bindPort, server.opts.multicastTtl)) {
+        PMU_LOG_ERROR("UDP socket setup failed! Error: {}", socket_last_error());
+        return false;
+    }
+    if (server.opts.mode == TransportMode::Udp) {
+        if (!server.poller.add(server.udp.socket())) {
+            PMU_LOG_ERROR("Poller setup failed! Error: {}", socket_last_error());
+            return false;
+        }
+        PMU_LOG_INFO("Listening for UDP commands on port {}.", server.opts.udpPort);
+    }
+    for (const sockaddr_in& dest : server.opts.udpDestinations) {
+        server.udp.addDestination(dest);
+        PMU_LOG_INFO("Spontaneous UDP data to {}.", endpoint_string(dest));
+    }
+    server.udpStreams.assign(server.engine->pmuCount(), static_cast<uint32_t>(server.udp.destinationCount()));
+    return true;
+}
+
+void shutdown_server(PmuServer& server) {
+    PMU_LOG_INFO("Shutting down...");
+    if (server.metrics) server.metrics->stop();
+    while (!server.clients.empty())
+        drop_client(server, server.clients.begin()->first);
+    if (server.shedFrames > 0)
+        PMU_LOG_INFO("Shed {} frames for slow clients, {} disconnected ({}).", server.shedFrames,
+                     server.overloadDisconnects, overload_policy_name(server.opts.overload));
+    if (server.listenSocket != INVALID_SOCKET) {
+        closesocket(server.listenSocket);
+        server.listenSocket = INVALID_SOCKET;
+    }
+    server.udp.close();
+    if (server.capture.isOpen()) {
+        PMU_LOG_INFO("Recorded {} frames ({} bytes) to {}.", server.capture.recordCount(),
+                     server.capture.byteCount(), server.opts.recordPath);
+        server.capture.close();
+    }
+    socket_cleanup();
+    PMU_LOG_INFO("Cleanup complete.");
+}
+
+// Publishes one tick of frames as one shared buffer, and queues
+// each TCP subscriber its part of it. Clients that are keeping up get it
+// right away with a single gather write; the others catch up when their
+// socket has room. Clients whose send failed or that fell too far behind are
+// returned in dropped.
+void send_tcp_frames(PmuServer& server, const std::vector<EncodedFrame>& frames, int64_t nowNs,
+                     std::vector<SOCKET>& dropped) {
+    dropped.clear();
+    // Replayed frames are queued straight from the capture mapping; restamped
+    // ones are in scratch space reused on the next tick, so they are copied.
+    if (server.replay && !server.replay->restamp)
+        server.publisher.publishInPlace(frames, server.replay->file.data(), server.replay->file.byteSize());
+    else
+        server.publisher.publish(frames);
+    for (auto& entry : server.clients) {
+        PmuClient& client = entry.second;
+        if (!client.dataStreamActive()) continue;
+        server.publisher.enqueueTick(client.tx, client.subscribed, client.subscribedCount);
+        if (client.waitingWritable) {
+            if (!apply_overload_policy(server, client, nowNs)) dropped.push_back(client.sock);
+            continue;
+        }
+        size_t bytes = client.tx.bytes();
+        if (!flush_client(server, client)) {
+            dropped.push_back(client.sock);
+            continue;
+        }
+        PMU_LOG_DEBUG("Data frames sent to {} ({} bytes).", client.peer, bytes);
+    }
+}
+
+// Credits every frame of the tick once per subscriber it was queued to.
+void count_frames_sent(PmuServer& server, const std::vector<EncodedFrame>& frames) {
+    bool tcp = server.opts.mode == TransportMode::Tcp;
+    for (const EncodedFrame& frame : frames) {
+        uint64_t copies = server.udpStreams[frame.pmuIndex] + (tcp ? server.tcpSubscribers[frame.pmuIndex] : 0);
+        if (copies) server.stats->pmuFrames[frame.pmuIndex].add(copies);
+    }
+}
+
+// Hands the metrics thread a snapshot of every client's send backlog.
+void publish_client_backlog(PmuServer& server) {
+    std::vector<ClientBacklog> clients;
+    clients.reserve(server.clients.size());
+    for (const auto& entry : server.clients) {
+        const PmuClient& client = entry.second;
+        clients.push_back({client.peer, client.tx.bytes(), client.tx.frames(), client.shedFrames});
     }
-    std::cout << "[PMU] Socket bound to port 4712.\n";
+    server.metrics->publishClients(clients);
+}
+
+void report_jitter(const JitterHistogram& jitter, const FrameScheduler& scheduler) {
+    if (jitter.count() == 0) return;
+    std::string buckets = jitter.format();
+    buckets.pop_back();
+    PMU_LOG_INFO("Frame jitter over {} ticks: mean {} us, p99 < {} us, max {} us, missed frames {}\n{}",
+                 jitter.count(), jitter.meanMicros(), jitter.quantileMicros(0.99),
+                 jitter.maxMicros(), scheduler.missedFrames(), buckets);
+}
 
-    if (listen(serverSocket, SOMAXCONN) == SOCKET_ERROR) {
-        std::cerr << "[PMU] Listen failed! Error: " << WSAGetLastError() << "\n";
-        closesocket(serverSocket);
-        WSACleanup();
+int main(int argc, char** argv) {
+    // Console output is written by the logger's drain thread, never by the
+    // network thread itself. It is stopped (and drained) on every return,
+    // after the server's own teardown.
+    LoggerScope logging(pmuLogger);
+    PmuServer server;
+    if (!parse_options(argc, argv, server.opts)) {
+        pmuLogger.stop();
+        print_usage(argv[0]);
         return 1;
     }
-    std::cout << "[PMU] Listening for incoming connections...\n";
+    pmuLogger.setLevel(server.opts.logLevel);
+
+    if (!server.opts.convertInput.empty()) {
+        int64_t records = convert_raw_stream(server.opts.convertInput, server.opts.convertOutput);
+        if (records < 0)
+            PMU_LOG_ERROR("Converting {} to {} failed.", server.opts.convertInput, server.opts.convertOutput);
+        else
+            PMU_LOG_INFO("Wrote {} frames to {}.", records, server.opts.convertOutput);
+        return records < 0 ? 1 : 0;
+    }
 
-    clientSocket = accept(serverSocket, (struct sockaddr*)&clientAddr, &clientAddrSize);
-    if (clientSocket == INVALID_SOCKET) {
-        std::cerr << "[PMU] Accept failed! Error: " << WSAGetLastError() << "\n";
-        closesocket(serverSocket);
-        WSACleanup();
+    std::vector<VirtualPmuConfig> pmus;
+    if (!server.opts.replayPath.empty()) {
+        server.replay = std::make_unique<ReplaySession>();
+        if (!open_replay(server.opts, *server.replay, pmus)) return 1;
+    }
+    else if (!load_pmu_configs(server.opts, pmus)) {
         return 1;
     }
+    unsigned workers = 0;
+    if (server.replay)
+        workers = 0;  // Frames come from the capture; the engine only lists the PMUs
+    else if (server.opts.workers >= 0)
+        workers = static_cast<unsigned>(server.opts.workers);
+    else if (pmus.size() > 1)
+        workers = std::max(1u, std::thread::hardware_concurrency() - 1);
+    server.engine = std::make_unique<PmuSimEngine>(std::move(pmus), workers, server.opts.pinWorkers);
+    if (!server.replay) {
+        PMU_LOG_INFO("Simulating {} PMU(s) on {} encoder thread(s).",
+                     server.engine->pmuCount(), server.engine->workerCount());
+        if (server.engine->rateGroups().size() == PmuSimEngine::MAX_RATE_GROUPS)
+            PMU_LOG_WARN("Warning: only the first {} distinct reporting rates are simulated.",
+                         PmuSimEngine::MAX_RATE_GROUPS);
+    }
+
+    publish_config_frames(server);
+    server.tcpSubscribers.assign(server.engine->pmuCount(), 0);
+    server.udpStreams.assign(server.engine->pmuCount(), 0);
+
+    if (!server.opts.recordPath.empty()) {
+        if (!server.capture.open(server.opts.recordPath)) {
+            PMU_LOG_ERROR("Cannot create capture {}", server.opts.recordPath);
+            return 1;
+        }
+        int64_t now = realtime_ns();
+        for (size_t i = 0; i < server.engine->pmuCount(); ++i) {
+            const FrameRef& cfgFrame = server.publisher.configFrame(i);
+            server.capture.write(now, cfgFrame.data(), cfgFrame.size());
+        }
+        PMU_LOG_INFO("Recording frames to {}.", server.opts.recordPath);
+    }
 
-    char clientIP[INET_ADDRSTRLEN];
-    inet_ntop(AF_INET, &clientAddr.sin_addr, clientIP, INET_ADDRSTRLEN);
-    std::cout << "[PMU] Client connected: " << clientIP << ":" << ntohs(clientAddr.sin_port) << "\n";
+    if (!socket_startup()) {
+        PMU_LOG_ERROR("Socket startup failed! Error: {}", socket_last_error());
+        return 1;
+    }
+    PMU_LOG_INFO("Sockets initialized.");
 
-    closesocket(serverSocket);
-    serverSocket = INVALID_SOCKET;
+    if (!server.poller.valid()) {
+        PMU_LOG_ERROR("Poller setup failed! Error: {}", socket_last_error());
+        shutdown_server(server);
+        return 1;
+    }
+    if ((server.opts.mode != TransportMode::Udp && !open_tcp_listener(server)) || !open_udp_sender(server)) {
+        shutdown_server(server);
+        return 1;
+    }
+    if (server.opts.metricsPort != 0) {
+        std::vector<uint16_t> idCodes;
+        for (size_t i = 0; i < server.engine->pmuCount(); ++i)
+            idCodes.push_back(server.engine->pmu(i).idCode);
+        server.metrics = std::make_unique<SimMetrics>(std::move(idCodes));
+        server.stats = &server.metrics->addShard();
+        if (!server.metrics->start(server.opts.metricsPort)) {
+            PMU_LOG_ERROR("Metrics listener on port {} failed! Error: {}", server.opts.metricsPort,
+                          socket_last_error());
+            shutdown_server(server);
+            return 1;
+        }
+        PMU_LOG_INFO("Metrics at http://127.0.0.1:{}/metrics", server.opts.metricsPort);
+    }
 
-    unsigned char recvBuffer[2048];
-    bool dataStreamActive = false;
-    srand(static_cast<unsigned int>(time(nullptr)));
+    std::vector<PollEvent> events;
+    std::vector<SOCKET> dropped;
 
-    auto lastFrameTime = std::chrono::steady_clock::now();
-    std::chrono::milliseconds frameInterval(1000 / DATA_RATE);
+    // Reports go out at the nominal instants of each reporting rate, aligned
+    // to UTC second boundaries; the timer wakes the poller at each deadline.
+    FrameScheduler scheduler(server.engine->rateGroups(), TIME_BASE);
+    DeadlineTimer timer;
+    if (timer.handle() == INVALID_SOCKET) {
+        PMU_LOG_DEBUG("No kernel timer, keeping deadlines with the poll timeout.");
+    }
+    else if (!server.poller.add(timer.handle())) {
+        PMU_LOG_WARN("Cannot poll the deadline timer (error {}), keeping deadlines with the poll timeout.",
+                     socket_last_error());
+        timer.releaseHandle();
+    }
+    JitterHistogram jitter;
+    int64_t nextJitterReport = INT64_MAX;
+    int64_t nextCaptureFlush = 0;
+    int64_t nextMetricsPublish = 0;
+    size_t publishedClients = 0;
+    bool streaming = false;
 
     while (true) {
-        u_long bytesAvailable = 0;
-        if (ioctlsocket(clientSocket, FIONREAD, &bytesAvailable) == SOCKET_ERROR) {
-            std::cerr << "[PMU] ioctlsocket failed! Error: " << WSAGetLastError() << "\n";
-            break;
+        if (!frames_wanted(server)) {
+            if (streaming) timer.disarm();
+            streaming = false;
         }
-
-        if (bytesAvailable > 0) {
-            int bytesReceived = recv(clientSocket, (char*)recvBuffer, sizeof(recvBuffer), 0);
-            if (bytesReceived <= 0) {
-                std::cerr << "[PMU] recv failed or client disconnected! Error: " << WSAGetLastError() << "\n";
-                break;
+        else if (!streaming) {
+            streaming = true;
+            int64_t now = realtime_ns();
+            if (server.replay) {
+                anchor_replay(*server.replay, now);
+                timer.arm(replay_deadline(*server.replay, now));
             }
-
-            std::cout << "[PMU] Received " << bytesReceived << " bytes: ";
-            for (int i = 0; i < bytesReceived; ++i) {
-                std::cout << std::hex << std::setw(2) << std::setfill('0') << (int)recvBuffer[i] << " ";
+            else {
+                scheduler.start(now);
+                timer.arm(scheduler.nextDeadlineNs());
             }
-            std::cout << std::dec << "\n";
-
-            uint16_t command = 0;
-            processCommandFrame(recvBuffer, bytesReceived, PMU_ID_CODE, command);
-
-            switch (command) {
-            case CMD_SEND_CFG1:
-            case CMD_SEND_CFG2:
-            case 0x67F2:
-            {
-                std::cout << "[PMU] Sending CFG-2 frame...\n";
-                std::vector<unsigned char> cfgFrame = create_config_frame2(
-                    PMU_ID_CODE, 1000000, 1, STATION_NAME, DATA_RATE,
-                    PHASOR_COUNT, ANALOG_COUNT, DIGITAL_COUNT,
-                    USE_FLOAT_FORMAT, USE_POLAR_FORMAT);
-
-                std::cout << "[DEBUG] CFG-2 size: " << cfgFrame.size() << " bytes\n";
-                std::cout << "[DEBUG] CFG-2 contents: ";
-                for (auto byte : cfgFrame) {
-                    std::cout << std::hex << std::setw(2) << std::setfill('0') << (int)byte << " ";
-                }
-                std::cout << std::dec << "\n";
+            if (server.opts.jitterReportSec > 0)
+                nextJitterReport = now + int64_t(server.opts.jitterReportSec) * 1000000000;
+        }
 
-                int bytesSent = send(clientSocket, (char*)cfgFrame.data(), cfgFrame.size(), 0);
-                if (bytesSent == SOCKET_ERROR) {
-                    std::cerr << "[PMU] Send CFG-2 failed! Error: " << WSAGetLastError() << "\n";
-                    break;
-                }
-                std::cout << "[PMU] CFG-2 sent (" << bytesSent << " bytes).\n";
+        // Sleep in the kernel until a socket is ready or the next frame is due.
+        if (server.poller.wait(events, timer.pollTimeoutMs(realtime_ns())) < 0) {
+            PMU_LOG_ERROR("Poll failed! Error: {}", socket_last_error());
+            break;
+        }
+        timer.finishWait();
 
-                // Temporary: Enable data stream for testing
-                dataStreamActive = true;
-                lastFrameTime = std::chrono::steady_clock::now();
-                std::cout << "[PMU] Data stream enabled for testing.\n";
+        for (const PollEvent& ev : events) {
+            if (ev.sock == timer.handle()) {
+                timer.consume();
+                continue;
+            }
+            if (ev.sock == server.listenSocket) {
+                accept_clients(server);
+                continue;
+            }
+            if (ev.sock == server.udp.socket()) {
+                handle_udp_command(server);
+                continue;
             }
-            break;
 
-            case CMD_TURN_ON_TX:
-                dataStreamActive = true;
-                lastFrameTime = std::chrono::steady_clock::now();
-                std::cout << "[PMU] Data stream enabled.\n";
-                break;
-
-            case CMD_TURN_OFF_TX:
-                dataStreamActive = false;
-                std::cout << "[PMU] Data stream disabled.\n";
-                break;
-
-            default:
-                std::cout << "[PMU] Sending CFG-2 frame...\n";
-                std::vector<unsigned char> cfgFrame = create_config_frame2(
-                    PMU_ID_CODE, 1000000, 1, STATION_NAME, DATA_RATE,
-                    PHASOR_COUNT, ANALOG_COUNT, DIGITAL_COUNT,
-                    USE_FLOAT_FORMAT, USE_POLAR_FORMAT);
-
-                std::cout << "[DEBUG] CFG-2 size: " << cfgFrame.size() << " bytes\n";
-                std::cout << "[DEBUG] CFG-2 contents: ";
-                for (auto byte : cfgFrame) {
-                    std::cout << std::hex << std::setw(2) << std::setfill('0') << (int)byte << " ";
-                }
-                std::cout << std::dec << "\n";
+            auto it = server.clients.find(ev.sock);
+            if (it == server.clients.end()) continue;
+            PmuClient& client = it->second;
 
-                int bytesSent = send(clientSocket, (char*)cfgFrame.data(), cfgFrame.size(), 0);
-                if (bytesSent == SOCKET_ERROR) {
-                    std::cerr << "[PMU] Send CFG-2 failed! Error: " << WSAGetLastError() << "\n";
-                    break;
+            if (ev.readable) {
+                if (!handle_client_data(server, client)) {
+                    drop_client(server, ev.sock);
+                    continue;
                 }
-                std::cout << "[PMU] CFG-2 sent (" << bytesSent << " bytes).\n";
+            }
+            else if (ev.hangup) {
+                drop_client(server, ev.sock);
+                continue;
+            }
+            if (ev.writable && client.waitingWritable && !flush_client(server, client))
+                drop_client(server, ev.sock);
+        }
 
-                // Temporary: Enable data stream for testing
-                dataStreamActive = true;
-                lastFrameTime = std::chrono::steady_clock::now();
-                std::cout << "[PMU] Data stream enabled for testing.\n";
-                break;
+        if (server.metrics) {
+            // Backlogs go out once a second, and whenever a client comes or goes.
+            int64_t now = realtime_ns();
+            if (now >= nextMetricsPublish || server.clients.size() != publishedClients) {
+                publish_client_backlog(server);
+                publishedClients = server.clients.size();
+                nextMetricsPublish = now + 1000000000;
             }
         }
 
-        if (dataStreamActive) {
-            auto now = std::chrono::steady_clock::now();
-            auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - lastFrameTime);
-            if (elapsed >= frameInterval) {
-                lastFrameTime = now;
-                std::vector<unsigned char> dataFrame = create_data_frame(
-                    PMU_ID_CODE, PHASOR_COUNT, ANALOG_COUNT, DIGITAL_COUNT,
-                    USE_FLOAT_FORMAT, USE_POLAR_FORMAT, DATA_RATE);
+        if (!streaming || !frames_wanted(server)) continue;
+
+        int64_t now = realtime_ns();
+        const std::vector<EncodedFrame>* frames = nullptr;
+        if (server.replay) {
+            ReplaySession& replay = *server.replay;
+            // At --speed max the replay keeps pace with the slowest subscriber
+            // rather than shedding: wait for its socket to take the backlog.
+            if (replay.speed <= 0.0 && tcp_backlog(server)) {
+                timer.disarm();
+                continue;
+            }
+            int64_t deadline = replay_deadline(replay, now);
+            if (now < deadline) continue;
+            if (!next_replay_ticks(replay, *server.engine, now)) break;
+            if (replay.speed > 0.0) {
+                jitter.record(now - deadline);
+                if (server.stats) server.stats->jitter.record(now - deadline);
+            }
+            timer.arm(replay_deadline(replay, now));
+            frames = &replay.frames;
+        }
+        else {
+            if (now < scheduler.nextDeadlineNs()) continue;
+            FrameTick tick = scheduler.pop(now);
+            jitter.record(now - tick.deadlineNs);
+            if (server.stats) server.stats->jitter.record(now - tick.deadlineNs);
+            timer.arm(scheduler.nextDeadlineNs());
+            // SOC/FRACSEC carry the nominal reporting instant, not the encode time.
+            frames = &server.engine->encodeTick(tick.dueGroups, tick.soc, tick.fracsec);
+        }
+        if (now >= nextJitterReport) {
+            report_jitter(jitter, scheduler);
+            jitter.reset();
+            nextJitterReport += int64_t(server.opts.jitterReportSec) * 1000000000;
+        }
 
-                std::cout << "[DEBUG] Data frame size: " << dataFrame.size() << " bytes\n";
-                std::cout << "[DEBUG] Data frame contents: ";
-                for (auto byte : dataFrame) {
-                    std::cout << std::hex << std::setw(2) << std::setfill('0') << (int)byte << " ";
-                }
-                std::cout << std::dec << "\n";
+        if (pmuLogger.enabled(LogLevel::Debug)) {
+            for (const EncodedFrame& frame : *frames)
+                PMU_LOG_HEX(LogLevel::Debug, "Data frame contents", frame.data, frame.len);
+        }
 
-                int bytesSent = send(clientSocket, (char*)dataFrame.data(), dataFrame.size(), 0);
-                if (bytesSent == SOCKET_ERROR) {
-                    std::cerr << "[PMU] Send Data failed! Error: " << WSAGetLastError() << "\n";
+        if (server.capture.isOpen()) {
+            for (const EncodedFrame& frame : *frames) {
+                if (!server.capture.write(now, frame.data, frame.len)) {
+                    PMU_LOG_ERROR("Writing {} failed, recording stopped.", server.opts.recordPath);
+                    server.capture.close();
                     break;
                 }
-                std::cout << "[PMU] Data frame sent (" << bytesSent << " bytes).\n";
             }
-            else {
-                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            if (now >= nextCaptureFlush) {
+                server.capture.flush();
+                nextCaptureFlush = now + 1000000000;
             }
         }
-        else {
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+        if (server.stats) count_frames_sent(server, *frames);
+        if (server.udp.destinationCount() > 0) {
+            for (const EncodedFrame& frame : *frames)
+                server.udp.queue(frame.data, frame.len, frame.pmuIndex);
+            int64_t start = server.stats ? metrics_clock_ns() : 0;
+            size_t datagrams = server.udp.flush();
+            if (server.stats) {
+                server.stats->sendLatency[size_t(Transport::Udp)].record(metrics_clock_ns() - start);
+                server.stats->bytesSent[size_t(Transport::Udp)].add(server.udp.flushedBytes());
+            }
+            PMU_LOG_DEBUG("Data frames sent over UDP ({} datagrams).", datagrams);
+        }
+        if (server.opts.mode == TransportMode::Tcp) {
+            send_tcp_frames(server, *frames, now, dropped);
+            for (SOCKET sock : dropped)
+                drop_client(server, sock);
         }
-    }
 
-    std::cout << "[PMU] Shutting down...\n";
-    if (clientSocket != INVALID_SOCKET) {
-        shutdown(clientSocket, SD_SEND);
-        closesocket(clientSocket);
-    }
-    if (serverSocket != INVALID_SOCKET) {
-        closesocket(serverSocket);
+        if (server.replay && replay_deadline(*server.replay, now) == INT64_MAX) {
+            PMU_LOG_INFO("End of capture {}.", server.opts.replayPath);
+            break;
+        }
     }
-    WSACleanup();
-    std::cout << "[PMU] Cleanup complete.\n";
 
+    if (server.replay) report_replay(*server.replay);
+    report_jitter(jitter, scheduler);
+    shutdown_server(server);
     return 0;
 }
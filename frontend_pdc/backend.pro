@@ -0,0 +1,27 @@
+# PMU simulator (backend.cpp), a console program without Qt.
+TEMPLATE = app
+CONFIG += c++17 console
+CONFIG -= app_bundle qt
+
+TARGET = backend
+unix: LIBS += -lpthread
+win32: LIBS += -lws2_32
+
+SOURCES += \
+    backend.cpp \
+
+HEADERS += \
+    async_logger.h \
+    c37118_framer.h \
+    c37118_layout.h \
+    crc_ccitt.h \
+    data_frame_encoder.h \
+    frame_capture.h \
+    frame_publisher.h \
+    frame_scheduler.h \
+    pmu_sim_engine.h \
+    sim_frames.h \
+    sim_metrics.h \
+    socket_compat.h \
+    socket_poller.h \
+    udp_sender.h
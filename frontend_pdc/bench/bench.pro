@@ -0,0 +1,29 @@
+# Headless benchmark suite (see pdc_bench.cpp). Run it with
+#   QT_QPA_PLATFORM=offscreen ./pdc_bench > results.json
+# The render/* cases build PlotPane and the raster PlotWidget from the GUI
+# sources, so those are compiled in as well.
+QT += core gui network charts widgets
+
+CONFIG += c++17 console release
+CONFIG -= app_bundle
+
+TARGET = pdc_bench
+DEFINES += PDC_BENCH_RENDER
+INCLUDEPATH += ..
+unix: LIBS += -lpthread
+win32: LIBS += -lws2_32
+
+SOURCES += \
+    pdc_bench.cpp \
+    render_bench.cpp \
+    ../concentrator.cpp \
+    ../ingest_worker.cpp \
+    ../mainwindow.cpp \
+    ../plot_widget.cpp \
+
+HEADERS += \
+    bench_report.h \
+    ../concentrator.h \
+    ../ingest_worker.h \
+    ../mainwindow.h \
+    ../plot_widget.h
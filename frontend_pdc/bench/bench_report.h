@@ -0,0 +1,154 @@
+#ifndef BENCH_REPORT_H
+#define BENCH_REPORT_H
+
+// Timing and result reporting shared by the benchmark suite.
+//
+// measure() calibrates a batch size to about MIN_BATCH_MS, then times
+// `repeats` batches and keeps the median, which is far less sensitive to a
+// descheduled batch than the mean. Results are written one JSON object per
+// line (or as CSV) so runs can be archived and compared; compare() reads a
+// previous JSON run and flags every case that got slower than a tolerance.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+struct BenchResult {
+    std::string name;       // Path measured, e.g. "crc/slice8"
+    std::string variant;    // Parameters, e.g. "1024B"
+    double nsPerOp = 0.0;   // Median over the repeats
+    double nsMin = 0.0;     // Fastest repeat
+    double bytesPerOp = 0.0;
+    uint64_t ops = 0;       // Operations per repeat
+};
+
+class BenchReport
+{
+public:
+    static constexpr double MIN_BATCH_MS = 20.0;
+
+    BenchReport(int repeats, const std::string& filter) : repeats(std::max(1, repeats)), filter(filter) {}
+
+    // False if the case is filtered out and should not be set up at all.
+    bool wanted(const std::string& name, const std::string& variant) const {
+        return filter.empty() || (name + "/" + variant).find(filter) != std::string::npos;
+    }
+
+    // Times op(), which performs one operation per call and returns a value
+    // that is folded into a sink so it cannot be optimized away.
+    template <typename Op>
+    void measure(const std::string& name, const std::string& variant, double bytesPerOp, Op op) {
+        if (!wanted(name, variant)) return;
+        uint64_t batch = 1;
+        while (true) {
+            double ms = runBatch(batch, op) / 1e6;
+            if (ms >= MIN_BATCH_MS || batch >= (uint64_t(1) << 40)) break;
+            batch = ms <= 0.0 ? batch * 16 : std::max(batch * 2, uint64_t(batch * MIN_BATCH_MS / ms * 1.2));
+        }
+        std::vector<double> ns;
+        for (int r = 0; r < repeats; ++r) ns.push_back(runBatch(batch, op) / batch);
+        std::sort(ns.begin(), ns.end());
+        BenchResult result;
+        result.name = name;
+        result.variant = variant;
+        result.nsPerOp = ns[ns.size() / 2];
+        result.nsMin = ns.front();
+        result.bytesPerOp = bytesPerOp;
+        result.ops = batch;
+        results.push_back(result);
+        std::fprintf(stderr, "%-28s %-18s %14.1f ns/op\n", name.c_str(), variant.c_str(), result.nsPerOp);
+    }
+
+    const std::vector<BenchResult>& all() const { return results; }
+
+    void writeJson(std::FILE* out) const {
+        for (const BenchResult& r : results) {
+            std::fprintf(out, "{\"name\":\"%s\",\"variant\":\"%s\",\"ns_per_op\":%.3f,\"ns_min\":%.3f,"
+                              "\"ops_per_s\":%.1f,\"mb_per_s\":%.2f,\"ops\":%llu}\n",
+                         r.name.c_str(), r.variant.c_str(), r.nsPerOp, r.nsMin, 1e9 / r.nsPerOp,
+                         r.bytesPerOp * 1e3 / r.nsPerOp, static_cast<unsigned long long>(r.ops));
+        }
+    }
+
+    void writeCsv(std::FILE* out) const {
+        std::fprintf(out, "name,variant,ns_per_op,ns_min,ops_per_s,mb_per_s,ops\n");
+        for (const BenchResult& r : results) {
+            std::fprintf(out, "%s,%s,%.3f,%.3f,%.1f,%.2f,%llu\n", r.name.c_str(), r.variant.c_str(),
+                         r.nsPerOp, r.nsMin, 1e9 / r.nsPerOp, r.bytesPerOp * 1e3 / r.nsPerOp,
+                         static_cast<unsigned long long>(r.ops));
+        }
+    }
+
+    // Compares against a JSON run written by writeJson(). Returns the number
+    // of cases more than `tolerance` (0.10 = 10 %) slower than the baseline;
+    // -1 if the baseline cannot be read.
+    int compare(const std::string& baselinePath, double tolerance) const {
+        std::FILE* in = std::fopen(baselinePath.c_str(), "r");
+        if (!in) return -1;
+        std::vector<BenchResult> baseline;
+        char line[1024];
+        while (std::fgets(line, sizeof(line), in)) {
+            BenchResult r;
+            if (jsonString(line, "name", r.name) && jsonString(line, "variant", r.variant) &&
+                jsonNumber(line, "ns_per_op", r.nsPerOp))
+                baseline.push_back(r);
+        }
+        std::fclose(in);
+
+        int regressions = 0;
+        for (const BenchResult& r : results) {
+            auto it = std::find_if(baseline.begin(), baseline.end(), [&](const BenchResult& b) {
+                return b.name == r.name && b.variant == r.variant;
+            });
+            if (it == baseline.end() || it->nsPerOp <= 0.0) continue;
+            double change = r.nsPerOp / it->nsPerOp - 1.0;
+            if (change <= tolerance) continue;
+            ++regressions;
+            std::fprintf(stderr, "REGRESSION %s/%s: %.1f -> %.1f ns/op (+%.0f%%)\n", r.name.c_str(),
+                         r.variant.c_str(), it->nsPerOp, r.nsPerOp, change * 100.0);
+        }
+        return regressions;
+    }
+
+private:
+    template <typename Op>
+    static double runBatch(uint64_t batch, Op& op) {
+        volatile double sink = 0.0;
+        auto start = std::chrono::steady_clock::now();
+        for (uint64_t i = 0; i < batch; ++i) sink = sink + static_cast<double>(op());
+        return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    static const char* jsonValue(const char* line, const char* key) {
+        std::string pattern = std::string("\"") + key + "\":";
+        const char* p = std::strstr(line, pattern.c_str());
+        return p ? p + pattern.size() : nullptr;
+    }
+
+    static bool jsonString(const char* line, const char* key, std::string& out) {
+        const char* p = jsonValue(line, key);
+        if (!p || *p != '"') return false;
+        const char* end = std::strchr(p + 1, '"');
+        if (!end) return false;
+        out.assign(p + 1, end);
+        return true;
+    }
+
+    static bool jsonNumber(const char* line, const char* key, double& out) {
+        const char* p = jsonValue(line, key);
+        if (!p) return false;
+        out = std::strtod(p, nullptr);
+        return true;
+    }
+
+    int repeats;
+    std::string filter;
+    std::vector<BenchResult> results;
+};
+
+#endif // BENCH_REPORT_H
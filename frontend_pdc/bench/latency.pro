@@ -0,0 +1,25 @@
+# End-to-end latency harness (see latency_harness.cpp). Build the simulator
+# first (qmake ../backend.pro && make), then run
+#   ./pdc_latency --backend ../backend --rate 60 --seconds 20 > latency.json
+QT += core gui network charts widgets
+
+CONFIG += c++17 console release
+CONFIG -= app_bundle
+
+TARGET = pdc_latency
+INCLUDEPATH += ..
+
+SOURCES += \
+    latency_harness.cpp \
+    ../concentrator.cpp \
+    ../ingest_worker.cpp \
+    ../mainwindow.cpp \
+    ../plot_widget.cpp \
+
+HEADERS += \
+    ../concentrator.h \
+    ../ingest_worker.h \
+    ../latency_histogram.h \
+    ../mainwindow.h \
+    ../perf_counters.h \
+    ../plot_widget.h
@@ -0,0 +1,181 @@
+// End-to-end latency harness: from the SOC/FRACSEC stamped into a data frame
+// to its parse on the ingest thread, its insertion into the plotted history
+// and the first paint of the main plot that shows it.
+//
+// Starts the simulator backend on a private port with the PMUs asked for,
+// connects a real MainWindow to it on the offscreen platform (through the
+// concentrator when there are several PMUs) and records every sample into
+// the MainWindow's PipelineLatency histograms. After the warm-up the
+// histograms are cleared, and after the measured seconds p50/p90/p99/p99.9,
+// the maximum and the mean of each stage are printed to stderr and written as
+// one JSON object per stage to stdout (or --out), occupied buckets included.
+//
+// The simulator stamps frames when it encodes them, so the figures include
+// its send path and the loopback socket but no clock skew.
+//
+// Build: qmake latency.pro && make
+// Run:   ./pdc_latency --backend ../backend --rate 60 --phasors 3 --seconds 20
+
+#include "mainwindow.h"
+
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QDebug>
+#include <QProcess>
+#include <QTcpSocket>
+#include <QTemporaryFile>
+#include <QThread>
+#include <QTimer>
+
+#include <cstdio>
+#include <memory>
+
+namespace {
+
+struct RunConfig {
+    int rate = 50;
+    int phasors = 3;
+    int analogs = 4;
+    int pmus = 1;
+    QString renderer = "charts";
+    int fps = 60;
+};
+
+// True once something accepts connections on the port, as IngestWorker does
+// not retry a refused connection.
+bool wait_for_listener(quint16 port, int timeoutMs)
+{
+    for(int waited = 0; waited < timeoutMs; waited += 50) {
+        QTcpSocket probe;
+        probe.connectToHost("127.0.0.1", port);
+        if(probe.waitForConnected(50)) return true;
+        QThread::msleep(50);
+    }
+    return false;
+}
+
+void print_stage(const char *stage, const LatencyHistogram &h)
+{
+    std::fprintf(stderr, "%-7s %10llu %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f\n", stage,
+                 static_cast<unsigned long long>(h.count()), h.quantileNs(0.50) / 1e3, h.quantileNs(0.90) / 1e3,
+                 h.quantileNs(0.99) / 1e3, h.quantileNs(0.999) / 1e3, h.maxNs() / 1e3, h.meanNs() / 1e3);
+}
+
+void write_stage(std::FILE *out, const char *stage, const LatencyHistogram &h, const RunConfig &run)
+{
+    std::fprintf(out, "{\"stage\":\"%s\",\"rate\":%d,\"pmus\":%d,\"phasors\":%d,\"analogs\":%d,"
+                      "\"renderer\":\"%s\",\"fps\":%d,\"count\":%llu,\"p50_us\":%.1f,\"p90_us\":%.1f,"
+                      "\"p99_us\":%.1f,\"p999_us\":%.1f,\"max_us\":%.1f,\"mean_us\":%.1f,\"buckets\":[",
+                 stage, run.rate, run.pmus, run.phasors, run.analogs, run.renderer.toUtf8().constData(), run.fps,
+                 static_cast<unsigned long long>(h.count()), h.quantileNs(0.50) / 1e3, h.quantileNs(0.90) / 1e3,
+                 h.quantileNs(0.99) / 1e3, h.quantileNs(0.999) / 1e3, h.maxNs() / 1e3, h.meanNs() / 1e3);
+    const char *separator = "";
+    h.forEachBucket([&](uint64_t low, uint64_t high, uint64_t count) {
+        std::fprintf(out, "%s[%llu,%llu,%llu]", separator, static_cast<unsigned long long>(low),
+                     static_cast<unsigned long long>(high), static_cast<unsigned long long>(count));
+        separator = ",";
+    });
+    std::fprintf(out, "]}\n");
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    if(qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) qputenv("QT_QPA_PLATFORM", "offscreen");
+    QApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption backendOption("backend", "Simulator binary (default ./backend).", "path", "./backend");
+    QCommandLineOption portOption("port", "TCP port the simulator is started on (default 4812).", "port", "4812");
+    QCommandLineOption rateOption("rate", "Frames per second of every PMU (default 50).", "fps", "50");
+    QCommandLineOption phasorOption("phasors", "Phasors per PMU (default 3).", "n", "3");
+    QCommandLineOption analogOption("analogs", "Analogs per PMU (default 4).", "n", "4");
+    QCommandLineOption pmuOption("pmus", "PMUs in the stream; several are concentrated (default 1).", "n", "1");
+    QCommandLineOption waitOption("wait-ms", "Concentrator wait for late PMUs.", "ms",
+                                  QString::number(Concentrator::DEFAULT_WAIT_MS));
+    QCommandLineOption fpsOption("fps", "Plot redraws per second (default 60).", "hz", "60");
+    QCommandLineOption rendererOption("renderer", "charts or raster (default charts).", "name", "charts");
+    QCommandLineOption secondsOption("seconds", "Measured seconds (default 20).", "s", "20");
+    QCommandLineOption warmupOption("warmup", "Seconds before the histograms are cleared (default 3).", "s", "3");
+    QCommandLineOption outOption("out", "Write the JSON results here instead of stdout.", "path");
+    parser.addOptions({backendOption, portOption, rateOption, phasorOption, analogOption, pmuOption, waitOption,
+                       fpsOption, rendererOption, secondsOption, warmupOption, outOption});
+    parser.process(app);
+
+    RunConfig run;
+    run.rate = qMax(1, parser.value(rateOption).toInt());
+    run.phasors = qMax(0, parser.value(phasorOption).toInt());
+    run.analogs = qMax(0, parser.value(analogOption).toInt());
+    run.pmus = qBound(1, parser.value(pmuOption).toInt(), 0xFFFD);
+    run.fps = parser.value(fpsOption).toInt();
+    run.renderer = parser.value(rendererOption) == "raster" ? "raster" : "charts";
+    quint16 port = static_cast<quint16>(parser.value(portOption).toUInt());
+    double seconds = qMax(1.0, parser.value(secondsOption).toDouble());
+    double warmup = qMax(0.0, parser.value(warmupOption).toDouble());
+
+    QTemporaryFile pmuFile;
+    if(!pmuFile.open()) {
+        qCritical() << "Cannot create the PMU file";
+        return 1;
+    }
+    for(int i = 1; i <= run.pmus; ++i)
+        pmuFile.write(QString("%1,PMU%1,%2,%3,%4,0\n").arg(i).arg(run.rate).arg(run.phasors).arg(run.analogs).toUtf8());
+    pmuFile.flush();
+
+    QProcess backend;
+    backend.setProcessChannelMode(QProcess::ForwardedErrorChannel);
+    backend.setStandardOutputFile(QProcess::nullDevice());
+    backend.start(parser.value(backendOption), {"--tcp-port", QString::number(port), "--pmu-file",
+                                                pmuFile.fileName(), "--log-level", "warn"});
+    if(!backend.waitForStarted() || !wait_for_listener(port, 5000)) {
+        qCritical() << "Simulator" << parser.value(backendOption) << "did not start listening on port" << port;
+        backend.kill();
+        return 1;
+    }
+
+    std::fprintf(stderr, "%d PMU(s) at %d fps, %d phasors + %d analogs, %s at %d Hz, %.0f s\n", run.pmus, run.rate,
+                 run.phasors, run.analogs, run.renderer.toUtf8().constData(), run.fps, seconds);
+    int status = 0;
+    {
+        MainWindow window;
+        window.setRenderRate(run.fps);
+        window.setRasterPlots(run.renderer == "raster");
+        window.resize(1600, 900);
+        window.show();
+        window.connectPmus({QString("127.0.0.1:%1").arg(port)}, run.pmus > 1, parser.value(waitOption).toInt());
+
+        std::shared_ptr<PipelineLatency> latency = window.pipelineLatency();
+        QTimer::singleShot(static_cast<int>(warmup * 1000), [latency]() { latency->reset(); });
+        QTimer::singleShot(static_cast<int>((warmup + seconds) * 1000), &app, &QApplication::quit);
+        app.exec();
+
+        std::fprintf(stderr, "%-7s %10s %10s %10s %10s %10s %10s %10s  (us)\n", "stage", "samples", "p50", "p90",
+                     "p99", "p99.9", "max", "mean");
+        print_stage("parse", latency->parse);
+        print_stage("insert", latency->insert);
+        print_stage("paint", latency->paint);
+
+        std::FILE *out = stdout;
+        if(parser.isSet(outOption)) out = std::fopen(parser.value(outOption).toLocal8Bit().constData(), "w");
+        if(out) {
+            write_stage(out, "parse", latency->parse, run);
+            write_stage(out, "insert", latency->insert, run);
+            write_stage(out, "paint", latency->paint, run);
+            if(out != stdout) std::fclose(out);
+        }
+        else {
+            qCritical() << "Cannot write" << parser.value(outOption);
+            status = 1;
+        }
+        if(latency->paint.count() == 0) {
+            qCritical() << "No sample reached the screen; is the simulator streaming?";
+            status = 1;
+        }
+    }
+
+    backend.terminate();
+    if(!backend.waitForFinished(3000)) backend.kill();
+    return status;
+}
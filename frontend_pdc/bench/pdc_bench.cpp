@@ -0,0 +1,332 @@
+// Benchmark suite for the encode, decode and render hot paths.
+//
+// Runs headless; every case is timed by BenchReport (median of --repeats
+// calibrated batches) over several channel counts and window sizes:
+//   crc/*            CRC-CCITT engines over command, data and large frames
+//   encode/*         encode_data_frame, the simulator's per-frame work
+//   cfg2/*           create_config_frame2
+//   command/*        processCommandFrame against 1 and 1000 hosted PMUs
+//   decode/*         DataFrameDecoder::decode alone
+//   ingest/*         IngestWorker's read path: framing TCP-sized chunks,
+//                    decoding and queueing into the SampleRing
+//   m4/*             M4 decimation of a plotted window to 1200 columns
+//   fanout/*         one tick published to N subscribers (FramePublisher)
+//   render/*         PlotPane::updateData plus a paint, offscreen (only in
+//                    the qmake build, see render_bench.cpp)
+// Results go to stdout (or --out) as JSON lines, or CSV with --csv; progress
+// goes to stderr. --compare BASELINE exits with 2 if a case got more than
+// --tolerance slower than in the baseline run.
+//
+// Build: qmake bench.pro && make (everything, QT_QPA_PLATFORM=offscreen), or
+//        g++ -std=c++17 -O2 -I.. pdc_bench.cpp -o pdc_bench -lpthread (no render/*)
+
+#include "bench_report.h"
+
+#include "c37118_decoder.h"
+#include "c37118_framer.h"
+#include "crc_ccitt.h"
+#include "data_frame_encoder.h"
+#include "frame_publisher.h"
+#include "m4_decimator.h"
+#include "pmu_sim_engine.h"
+#include "sample_ring.h"
+#include "sim_frames.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#ifdef PDC_BENCH_RENDER
+void run_render_benches(BenchReport& report, int& argc, char** argv);
+#endif
+
+namespace {
+
+struct ChannelConfig {
+    uint16_t phnmr;
+    uint16_t annmr;
+    uint16_t dgnmr;
+
+    std::string label() const {
+        return std::to_string(phnmr) + "ph" + std::to_string(annmr) + "an" + std::to_string(dgnmr) + "dg";
+    }
+};
+
+// The simulator's default PMU, a substation PMU and two large PDC-like blocks.
+const ChannelConfig CHANNEL_CONFIGS[] = {{3, 4, 0}, {12, 8, 2}, {32, 16, 4}, {64, 32, 8}};
+
+const uint32_t SOC = 1700000000;
+
+std::vector<unsigned char> config_frame_for(const ChannelConfig& c, uint16_t idCode = 1) {
+    return create_config_frame2(idCode, 1000000, 1, "BENCH", 50, c.phnmr, c.annmr, c.dgnmr, true, true);
+}
+
+std::vector<unsigned char> data_frame_for(const DataFrameLayout& layout, uint16_t idCode, uint32_t fracsec) {
+    std::vector<float> phasors(2 * layout.phnmr, 230.0f);
+    std::vector<float> analogs(layout.annmr, 1.5f);
+    std::vector<uint16_t> digitals(layout.dgnmr, 0x5A5A);
+    std::vector<unsigned char> frame(layout.frameSize);
+    encode_data_frame(frame.data(), layout, idCode, SOC, fracsec, 0, phasors.data(), 50.01f, 0.1f,
+                      analogs.data(), digitals.data());
+    return frame;
+}
+
+void bench_crc(BenchReport& report) {
+    struct Impl {
+        const char* name;
+        uint16_t (*fn)(const unsigned char*, size_t);
+    };
+    const Impl impls[] = {
+        {"table", [](const unsigned char* d, size_t n) { return crc_ccitt_table(d, n); }},
+        {"slice8", [](const unsigned char* d, size_t n) { return crc_ccitt_slice8(d, n); }},
+        {"clmul", [](const unsigned char* d, size_t n) { return crc_ccitt_clmul(d, n); }},
+        {"calculate_crc", calculate_crc},
+    };
+    std::mt19937 rng(12345);
+    std::vector<unsigned char> buffer(65535);
+    for (unsigned char& b : buffer) b = static_cast<unsigned char>(rng());
+    // Command frame, default data frame, a large PDC frame, FRAMESIZE limit.
+    for (size_t len : {size_t(16), size_t(60), size_t(1024), size_t(65533)}) {
+        for (const Impl& impl : impls) {
+            // Checked against the bit-at-a-time reference before it is timed.
+            if (impl.fn(buffer.data(), len) != crc_ccitt_bitwise(buffer.data(), len)) {
+                std::fprintf(stderr, "crc/%s disagrees with the reference over %zu bytes\n", impl.name, len);
+                std::abort();
+            }
+            report.measure(std::string("crc/") + impl.name, std::to_string(len) + "B", double(len),
+                           [&]() { return impl.fn(buffer.data(), len); });
+        }
+    }
+}
+
+void bench_encode(BenchReport& report) {
+    for (const ChannelConfig& c : CHANNEL_CONFIGS) {
+        for (bool floatFmt : {true, false}) {
+            DataFrameLayout layout = make_data_frame_layout(c.phnmr, c.annmr, c.dgnmr, data_frame_format(floatFmt, true));
+            std::vector<float> phasors(2 * c.phnmr, 230.0f);
+            std::vector<float> analogs(c.annmr, 1.5f);
+            std::vector<uint16_t> digitals(c.dgnmr, 0);
+            std::vector<unsigned char> frame(layout.frameSize);
+            uint32_t fracsec = 0;
+            report.measure("encode/data", c.label() + (floatFmt ? "/float" : "/int"), double(layout.frameSize), [&]() {
+                fracsec = (fracsec + 20000) % 1000000;
+                phasors[0] += 0.001f;
+                return encode_data_frame(frame.data(), layout, 1, SOC, fracsec, 0, phasors.data(), 50.01f, 0.1f,
+                                         analogs.data(), digitals.data());
+            });
+        }
+    }
+}
+
+void bench_config(BenchReport& report) {
+    for (const ChannelConfig& c : CHANNEL_CONFIGS) {
+        size_t size = config_frame_for(c).size();
+        report.measure("cfg2/create", c.label(), double(size), [&]() { return config_frame_for(c).size(); });
+    }
+}
+
+void bench_command(BenchReport& report) {
+    for (size_t pmuCount : {size_t(1), size_t(1000)}) {
+        if (!report.wanted("command/process", std::to_string(pmuCount) + "pmus")) continue;
+        std::vector<VirtualPmuConfig> pmus(pmuCount);
+        for (size_t i = 0; i < pmuCount; ++i) pmus[i].idCode = static_cast<uint16_t>(i + 1);
+        PmuSimEngine engine(pmus, 0, false);
+
+        // TURN_ON_TX for the last PMU, the worst case of the IDCODE lookup.
+        unsigned char frame[18];
+        frame[0] = SYNC_CMD;
+        frame[1] = TYPE_CMD;
+        store_be16(frame + 2, sizeof(frame));
+        store_be16(frame + 4, static_cast<uint16_t>(pmuCount));
+        store_be32(frame + 6, SOC);
+        store_be32(frame + 10, 0);
+        store_be16(frame + 14, CMD_TURN_ON_TX);
+        store_be16(frame + 16, calculate_crc(frame, 16));
+        report.measure("command/process", std::to_string(pmuCount) + "pmus", double(sizeof(frame)), [&]() {
+            uint16_t pmuId = 0, command = 0;
+            processCommandFrame(frame, sizeof(frame), engine, pmuId, command);
+            return pmuId + command;
+        });
+    }
+}
+
+void bench_decode(BenchReport& report) {
+    for (const ChannelConfig& c : CHANNEL_CONFIGS) {
+        std::vector<unsigned char> cfgFrame = config_frame_for(c);
+        ConfigFrame cfg;
+        if (!parse_config_frame(cfgFrame.data(), cfgFrame.size(), cfg)) std::abort();
+        DataFrameDecoder decoder;
+        decoder.configure(cfg);
+        std::vector<unsigned char> frame = data_frame_for(cfg.pmus[0].layout, 1, 20000);
+        std::vector<double> row(decoder.channelCount());
+        FrameTime time;
+        report.measure("decode/data", c.label(), double(frame.size()), [&]() {
+            decoder.decode(frame.data(), frame.size(), row.data(), time);
+            return row[0];
+        });
+    }
+}
+
+// The loop of IngestWorker::onReadyRead and handleFrame: bytes arrive in
+// TCP-segment chunks, are framed (CRC checked), decoded and queued for the
+// GUI, which drains the ring every 1000 frames.
+void bench_ingest(BenchReport& report) {
+    const size_t SEGMENT = 1460;
+    for (const ChannelConfig& c : CHANNEL_CONFIGS) {
+        if (!report.wanted("ingest/frame", c.label())) continue;
+        std::vector<unsigned char> cfgFrame = config_frame_for(c);
+        ConfigFrame cfg;
+        if (!parse_config_frame(cfgFrame.data(), cfgFrame.size(), cfg)) std::abort();
+        DataFrameDecoder decoder;
+        decoder.configure(cfg);
+
+        std::vector<unsigned char> stream;
+        for (uint32_t i = 0; i < 1000; ++i) {
+            std::vector<unsigned char> frame = data_frame_for(cfg.pmus[0].layout, 1, i * 1000);
+            stream.insert(stream.end(), frame.begin(), frame.end());
+        }
+        StreamFramer framer;
+        SampleRing ring(decoder.channelCount(), 4096);
+        std::vector<double> row(decoder.channelCount());
+        size_t offset = 0;
+        size_t frames = 0;
+        double frameSize = double(decoder.expectedFrameSize());
+        report.measure("ingest/frame", c.label(), frameSize, [&]() {
+            FrameView frame;
+            while (!framer.next(frame)) {
+                size_t n = std::min({SEGMENT, stream.size() - offset, framer.writable()});
+                std::memcpy(framer.writePtr(), stream.data() + offset, n);
+                framer.commit(n);
+                offset = (offset + n) % stream.size();
+            }
+            FrameTime time;
+            decoder.decode(frame.data, frame.size, row.data(), time);
+            ring.push(time.seconds, row.data());
+            if (++frames % 1000 == 0) ring.drain([](double, const double*) {});
+            return row[0];
+        });
+    }
+}
+
+void bench_m4(BenchReport& report) {
+    const int COLUMNS = 1200;
+    for (size_t n : {size_t(1000), size_t(10000), size_t(100000), size_t(1000000)}) {
+        if (!report.wanted("m4/window", std::to_string(n))) continue;
+        std::vector<double> x(n), y(n);
+        for (size_t i = 0; i < n; ++i) {
+            x[i] = i * 0.02;
+            y[i] = 50.0 + 0.1 * std::sin(i * 0.001) + ((i * 7919) % 101) * 1e-4;
+        }
+        report.measure("m4/window", std::to_string(n) + "samples", 0.0, [&]() {
+            M4Decimator m4(x.front(), x.back(), COLUMNS);
+            double sum = 0.0;
+            auto emit = [&sum](double, double py) { sum += py; };
+            for (size_t i = 0; i < n; ++i) m4.add(x[i], y[i], emit);
+            m4.finish(emit);
+            return sum;
+        });
+    }
+}
+
+// One tick of 100 default PMUs published once and queued to every
+// subscriber; the queues are then consumed as if the sends completed.
+void bench_fanout(BenchReport& report) {
+    const size_t PMUS = 100;
+    DataFrameLayout layout = make_data_frame_layout(3, 4, 0, data_frame_format(true, true));
+    std::vector<unsigned char> arena;
+    for (size_t i = 0; i < PMUS; ++i) {
+        std::vector<unsigned char> frame = data_frame_for(layout, static_cast<uint16_t>(i + 1), 0);
+        arena.insert(arena.end(), frame.begin(), frame.end());
+    }
+    std::vector<EncodedFrame> frames;
+    for (size_t i = 0; i < PMUS; ++i) frames.push_back({arena.data() + i * layout.frameSize, layout.frameSize, i});
+
+    for (size_t subscribers : {size_t(1), size_t(10), size_t(100)}) {
+        if (!report.wanted("fanout/tick", std::to_string(subscribers))) continue;
+        FramePublisher publisher;
+        std::vector<FrameQueue> queues(subscribers);
+        std::vector<char> all(PMUS, 1);
+        std::vector<IoSlice> slices;
+        report.measure("fanout/tick", std::to_string(subscribers) + "subs", double(arena.size()), [&]() {
+            publisher.publish(frames);
+            size_t ranges = 0;
+            for (FrameQueue& queue : queues) {
+                publisher.enqueueTick(queue, all, PMUS);
+                ranges += queue.gather(slices);
+                queue.consume(queue.bytes());
+            }
+            return ranges;
+        });
+    }
+}
+
+void print_usage(const char* prog) {
+    std::fprintf(stderr,
+                 "Usage: %s [--filter TEXT] [--repeats N] [--csv] [--out FILE]\n"
+                 "          [--compare BASELINE.json] [--tolerance FRACTION]\n",
+                 prog);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    std::string filter;
+    std::string outPath;
+    std::string baseline;
+    int repeats = 5;
+    double tolerance = 0.10;
+    bool csv = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--filter" && hasValue) filter = argv[++i];
+        else if (arg == "--repeats" && hasValue) repeats = std::atoi(argv[++i]);
+        else if (arg == "--out" && hasValue) outPath = argv[++i];
+        else if (arg == "--compare" && hasValue) baseline = argv[++i];
+        else if (arg == "--tolerance" && hasValue) tolerance = std::atof(argv[++i]);
+        else if (arg == "--csv") csv = true;
+        else {
+            print_usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    // Command handling logs at Info; keep the logger quiet and its thread off.
+    pmuLogger.setLevel(LogLevel::Warn);
+
+    BenchReport report(repeats, filter);
+    bench_crc(report);
+    bench_encode(report);
+    bench_config(report);
+    bench_command(report);
+    bench_decode(report);
+    bench_ingest(report);
+    bench_m4(report);
+    bench_fanout(report);
+#ifdef PDC_BENCH_RENDER
+    run_render_benches(report, argc, argv);
+#endif
+
+    std::FILE* out = outPath.empty() ? stdout : std::fopen(outPath.c_str(), "w");
+    if (!out) {
+        std::fprintf(stderr, "Cannot write %s\n", outPath.c_str());
+        return EXIT_FAILURE;
+    }
+    if (csv) report.writeCsv(out);
+    else report.writeJson(out);
+    if (out != stdout) std::fclose(out);
+
+    if (!baseline.empty()) {
+        int regressions = report.compare(baseline, tolerance);
+        if (regressions < 0) {
+            std::fprintf(stderr, "Cannot read baseline %s\n", baseline.c_str());
+            return EXIT_FAILURE;
+        }
+        if (regressions > 0) return 2;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,127 @@
+// render/* cases of the benchmark suite: one display tick of the GUI's plot
+// update path on the offscreen platform. Each tick advances the live window
+// by one sample, as auto-scroll does, refills the panes the way
+// MainWindow::updatePane does (M4-decimated points into PlotPane::updateData
+// for QtCharts, refresh() of the raster PlotWidget) and lets the event loop
+// deliver the scene updates and paint, so the time includes QtCharts' scene
+// work or the raster strokes plus the paint itself.
+
+#include "bench_report.h"
+
+#include "m4_decimator.h"
+#include "mainwindow.h"
+
+#include <QApplication>
+#include <QGridLayout>
+#include <QWidget>
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+namespace {
+
+const double SAMPLE_PERIOD = 0.02;   // 50 frames/s
+const size_t SCROLL_SAMPLES = 5000;  // Extra history the window scrolls through
+
+struct Trace {
+    std::vector<double> x;
+    std::vector<double> y;
+
+    explicit Trace(size_t n) : x(n), y(n) {
+        for(size_t i = 0; i < n; ++i) {
+            x[i] = i * SAMPLE_PERIOD;
+            y[i] = 50.0 + 0.05 * std::sin(i * 0.01) + ((i * 7919) % 101) * 1e-4;
+        }
+    }
+
+    size_t lowerBound(double t) const {
+        return static_cast<size_t>(std::lower_bound(x.begin(), x.end(), t) - x.begin());
+    }
+
+    void decimate(size_t begin, size_t end, int columns, QVector<QPointF> &out) const {
+        out.clear();
+        if(begin >= end) return;
+        M4Decimator m4(x[begin], x[end - 1], columns);
+        auto append = [&out](double px, double py) { out.append(QPointF(px, py)); };
+        for(size_t i = begin; i < end; ++i) m4.add(x[i], y[i], append);
+        m4.finish(append);
+    }
+
+    void extent(size_t begin, size_t end, double &lo, double &hi) const {
+        auto range = std::minmax_element(y.begin() + begin, y.begin() + end);
+        lo = *range.first;
+        hi = *range.second;
+    }
+};
+
+} // namespace
+
+void run_render_benches(BenchReport &report, int &argc, char **argv)
+{
+    if(qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) qputenv("QT_QPA_PLATFORM", "offscreen");
+    QApplication app(argc, argv);
+
+    for(int paneCount : {1, 16}) {
+        for(size_t samples : {size_t(100), size_t(1000), size_t(10000), size_t(100000)}) {
+            for(bool raster : {false, true}) {
+                std::string variant = std::to_string(paneCount) + "x" + std::to_string(samples) + "samples/" +
+                                      (raster ? "raster" : "charts");
+                if(!report.wanted("render/tick", variant)) continue;
+
+                Trace trace(samples + SCROLL_SAMPLES);
+                QWidget window;
+                window.resize(1600, 900);
+                QGridLayout *layout = new QGridLayout(&window);
+                int columns = static_cast<int>(std::ceil(std::sqrt(static_cast<double>(paneCount))));
+                std::vector<PlotPane*> panes;
+                for(int p = 0; p < paneCount; ++p) {
+                    PlotPane *pane = new PlotPane("Frequency", paneCount > 1);
+                    pane->setChannel(0, "Frequency", "Hz", Qt::red);
+                    pane->rasterPlot()->setSource([&trace](double from, double to, int cols, QVector<QPointF> &out) {
+                        trace.decimate(trace.lowerBound(from), trace.lowerBound(to + SAMPLE_PERIOD / 2), cols, out);
+                    });
+                    pane->rasterPlot()->setRangeSource([&trace](double from, double to, double &lo, double &hi) {
+                        size_t begin = trace.lowerBound(from), end = trace.lowerBound(to + SAMPLE_PERIOD / 2);
+                        if(begin >= end) return false;
+                        trace.extent(begin, end, lo, hi);
+                        return true;
+                    });
+                    pane->setRaster(raster);
+                    layout->addWidget(pane, p / columns, p % columns);
+                    panes.push_back(pane);
+                }
+                window.show();
+                QApplication::processEvents();
+
+                size_t start = 0;
+                report.measure("render/tick", variant, 0.0, [&]() {
+                    start = (start + 1) % SCROLL_SAMPLES;
+                    PlotWindow plotWindow;
+                    plotWindow.start = start;
+                    plotWindow.end = start + samples;
+                    plotWindow.x0 = trace.x[plotWindow.start];
+                    plotWindow.x1 = trace.x[plotWindow.end - 1];
+                    plotWindow.rasterX1 = plotWindow.x0 + samples * SAMPLE_PERIOD;
+                    int points = 0;
+                    for(PlotPane *pane : panes) {
+                        if(raster) {
+                            pane->rasterPlot()->setXRange(plotWindow.x0, plotWindow.rasterX1);
+                            pane->rasterPlot()->refresh();
+                            continue;
+                        }
+                        QVector<QPointF> &buffer = pane->pointBuffer();
+                        trace.decimate(plotWindow.start, plotWindow.end, pane->plotColumns(), buffer);
+                        double lo = 0.0, hi = 0.0;
+                        trace.extent(plotWindow.start, plotWindow.end, lo, hi);
+                        pane->updateData(plotWindow, lo, hi);
+                        points += buffer.size();
+                    }
+                    QApplication::processEvents();
+                    return points;
+                });
+            }
+        }
+    }
+}
@@ -0,0 +1,335 @@
+#ifndef C37118_DECODER_H
+#define C37118_DECODER_H
+
+// Receive side of IEEE C37.118.2 for the PDC frontend.
+//
+// parse_config_frame() turns a CFG-2 frame into one DataFrameLayout per PMU
+// block; DataFrameDecoder then decodes data frames of that configuration
+// straight from the receive buffer into a row of engineering values, one per
+// plotted channel: per phasor magnitude, angle (rad) and angle (deg), then
+// frequency, ROCOF, analogs and digital words. Frames are cut out of the byte
+// stream by StreamFramer (c37118_framer.h).
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "c37118_layout.h"
+#include "crc_ccitt.h"
+
+// Frame type field (bits 6-4 of the second SYNC byte).
+enum class FrameType : uint8_t {
+    Data = 0,
+    Header = 1,
+    Config1 = 2,
+    Config2 = 3,
+    Command = 4,
+    Config3 = 5
+};
+
+inline FrameType frame_type(const unsigned char* frame) {
+    return static_cast<FrameType>((frame[1] >> 4) & 0x07);
+}
+
+// --- Configuration ---
+struct PmuBlockConfig {
+    std::string stationName;
+    uint16_t idCode = 0;
+    uint16_t format = 0;
+    std::vector<std::string> phasorNames;
+    std::vector<std::string> analogNames;
+    std::vector<std::string> digitalNames;  // 16 per digital word
+    std::vector<uint32_t> phasorUnits;      // PHUNIT: type << 24 | scale (1e-5 V or A per bit)
+    std::vector<uint32_t> analogUnits;      // ANUNIT: type << 24 | signed 24-bit scale
+    float nominalFreq = 50.0f;
+    uint16_t cfgCount = 0;
+    DataFrameLayout layout;                 // Offsets as if this were a single-PMU frame
+};
+
+struct ConfigFrame {
+    uint16_t idCode = 0;    // IDCODE of the data stream (PMU or PDC)
+    uint32_t timeBase = 1000000;
+    int16_t dataRate = 0;   // > 0 frames per second, < 0 seconds per frame
+    std::vector<PmuBlockConfig> pmus;
+
+    double framePeriod() const {
+        if (dataRate > 0) return 1.0 / dataRate;
+        if (dataRate < 0) return -static_cast<double>(dataRate);
+        return 0.0;
+    }
+};
+
+// Fixed 16-byte name field without NUL or space padding.
+inline std::string trimmed_name(const unsigned char* p, size_t n) {
+    std::string s(reinterpret_cast<const char*>(p), n);
+    s.erase(std::min(s.find('\0'), s.size()));
+    s.erase(s.find_last_not_of(' ') + 1);
+    return s;
+}
+
+// Parses a complete, CRC-checked CFG-1 or CFG-2 frame. Returns false if the
+// frame is truncated or inconsistent.
+inline bool parse_config_frame(const unsigned char* frame, size_t len, ConfigFrame& cfg) {
+    if (len < 24) return false;
+    FrameType type = frame_type(frame);
+    if (type != FrameType::Config1 && type != FrameType::Config2) return false;
+
+    cfg = ConfigFrame();
+    cfg.idCode = load_be16(frame + 4);
+    cfg.timeBase = load_be32(frame + 14) & 0x00FFFFFF;
+    if (cfg.timeBase == 0) return false;
+    uint16_t numPmu = load_be16(frame + 18);
+
+    const size_t end = len - 2;  // CHK
+    size_t pos = 20;
+    for (uint16_t k = 0; k < numPmu; ++k) {
+        if (pos + 26 > end) return false;
+        PmuBlockConfig pmu;
+        pmu.stationName = trimmed_name(frame + pos, 16);
+        pmu.idCode = load_be16(frame + pos + 16);
+        pmu.format = load_be16(frame + pos + 18);
+        uint16_t phnmr = load_be16(frame + pos + 20);
+        uint16_t annmr = load_be16(frame + pos + 22);
+        uint16_t dgnmr = load_be16(frame + pos + 24);
+        pos += 26;
+
+        size_t names = static_cast<size_t>(phnmr) + annmr + 16u * dgnmr;
+        size_t units = static_cast<size_t>(phnmr) + annmr + dgnmr;
+        if (pos + 16 * names + 4 * units + 4 > end) return false;
+        for (uint16_t i = 0; i < phnmr; ++i, pos += 16)
+            pmu.phasorNames.push_back(trimmed_name(frame + pos, 16));
+        for (uint16_t i = 0; i < annmr; ++i, pos += 16)
+            pmu.analogNames.push_back(trimmed_name(frame + pos, 16));
+        for (size_t i = 0; i < 16u * dgnmr; ++i, pos += 16)
+            pmu.digitalNames.push_back(trimmed_name(frame + pos, 16));
+        for (uint16_t i = 0; i < phnmr; ++i, pos += 4)
+            pmu.phasorUnits.push_back(load_be32(frame + pos));
+        for (uint16_t i = 0; i < annmr; ++i, pos += 4)
+            pmu.analogUnits.push_back(load_be32(frame + pos));
+        pos += 4u * dgnmr;  // DIGUNIT masks are not needed for plotting
+
+        pmu.nominalFreq = (load_be16(frame + pos) & 0x0001) ? 50.0f : 60.0f;
+        pmu.cfgCount = load_be16(frame + pos + 2);
+        pos += 4;
+
+        pmu.layout = make_data_frame_layout(phnmr, annmr, dgnmr, pmu.format);
+        cfg.pmus.push_back(std::move(pmu));
+    }
+    if (pos + 2 != end) return false;
+    cfg.dataRate = static_cast<int16_t>(load_be16(frame + pos));
+    return !cfg.pmus.empty();
+}
+
+// --- Decoded channels ---
+enum class ChannelKind : uint8_t {
+    PhasorMagnitude,
+    PhasorAngleRad,
+    PhasorAngleDeg,
+    Frequency,
+    Rocof,
+    Analog,
+    Digital
+};
+
+struct ChannelInfo {
+    ChannelKind kind;
+    std::string name;
+    std::string unit;
+    bool float32;  // Value is a float32 field (or a 16-bit word) on the wire
+};
+
+// Channels in the order DataFrameDecoder::decode() writes them. Station names
+// prefix the labels when the stream carries more than one PMU.
+inline std::vector<ChannelInfo> decoded_channels(const ConfigFrame& cfg) {
+    std::vector<ChannelInfo> channels;
+    bool multi = cfg.pmus.size() > 1;
+    for (const PmuBlockConfig& pmu : cfg.pmus) {
+        std::string prefix = multi ? pmu.stationName + " / " : std::string();
+        for (size_t i = 0; i < pmu.phasorNames.size(); ++i) {
+            std::string name = prefix + pmu.phasorNames[i];
+            bool current = ((pmu.phasorUnits[i] >> 24) & 0xFF) == 1;
+            bool phasorFloat = pmu.layout.phasorFloat;
+            channels.push_back({ChannelKind::PhasorMagnitude, name + " Magnitude", current ? "Amps" : "Volts", phasorFloat});
+            channels.push_back({ChannelKind::PhasorAngleRad, name + " Angle (rad)", "rad", phasorFloat});
+            channels.push_back({ChannelKind::PhasorAngleDeg, name + " Angle (deg)", "deg", phasorFloat});
+        }
+        channels.push_back({ChannelKind::Frequency, prefix + "Frequency", "Hz", pmu.layout.freqFloat});
+        channels.push_back({ChannelKind::Rocof, prefix + "ROCOF", "Hz/s", pmu.layout.freqFloat});
+        for (const std::string& name : pmu.analogNames)
+            channels.push_back({ChannelKind::Analog, prefix + name, "a.u.", pmu.layout.analogFloat});
+        for (uint16_t i = 0; i < pmu.layout.dgnmr; ++i)
+            channels.push_back({ChannelKind::Digital, prefix + "Digital " + std::to_string(i + 1), "bits", true});
+    }
+    return channels;
+}
+
+// --- Data frame decoder ---
+struct FrameTime {
+    uint32_t soc = 0;
+    uint32_t fracsec = 0;      // Without the time quality byte
+    uint8_t timeQuality = 0;
+    double seconds = 0.0;      // soc + fracsec / TIME_BASE
+};
+
+// The frame's time in ns since the epoch, without the rounding of seconds.
+inline int64_t frame_time_ns(const FrameTime& t) {
+    return int64_t(t.soc) * 1000000000 + static_cast<int64_t>((t.seconds - t.soc) * 1e9);
+}
+
+class DataFrameDecoder
+{
+public:
+    void configure(const ConfigFrame& cfg) {
+        idCode = cfg.idCode;
+        timeBase = cfg.timeBase;
+        blocks.clear();
+        channels = 0;
+        size_t offset = 14;  // First STAT
+        size_t maxWords = 0;
+        for (const PmuBlockConfig& pmu : cfg.pmus) {
+            Block b;
+            b.layout = pmu.layout;
+            b.shift = offset - pmu.layout.statOffset;
+            b.nominalFreq = pmu.nominalFreq;
+            for (uint32_t unit : pmu.phasorUnits)
+                b.phasorScale.push_back((unit & 0x00FFFFFF) * 1e-5);
+            for (uint32_t unit : pmu.analogUnits) {
+                int32_t scale = static_cast<int32_t>(unit << 8) >> 8;  // Signed 24-bit
+                b.analogScale.push_back(static_cast<double>(scale));
+            }
+            maxWords = std::max<size_t>(maxWords, 2u * b.layout.phnmr + 2 + b.layout.annmr);
+            channels += 3u * b.layout.phnmr + 2 + b.layout.annmr + b.layout.dgnmr;
+            offset += b.layout.chkOffset - b.layout.statOffset;
+            blocks.push_back(std::move(b));
+        }
+        frameSize = offset + 2;
+        words.resize(maxWords);
+    }
+
+    bool configured() const { return !blocks.empty(); }
+    size_t channelCount() const { return channels; }
+    size_t expectedFrameSize() const { return frameSize; }
+
+    // Decodes a complete, CRC-checked data frame of the configured stream
+    // into channelCount() values. Returns false for frames of another
+    // stream or size.
+    bool decode(const unsigned char* frame, size_t len, double* out, FrameTime& time) {
+        if (len != frameSize || frame_type(frame) != FrameType::Data || load_be16(frame + 4) != idCode)
+            return false;
+
+        time.soc = load_be32(frame + 6);
+        uint32_t fracsec = load_be32(frame + 10);
+        time.timeQuality = static_cast<uint8_t>(fracsec >> 24);
+        time.fracsec = fracsec & 0x00FFFFFF;
+        time.seconds = time.soc + static_cast<double>(time.fracsec) / timeBase;
+
+        for (const Block& b : blocks)
+            out = decodeBlock(b, frame + b.shift, out);
+        return true;
+    }
+
+private:
+    static constexpr double RAD_TO_DEG = 180.0 / 3.14159265358979323846;
+
+    struct Block {
+        DataFrameLayout layout;
+        size_t shift = 0;  // Frame offset of this block minus its single-PMU offset
+        float nominalFreq = 50.0f;
+        std::vector<double> phasorScale;
+        std::vector<double> analogScale;
+    };
+
+    double* decodeBlock(const Block& b, const unsigned char* f, double* out) {
+        const DataFrameLayout& l = b.layout;
+
+        // All-float blocks: PHASORS..ANALOG is one run of big-endian words.
+        const float* values = nullptr;
+        if (l.floatFmt) {
+            size_t n = 2u * l.phnmr + 2 + l.annmr;
+            load_be32_block(f + l.phasorOffset, words.data(), n);
+            values = reinterpret_cast<const float*>(words.data());
+        }
+
+        const unsigned char* p = f + l.phasorOffset;
+        for (size_t i = 0; i < l.phnmr; ++i) {
+            double a, c;
+            if (values) {
+                a = values[2 * i];
+                c = values[2 * i + 1];
+            } else if (l.phasorFloat) {
+                a = load_be_float(p);
+                c = load_be_float(p + 4);
+            } else if (l.polarFmt) {
+                a = load_be16(p) * b.phasorScale[i];
+                c = static_cast<int16_t>(load_be16(p + 2)) * 1e-4;
+            } else {
+                a = static_cast<int16_t>(load_be16(p)) * b.phasorScale[i];
+                c = static_cast<int16_t>(load_be16(p + 2)) * b.phasorScale[i];
+            }
+            p += l.phasorSize;
+
+            double mag = a, angle = c;
+            if (!l.polarFmt) {
+                mag = std::hypot(a, c);
+                angle = std::atan2(c, a);
+            }
+            *out++ = mag;
+            *out++ = angle;
+            *out++ = angle * RAD_TO_DEG;
+        }
+
+        if (values) {
+            *out++ = values[2 * l.phnmr];
+            *out++ = values[2 * l.phnmr + 1];
+        } else if (l.freqFloat) {
+            *out++ = load_be_float(f + l.freqOffset);
+            *out++ = load_be_float(f + l.dfreqOffset);
+        } else {
+            *out++ = b.nominalFreq + static_cast<int16_t>(load_be16(f + l.freqOffset)) * 1e-3;
+            *out++ = static_cast<int16_t>(load_be16(f + l.dfreqOffset)) * 1e-2;
+        }
+
+        p = f + l.analogOffset;
+        for (size_t i = 0; i < l.annmr; ++i, p += l.analogSize) {
+            if (values)
+                *out++ = values[2 * l.phnmr + 2 + i];
+            else if (l.analogFloat)
+                *out++ = load_be_float(p);
+            else
+                *out++ = static_cast<int16_t>(load_be16(p)) * b.analogScale[i];
+        }
+
+        p = f + l.digitalOffset;
+        for (size_t i = 0; i < l.dgnmr; ++i, p += 2)
+            *out++ = load_be16(p);
+        return out;
+    }
+
+    uint16_t idCode = 0;
+    uint32_t timeBase = 1000000;
+    std::vector<Block> blocks;
+    size_t channels = 0;
+    size_t frameSize = 0;
+    std::vector<uint32_t> words;  // Byte-swapped float scratch
+};
+
+// --- Commands ---
+const size_t COMMAND_FRAME_SIZE = 18;
+
+// Standard command frame: SYNC FRAMESIZE IDCODE SOC FRACSEC CMD CHK.
+inline void build_command_frame(unsigned char* out, uint16_t idCode, uint16_t command,
+                                uint32_t soc, uint32_t fracsec = 0) {
+    out[0] = SYNC_CMD;
+    out[1] = TYPE_CMD;
+    store_be16(out + 2, static_cast<uint16_t>(COMMAND_FRAME_SIZE));
+    store_be16(out + 4, idCode);
+    store_be32(out + 6, soc);
+    store_be32(out + 10, fracsec);
+    store_be16(out + 14, command);
+    store_be16(out + 16, calculate_crc(out, 16));
+}
+
+#endif // C37118_DECODER_H
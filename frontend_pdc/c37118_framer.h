@@ -0,0 +1,150 @@
+#ifndef C37118_FRAMER_H
+#define C37118_FRAMER_H
+
+// Incremental frame reassembly for C37.118.2 byte streams (TCP).
+//
+// StreamFramer owns a per-connection ring buffer. Bytes are received straight
+// into it (writePtr()/commit()) or copied in with append(); next() then scans
+// for SYNC 0xAA, uses FRAMESIZE to find the frame boundary and hands back a
+// view of each complete frame whose CHK matches. Partial frames stay buffered
+// until the rest arrives, coalesced frames come out one by one, and garbage
+// is skipped a byte at a time until the stream resynchronizes.
+//
+// Views point into the ring and stay valid until the next commit()/append().
+// Only a frame that wraps around the end of the ring is copied (into a
+// linear scratch buffer) to keep its view contiguous.
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "c37118_layout.h"
+#include "crc_ccitt.h"
+
+struct FrameView {
+    const unsigned char* data = nullptr;
+    size_t size = 0;
+};
+
+class StreamFramer
+{
+public:
+    // Compact SYNC FRAMESIZE IDCODE CMD CHK command frames of older clients
+    // are the shortest frames accepted.
+    static const size_t MIN_FRAME_SIZE = 10;
+
+    // capacity is rounded up to a power of two and bounds the largest frame
+    // that can be reassembled; longer FRAMESIZE values are treated as noise.
+    explicit StreamFramer(size_t capacity = 128 * 1024) {
+        size_t cap = 64;
+        while (cap < capacity) cap <<= 1;
+        ring.resize(cap);
+        mask = cap - 1;
+    }
+
+    void reset() {
+        head = tail = 0;
+    }
+
+    size_t capacity() const { return ring.size(); }
+    size_t buffered() const { return tail - head; }
+
+    // Contiguous free space at the write position.
+    unsigned char* writePtr() { return ring.data() + (tail & mask); }
+    size_t writable() const {
+        return std::min(ring.size() - buffered(), ring.size() - (tail & mask));
+    }
+    void commit(size_t n) { tail += n; }
+
+    // Copies up to len bytes in; returns how many fit.
+    size_t append(const void* data, size_t len) {
+        const unsigned char* src = static_cast<const unsigned char*>(data);
+        size_t copied = 0;
+        while (copied < len && writable() > 0) {
+            size_t n = std::min(len - copied, writable());
+            std::memcpy(writePtr(), src + copied, n);
+            commit(n);
+            copied += n;
+        }
+        return copied;
+    }
+
+    // Returns the next complete, CHK-valid frame, or false if more bytes are
+    // needed.
+    bool next(FrameView& frame) {
+        while (buffered() >= 4) {
+            if (!seekSync() || buffered() < 4) return false;
+
+            uint8_t type = at(1);
+            size_t size = (static_cast<size_t>(at(2)) << 8) | at(3);
+            if ((type & 0x80) != 0 || ((type >> 4) & 0x07) > 5 || size < MIN_FRAME_SIZE || size > ring.size()) {
+                skip(1);
+                continue;
+            }
+            if (buffered() < size) return false;
+
+            const unsigned char* p = contiguous(size);
+            if (calculate_crc(p, size - 2) != load_be16(p + size - 2)) {
+                ++crcFailures;
+                skip(1);
+                continue;
+            }
+            head += size;
+            ++frameCount;
+            frame.data = p;
+            frame.size = size;
+            return true;
+        }
+        return false;
+    }
+
+    uint64_t framesExtracted() const { return frameCount; }
+    uint64_t bytesSkipped() const { return skippedBytes; }
+    uint64_t crcErrors() const { return crcFailures; }
+
+private:
+    unsigned char at(size_t i) const { return ring[(head + i) & mask]; }
+
+    void skip(size_t n) {
+        head += n;
+        skippedBytes += n;
+    }
+
+    // Drops bytes up to the next SYNC byte; false if none is buffered.
+    bool seekSync() {
+        while (buffered() > 0) {
+            size_t offset = head & mask;
+            size_t run = std::min(buffered(), ring.size() - offset);
+            const void* hit = std::memchr(ring.data() + offset, SYNC_DATA, run);
+            if (hit) {
+                skip(static_cast<const unsigned char*>(hit) - (ring.data() + offset));
+                return true;
+            }
+            skip(run);
+        }
+        return false;
+    }
+
+    const unsigned char* contiguous(size_t size) {
+        size_t offset = head & mask;
+        if (offset + size <= ring.size()) return ring.data() + offset;
+        size_t first = ring.size() - offset;
+        linear.resize(size);
+        std::memcpy(linear.data(), ring.data() + offset, first);
+        std::memcpy(linear.data() + first, ring.data(), size - first);
+        return linear.data();
+    }
+
+    std::vector<unsigned char> ring;
+    std::vector<unsigned char> linear;  // Wrapped frames only
+    size_t mask = 0;
+    size_t head = 0;  // Read position, monotonically increasing
+    size_t tail = 0;  // Write position
+    uint64_t frameCount = 0;
+    uint64_t skippedBytes = 0;
+    uint64_t crcFailures = 0;
+};
+
+#endif // C37118_FRAMER_H
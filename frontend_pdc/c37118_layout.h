@@ -0,0 +1,205 @@
+#ifndef C37118_LAYOUT_H
+#define C37118_LAYOUT_H
+
+// Byte-order helpers and the fixed data frame layout of IEEE C37.118.2.
+// A data frame for a single PMU is
+//   SYNC(2) FRAMESIZE(2) IDCODE(2) SOC(4) FRACSEC(4) STAT(2)
+//   PHASORS(PHNMR * 4|8) FREQ(2|4) DFREQ(2|4) ANALOG(ANNMR * 2|4)
+//   DIGITAL(DGNMR * 2) CHK(2)
+// so every offset follows from the channel counts and the format flags.
+// The FORMAT word of CFG-2 selects the encoding of each field group:
+//   bit 0 phasors polar (1) / rectangular (0)   bit 1 phasors float
+//   bit 2 analogs float                         bit 3 FREQ/DFREQ float
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define C37118_LITTLE_ENDIAN 1
+#elif defined(_WIN32)
+#define C37118_LITTLE_ENDIAN 1
+#else
+#define C37118_LITTLE_ENDIAN 0
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define C37118_HAVE_SSE2 1
+#include <emmintrin.h>
+#else
+#define C37118_HAVE_SSE2 0
+#endif
+
+// --- Constants based on IEEE C37.118.2 ---
+const uint8_t SYNC_DATA = 0xAA;
+const uint8_t SYNC_HDR = 0xAA;
+const uint8_t SYNC_CFG1 = 0xAA;
+const uint8_t SYNC_CFG2 = 0xAA;
+const uint8_t SYNC_CMD = 0xAA;
+
+const uint8_t TYPE_DATA = 0x01;
+const uint8_t TYPE_HDR = 0x11;
+const uint8_t TYPE_CFG1 = 0x21;
+const uint8_t TYPE_CFG2 = 0x31;
+const uint8_t TYPE_CMD = 0x41;
+
+const uint16_t CMD_TURN_OFF_TX = 0x0001;
+const uint16_t CMD_TURN_ON_TX = 0x0002;
+const uint16_t CMD_SEND_HDR = 0x0003;
+const uint16_t CMD_SEND_CFG1 = 0x0004;
+const uint16_t CMD_SEND_CFG2 = 0x0005;
+
+const uint16_t FORMAT_POLAR = 0x0001;
+const uint16_t FORMAT_PHASOR_FLOAT = 0x0002;
+const uint16_t FORMAT_ANALOG_FLOAT = 0x0004;
+const uint16_t FORMAT_FREQ_FLOAT = 0x0008;
+
+// --- Big-endian loads and stores ---
+inline uint16_t c37_bswap16(uint16_t v) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_bswap16(v);
+#else
+    return static_cast<uint16_t>((v >> 8) | (v << 8));
+#endif
+}
+
+inline uint32_t c37_bswap32(uint32_t v) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_bswap32(v);
+#else
+    return (v >> 24) | ((v >> 8) & 0x0000FF00u) | ((v << 8) & 0x00FF0000u) | (v << 24);
+#endif
+}
+
+inline void store_be16(unsigned char* p, uint16_t v) {
+#if C37118_LITTLE_ENDIAN
+    v = c37_bswap16(v);
+#endif
+    std::memcpy(p, &v, sizeof(v));
+}
+
+inline void store_be32(unsigned char* p, uint32_t v) {
+#if C37118_LITTLE_ENDIAN
+    v = c37_bswap32(v);
+#endif
+    std::memcpy(p, &v, sizeof(v));
+}
+
+inline void store_be_float(unsigned char* p, float f) {
+    uint32_t v;
+    std::memcpy(&v, &f, sizeof(v));
+    store_be32(p, v);
+}
+
+inline uint16_t load_be16(const unsigned char* p) {
+    uint16_t v;
+    std::memcpy(&v, p, sizeof(v));
+#if C37118_LITTLE_ENDIAN
+    v = c37_bswap16(v);
+#endif
+    return v;
+}
+
+inline uint32_t load_be32(const unsigned char* p) {
+    uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+#if C37118_LITTLE_ENDIAN
+    v = c37_bswap32(v);
+#endif
+    return v;
+}
+
+inline float load_be_float(const unsigned char* p) {
+    uint32_t v = load_be32(p);
+    float f;
+    std::memcpy(&f, &v, sizeof(f));
+    return f;
+}
+
+// Converts n consecutive big-endian 32-bit words. SSE2 swaps four per step.
+inline void load_be32_block(const unsigned char* src, uint32_t* dst, size_t n) {
+    size_t i = 0;
+#if C37118_HAVE_SSE2
+    for (; i + 4 <= n; i += 4) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 4 * i));
+        v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));   // Bytes within 16-bit halves
+        v = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, 0xB1), 0xB1);   // Halves within words
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), v);
+    }
+#endif
+    for (; i < n; ++i)
+        dst[i] = load_be32(src + 4 * i);
+}
+
+// --- Data frame layout ---
+struct DataFrameLayout {
+    uint16_t phnmr = 0;
+    uint16_t annmr = 0;
+    uint16_t dgnmr = 0;
+    bool floatFmt = true;     // Every field group in float
+    bool polarFmt = true;
+    bool phasorFloat = true;
+    bool analogFloat = true;
+    bool freqFloat = true;
+
+    size_t phasorSize = 0;   // Bytes per phasor
+    size_t freqSize = 0;     // Bytes for FREQ and for DFREQ each
+    size_t analogSize = 0;   // Bytes per analog value
+
+    size_t idcodeOffset = 4;
+    size_t socOffset = 6;
+    size_t fracsecOffset = 10;
+    size_t statOffset = 14;
+    size_t phasorOffset = 16;
+    size_t freqOffset = 0;
+    size_t dfreqOffset = 0;
+    size_t analogOffset = 0;
+    size_t digitalOffset = 0;
+    size_t chkOffset = 0;
+    size_t frameSize = 0;
+};
+
+constexpr uint16_t data_frame_format(bool floatFmt, bool polarFmt) {
+    return static_cast<uint16_t>((polarFmt ? FORMAT_POLAR : 0) |
+        (floatFmt ? FORMAT_PHASOR_FLOAT | FORMAT_ANALOG_FLOAT | FORMAT_FREQ_FLOAT : 0));
+}
+
+// Layout for the FORMAT word of a CFG-2 PMU block.
+constexpr DataFrameLayout make_data_frame_layout(
+    uint16_t phnmr, uint16_t annmr, uint16_t dgnmr, uint16_t format)
+{
+    DataFrameLayout l;
+    l.phnmr = phnmr;
+    l.annmr = annmr;
+    l.dgnmr = dgnmr;
+    l.polarFmt = (format & FORMAT_POLAR) != 0;
+    l.phasorFloat = (format & FORMAT_PHASOR_FLOAT) != 0;
+    l.analogFloat = (format & FORMAT_ANALOG_FLOAT) != 0;
+    l.freqFloat = (format & FORMAT_FREQ_FLOAT) != 0;
+    l.floatFmt = l.phasorFloat && l.analogFloat && l.freqFloat;
+
+    l.phasorSize = l.phasorFloat ? 8 : 4;
+    l.freqSize = l.freqFloat ? 4 : 2;
+    l.analogSize = l.analogFloat ? 4 : 2;
+
+    l.freqOffset = l.phasorOffset + phnmr * l.phasorSize;
+    l.dfreqOffset = l.freqOffset + l.freqSize;
+    l.analogOffset = l.dfreqOffset + l.freqSize;
+    l.digitalOffset = l.analogOffset + annmr * l.analogSize;
+    l.chkOffset = l.digitalOffset + dgnmr * 2;
+    l.frameSize = l.chkOffset + 2;
+    return l;
+}
+
+constexpr DataFrameLayout make_data_frame_layout(
+    uint16_t phnmr, uint16_t annmr, uint16_t dgnmr, bool floatFmt, bool polarFmt)
+{
+    return make_data_frame_layout(phnmr, annmr, dgnmr, data_frame_format(floatFmt, polarFmt));
+}
+
+constexpr uint16_t data_frame_format(const DataFrameLayout& l) {
+    return static_cast<uint16_t>((l.polarFmt ? FORMAT_POLAR : 0) | (l.phasorFloat ? FORMAT_PHASOR_FLOAT : 0) |
+        (l.analogFloat ? FORMAT_ANALOG_FLOAT : 0) | (l.freqFloat ? FORMAT_FREQ_FLOAT : 0));
+}
+
+#endif // C37118_LAYOUT_H
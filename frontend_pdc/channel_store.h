@@ -0,0 +1,275 @@
+#ifndef CHANNEL_STORE_H
+#define CHANNEL_STORE_H
+
+// Bounded sample history behind the frontend plots.
+//
+// ChannelStore keeps decoded rows in fixed-size chunks laid out as structure
+// of arrays: a timestamp column plus one column per channel, so drawing a
+// channel walks contiguous memory. Channels whose source is float32 are kept
+// as float, the others as double. The capacity follows from the retention
+// (a time span and/or a memory cap) and is fixed by configure(): once it is
+// reached the oldest chunk is recycled for new samples, so a session left
+// running for days neither grows nor reallocates.
+//
+// Samples are addressed 0..size()-1, oldest first. Whole chunks are dropped
+// at a time; firstIndex() counts every sample dropped so far so that callers
+// holding an index (scroll position) can rebase it.
+//
+// For Y autoscaling every channel also keeps a min/max segment tree over
+// blocks of EXTREMA_BLOCK samples, updated on append. extrema() answers any
+// window from the tree plus at most two partial blocks, so its cost does not
+// depend on the window length.
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+struct Retention {
+    double seconds = 3600.0;        // History span to keep, 0 = no time limit
+    size_t maxBytes = 256u << 20;   // Sample memory cap, 0 = no cap
+};
+
+class ChannelStore
+{
+public:
+    static const size_t CHUNK_SAMPLES = 4096;
+    static const size_t DEFAULT_MAX_BYTES = 256u << 20;  // Used when neither limit is set
+    static const size_t EXTREMA_BLOCK = 256;  // Samples per segment tree leaf
+
+    // floatColumns[c] selects float32 storage for channel c. Drops all samples.
+    void configure(const std::vector<bool>& floatColumns, double samplePeriod, const Retention& retention) {
+        columns.clear();
+        floatCount = 0;
+        doubleCount = 1;  // Timestamps
+        for (bool isFloat : floatColumns)
+            columns.push_back({isFloat, isFloat ? floatCount++ : doubleCount++});
+
+        size_t chunkBytes = CHUNK_SAMPLES * (doubleCount * sizeof(double) + floatCount * sizeof(float));
+        size_t byTime = SIZE_MAX;
+        if (retention.seconds > 0 && samplePeriod > 0) {
+            double samples = std::ceil(retention.seconds / samplePeriod);
+            // One spare chunk so at least the full span survives a drop.
+            byTime = static_cast<size_t>(std::ceil(samples / CHUNK_SAMPLES)) + 1;
+        }
+        size_t cap = retention.maxBytes;
+        if (cap == 0 && byTime == SIZE_MAX) cap = DEFAULT_MAX_BYTES;
+        size_t byMemory = cap ? std::max<size_t>(2, cap / chunkBytes) : SIZE_MAX;
+
+        chunks.clear();
+        chunks.resize(std::min(byTime, byMemory));
+
+        leaves = 1;
+        while (leaves < capacity() / EXTREMA_BLOCK) leaves <<= 1;
+        tree.assign(columns.size(), std::vector<MinMax>());
+        clear();
+    }
+
+    // Drops all samples; allocated chunks are kept for reuse.
+    void clear() {
+        firstChunk = 0;
+        count = 0;
+        dropped = 0;
+        for (std::vector<MinMax>& nodes : tree)
+            nodes.assign(2 * leaves, MinMax());
+    }
+
+    size_t channelCount() const { return columns.size(); }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    size_t capacity() const { return chunks.size() * CHUNK_SAMPLES; }
+    uint64_t firstIndex() const { return dropped; }
+
+    size_t memoryBytes() const {
+        size_t bytes = 0;
+        for (const Chunk& chunk : chunks)
+            bytes += chunk.f64.capacity() * sizeof(double) + chunk.f32.capacity() * sizeof(float);
+        for (const std::vector<MinMax>& nodes : tree)
+            bytes += nodes.capacity() * sizeof(MinMax);
+        return bytes;
+    }
+
+    // row holds one value per channel.
+    void append(double time, const double* row) {
+        if (chunks.empty()) return;
+        if (count == capacity()) {
+            firstChunk = (firstChunk + 1) % chunks.size();
+            count -= CHUNK_SAMPLES;
+            dropped += CHUNK_SAMPLES;
+        }
+        Chunk& chunk = chunks[(firstChunk + count / CHUNK_SAMPLES) % chunks.size()];
+        if (chunk.f64.empty()) {
+            chunk.f64.resize(doubleCount * CHUNK_SAMPLES);
+            chunk.f32.resize(floatCount * CHUNK_SAMPLES);
+        }
+        size_t slot = count % CHUNK_SAMPLES;
+        size_t block = ringBlock(count);
+        bool blockStart = count % EXTREMA_BLOCK == 0;
+        chunk.f64[slot] = time;
+        for (size_t c = 0; c < columns.size(); ++c) {
+            size_t at = columns[c].index * CHUNK_SAMPLES + slot;
+            double stored;
+            if (columns[c].isFloat) stored = chunk.f32[at] = static_cast<float>(row[c]);
+            else stored = chunk.f64[at] = row[c];
+            updateTree(tree[c], block, stored, blockStart);
+        }
+        ++count;
+    }
+
+    double time(size_t i) const {
+        return chunkOf(i).f64[i % CHUNK_SAMPLES];
+    }
+
+    double value(size_t channel, size_t i) const {
+        const Chunk& chunk = chunkOf(i);
+        size_t at = columns[channel].index * CHUNK_SAMPLES + i % CHUNK_SAMPLES;
+        return columns[channel].isFloat ? chunk.f32[at] : chunk.f64[at];
+    }
+
+    // First sample at or after t, and first sample after t (size() if none).
+    // Timestamps are ascending.
+    size_t lowerBound(double t) const {
+        return partitionPoint([t](double time) { return time < t; });
+    }
+    size_t upperBound(double t) const {
+        return partitionPoint([t](double time) { return time <= t; });
+    }
+
+    // Smallest and largest value of one channel over samples [begin, end);
+    // false if the range is empty.
+    bool extrema(size_t channel, size_t begin, size_t end, double& lo, double& hi) const {
+        end = std::min(end, count);
+        if (begin >= end) return false;
+        lo = std::numeric_limits<double>::infinity();
+        hi = -lo;
+        auto widen = [&lo, &hi](double, double v) {
+            lo = std::min(lo, v);
+            hi = std::max(hi, v);
+        };
+        size_t firstFull = (begin + EXTREMA_BLOCK - 1) / EXTREMA_BLOCK;
+        size_t lastFull = end / EXTREMA_BLOCK;
+        if (firstFull >= lastFull) {
+            forEach(channel, begin, end, widen);
+            return true;
+        }
+        forEach(channel, begin, firstFull * EXTREMA_BLOCK, widen);
+        forEach(channel, lastFull * EXTREMA_BLOCK, end, widen);
+
+        // Full blocks, split where the ring wraps.
+        size_t ringBlocks = capacity() / EXTREMA_BLOCK;
+        size_t from = ringBlock(firstFull * EXTREMA_BLOCK);
+        size_t blocks = lastFull - firstFull;
+        size_t run = std::min(blocks, ringBlocks - from);
+        queryTree(tree[channel], from, from + run, lo, hi);
+        if (run < blocks) queryTree(tree[channel], 0, blocks - run, lo, hi);
+        return true;
+    }
+
+    // Calls f(time, value) for samples [begin, end) of one channel, a chunk's
+    // contiguous run at a time.
+    template <typename F>
+    void forEach(size_t channel, size_t begin, size_t end, F f) const {
+        end = std::min(end, count);
+        const Column& column = columns[channel];
+        while (begin < end) {
+            const Chunk& chunk = chunkOf(begin);
+            size_t slot = begin % CHUNK_SAMPLES;
+            size_t run = std::min(end - begin, CHUNK_SAMPLES - slot);
+            const double* t = chunk.f64.data() + slot;
+            if (column.isFloat) {
+                const float* v = chunk.f32.data() + column.index * CHUNK_SAMPLES + slot;
+                for (size_t k = 0; k < run; ++k) f(t[k], static_cast<double>(v[k]));
+            }
+            else {
+                const double* v = chunk.f64.data() + column.index * CHUNK_SAMPLES + slot;
+                for (size_t k = 0; k < run; ++k) f(t[k], v[k]);
+            }
+            begin += run;
+        }
+    }
+
+private:
+    struct Column {
+        bool isFloat;
+        size_t index;  // Column within f32 or f64 of a chunk
+    };
+
+    // Column-major: f64 holds the timestamps and then the double channels,
+    // f32 the float channels, CHUNK_SAMPLES values per column.
+    struct Chunk {
+        std::vector<double> f64;
+        std::vector<float> f32;
+    };
+
+    struct MinMax {
+        double lo = std::numeric_limits<double>::infinity();
+        double hi = -std::numeric_limits<double>::infinity();
+    };
+
+    // Tree leaf of sample i; blocks never straddle chunks.
+    size_t ringBlock(size_t i) const {
+        return ((firstChunk * CHUNK_SAMPLES + i) % capacity()) / EXTREMA_BLOCK;
+    }
+
+    // The first sample of a block replaces what a recycled chunk left there.
+    // Propagation stops as soon as a parent does not change.
+    void updateTree(std::vector<MinMax>& nodes, size_t block, double v, bool blockStart) {
+        size_t node = leaves + block;
+        if (blockStart) nodes[node].lo = nodes[node].hi = v;
+        else if (v < nodes[node].lo) nodes[node].lo = v;
+        else if (v > nodes[node].hi) nodes[node].hi = v;
+        else return;
+        for (node >>= 1; node > 0; node >>= 1) {
+            const MinMax& a = nodes[2 * node];
+            const MinMax& b = nodes[2 * node + 1];
+            MinMax merged;
+            merged.lo = std::min(a.lo, b.lo);
+            merged.hi = std::max(a.hi, b.hi);
+            if (merged.lo == nodes[node].lo && merged.hi == nodes[node].hi) break;
+            nodes[node] = merged;
+        }
+    }
+
+    // Widens lo/hi by the leaves [first, last).
+    void queryTree(const std::vector<MinMax>& nodes, size_t first, size_t last, double& lo, double& hi) const {
+        for (size_t l = first + leaves, r = last + leaves; l < r; l >>= 1, r >>= 1) {
+            if (l & 1) {
+                lo = std::min(lo, nodes[l].lo);
+                hi = std::max(hi, nodes[l++].hi);
+            }
+            if (r & 1) {
+                lo = std::min(lo, nodes[--r].lo);
+                hi = std::max(hi, nodes[r].hi);
+            }
+        }
+    }
+
+    template <typename Pred>
+    size_t partitionPoint(Pred before) const {
+        size_t lo = 0, hi = count;
+        while (lo < hi) {
+            size_t mid = lo + (hi - lo) / 2;
+            if (before(time(mid))) lo = mid + 1;
+            else hi = mid;
+        }
+        return lo;
+    }
+
+    const Chunk& chunkOf(size_t i) const {
+        return chunks[(firstChunk + i / CHUNK_SAMPLES) % chunks.size()];
+    }
+
+    std::vector<Column> columns;
+    size_t floatCount = 0;
+    size_t doubleCount = 1;
+    std::vector<Chunk> chunks;  // Ring of chunks, allocated on first use
+    size_t firstChunk = 0;      // Oldest chunk
+    size_t count = 0;           // Retained samples
+    uint64_t dropped = 0;       // Samples recycled so far
+    size_t leaves = 1;          // Segment tree leaves, a power of two
+    std::vector<std::vector<MinMax>> tree;  // Per channel, node 1 is the root
+};
+
+#endif // CHANNEL_STORE_H
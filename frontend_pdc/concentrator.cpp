@@ -0,0 +1,142 @@
+#include "concentrator.h"
+
+#include <QDebug>
+
+#include <algorithm>
+#include <cmath>
+
+Concentrator::Concentrator(const QStringList &sources, int waitMs, QObject *parent)
+    : QObject(parent), sources(sources), waitMs(waitMs)
+{
+}
+
+Concentrator::~Concentrator()
+{
+    for(QThread *thread : threads) {
+        thread->quit();
+        thread->wait();
+    }
+}
+
+void Concentrator::start()
+{
+    settleTimer = new QTimer(this);
+    settleTimer->setSingleShot(true);
+    settleTimer->setInterval(SETTLE_MS);
+    connect(settleTimer, &QTimer::timeout, this, &Concentrator::combine);
+
+    emitTimer = new QTimer(this);
+    emitTimer->setTimerType(Qt::PreciseTimer);
+    connect(emitTimer, &QTimer::timeout, this, &Concentrator::onEmitTick);
+
+    statusTimer = new QTimer(this);
+    connect(statusTimer, &QTimer::timeout, this, &Concentrator::reportStatus);
+
+    for(int i = 0; i < sources.size(); ++i) {
+        QString host;
+        quint16 port = 0;
+        if(!IngestWorker::parseEndpoint(sources[i], host, port)) {
+            qWarning() << "Ignoring invalid PMU address" << sources[i];
+            continue;
+        }
+        QThread *thread = new QThread(this);
+        IngestWorker *worker = new IngestWorker(host, port);
+        worker->concentrateAs(i);
+        worker->setLatency(latency);
+        worker->setCounters(counters);
+        worker->moveToThread(thread);
+        connect(thread, &QThread::started, worker, &IngestWorker::start);
+        connect(thread, &QThread::finished, worker, &QObject::deleteLater);
+        connect(worker, &IngestWorker::streamConfigured, this, &Concentrator::onStreamConfigured);
+        connect(this, &Concentrator::alignerChanged, worker, &IngestWorker::setAligner);
+        threads.append(thread);
+        thread->start();
+    }
+}
+
+void Concentrator::onStreamConfigured(int source, const ConfigFrame &cfg)
+{
+    auto it = std::find_if(streams.begin(), streams.end(), [&](const SourceStream &s) {
+        return s.source == source && s.cfg.idCode == cfg.idCode;
+    });
+    if(it != streams.end()) it->cfg = cfg;
+    else streams.append({source, cfg});
+    settleTimer->start();
+}
+
+// Builds the combined configuration from every stream at the reporting rate
+// of the first one and starts aligning them.
+void Concentrator::combine()
+{
+    if(streams.isEmpty()) return;
+    std::sort(streams.begin(), streams.end(), [](const SourceStream &a, const SourceStream &b) {
+        return a.source != b.source ? a.source < b.source : a.cfg.idCode < b.cfg.idCode;
+    });
+
+    ConfigFrame combined;
+    combined.idCode = ID_CODE;
+    combined.dataRate = streams.first().cfg.dataRate;
+    AlignedStreams aligned;
+    std::vector<size_t> widths;
+    columnNames.clear();
+    for(const SourceStream &s : streams) {
+        if(s.cfg.dataRate != combined.dataRate || s.cfg.dataRate <= 0) {
+            qWarning() << "Not concentrating PMU" << s.cfg.idCode << "of" << sources.value(s.source)
+                       << "reporting at" << s.cfg.dataRate << "instead of" << combined.dataRate;
+            continue;
+        }
+        widths.push_back(decoded_channels(s.cfg).size());
+        aligned.streams.emplace_back(s.source, s.cfg.idCode);
+        columnNames << QString::fromStdString(s.cfg.pmus.front().stationName);
+        combined.pmus.insert(combined.pmus.end(), s.cfg.pmus.begin(), s.cfg.pmus.end());
+    }
+    if(widths.empty()) return;
+
+    aligner = std::make_shared<TimeAligner>(widths, static_cast<uint32_t>(combined.dataRate),
+                                            static_cast<int64_t>(waitMs) * 1000000);
+    aligned.aligner = aligner;
+    double rows = std::ceil(IngestWorker::QUEUE_SECONDS * combined.dataRate);
+    ring = std::make_shared<SampleRing>(aligner->rowWidth(), qMax(IngestWorker::MIN_QUEUE_ROWS, static_cast<size_t>(rows)));
+    qInfo() << "Concentrating" << widths.size() << "PMU streams at" << combined.dataRate << "fps, wait" << waitMs << "ms";
+
+    emit configReceived(combined, ring);
+    emit alignerChanged(aligned);
+    emitTimer->start(EMIT_INTERVAL_MS);
+    statusTimer->start(1000);
+}
+
+void Concentrator::onEmitTick()
+{
+    if(!aligner) return;
+    SampleRing *out = ring.get();
+    aligner->drain(aligner_clock_ns(), [out](double time, const double *row, size_t) {
+        out->push(time, row);
+    });
+}
+
+// One line for the status bar: frames emitted complete and partial, late and
+// missing reports and the PMU missing most often since the start, and the
+// added latency since the last report.
+void Concentrator::reportStatus()
+{
+    if(!aligner) return;
+    quint64 late = 0, missing = 0, worstMissing = 0;
+    int worst = -1;
+    for(size_t p = 0; p < aligner->pmuCount(); ++p) {
+        const TimeAligner::PmuStats &st = aligner->pmuStats(p);
+        quint64 m = st.missing.load(std::memory_order_relaxed);
+        late += st.late.load(std::memory_order_relaxed);
+        missing += m;
+        if(m > worstMissing) {
+            worstMissing = m;
+            worst = static_cast<int>(p);
+        }
+    }
+    QString status = QString("Concentrator: %1 PMUs, complete %2, partial %3, late %4, missing %5, latency %6/%7 ms")
+        .arg(aligner->pmuCount()).arg(aligner->completeFrames()).arg(aligner->partialFrames())
+        .arg(late).arg(missing)
+        .arg(aligner->meanLatencyNs() / 1e6, 0, 'f', 1).arg(aligner->maxLatencyNs() / 1e6, 0, 'f', 1);
+    if(worst >= 0) status += QString(" (most missing: %1, %2)").arg(columnNames.value(worst)).arg(worstMissing);
+    aligner->resetLatency();
+    emit statusChanged(status);
+}
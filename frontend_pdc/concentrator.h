@@ -0,0 +1,84 @@
+#ifndef CONCENTRATOR_H
+#define CONCENTRATOR_H
+
+// Phasor data concentrator: time-aligns the PMU streams of several sources
+// into one combined stream.
+//
+// Every source (a PMU, or a PDC or simulator carrying many PMUs) is read by
+// its own IngestWorker thread in concentrated mode. The CFG-2 frames they
+// announce are collected; once no new one has arrived for SETTLE_MS, the
+// streams at the common reporting rate are combined into one configuration
+// with a PMU block per stream, a TimeAligner sized for them is handed to the
+// workers and the configuration goes out through configReceived(), exactly as
+// a single IngestWorker would announce a multi-PMU stream. An emit timer then
+// moves every aligned row into the SampleRing for the GUI, and the late and
+// missing counters are summarized in statusChanged() once a second.
+//
+// Like IngestWorker: create it without a parent, moveToThread() it and
+// invoke start() through the event loop.
+
+#include <QObject>
+#include <QStringList>
+#include <QThread>
+#include <QTimer>
+#include <QVector>
+
+#include <memory>
+
+#include "c37118_decoder.h"
+#include "ingest_worker.h"
+#include "sample_ring.h"
+#include "time_aligner.h"
+
+class Concentrator : public QObject
+{
+    Q_OBJECT
+public:
+    static const int DEFAULT_WAIT_MS = 40;
+    static const int SETTLE_MS = 500;       // Quiet time before a configuration is combined
+    static const int EMIT_INTERVAL_MS = 2;  // Added to the wait in the worst case
+    static const uint16_t ID_CODE = 0xFFFE; // IDCODE of the combined stream
+
+    // sources as "host:port"; waitMs bounds how long a frame waits for late PMUs.
+    Concentrator(const QStringList &sources, int waitMs, QObject *parent = nullptr);
+    ~Concentrator() override;
+    // Passed to every worker, which records the parse stage; call before start().
+    void setLatency(const std::shared_ptr<PipelineLatency> &stats) { latency = stats; }
+    // Shared by every worker; call before start().
+    void setCounters(const std::shared_ptr<IngestCounters> &stats) { counters = stats; }
+
+public slots:
+    void start();
+
+signals:
+    void configReceived(const ConfigFrame &cfg, const std::shared_ptr<SampleRing> &ring);
+    void alignerChanged(const AlignedStreams &aligned);
+    void statusChanged(const QString &status);
+
+private slots:
+    void onStreamConfigured(int source, const ConfigFrame &cfg);
+    void combine();
+    void onEmitTick();
+    void reportStatus();
+
+private:
+    struct SourceStream {
+        int source;
+        ConfigFrame cfg;
+    };
+
+    QStringList sources;
+    int waitMs;
+    QVector<QThread*> threads;
+    QVector<SourceStream> streams;      // Every stream announced, by source and IDCODE
+    QStringList columnNames;            // Station of each aligned stream
+    QTimer *settleTimer = nullptr;
+    QTimer *emitTimer = nullptr;
+    QTimer *statusTimer = nullptr;
+    std::shared_ptr<TimeAligner> aligner;
+    std::shared_ptr<SampleRing> ring;
+    std::shared_ptr<PipelineLatency> latency;
+    std::shared_ptr<IngestCounters> counters;
+};
+
+#endif // CONCENTRATOR_H
@@ -0,0 +1,193 @@
+#ifndef CRC_CCITT_H
+#define CRC_CCITT_H
+
+// CRC-CCITT (poly 0x1021, init 0xFFFF, no reflection, no final XOR) as used
+// by IEEE C37.118.2 for the CHK field of every frame.
+//
+// Three implementations are provided, all bit-identical to the original
+// bit-at-a-time loop:
+//   - crc_ccitt_table:  one 256-entry table lookup per byte
+//   - crc_ccitt_slice8: slicing-by-8, eight table lookups per 8 bytes
+//   - crc_ccitt_clmul:  carry-less multiply folding (PCLMULQDQ), x86 only
+// calculate_crc() picks the fastest one available on the running CPU.
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define CRC_CCITT_HAVE_CLMUL 1
+#include <cpuid.h>
+#include <immintrin.h>
+#else
+#define CRC_CCITT_HAVE_CLMUL 0
+#endif
+
+const uint16_t CRC_CCITT_POLY = 0x1021;
+const uint16_t CRC_CCITT_INIT = 0xFFFF;
+
+// --- Reference implementation ---
+inline uint16_t crc_ccitt_bitwise(const unsigned char* data, size_t len, uint16_t crc = CRC_CCITT_INIT) {
+    for (size_t i = 0; i < len; i++) {
+        crc = crc ^ (data[i] << 8);
+        for (int j = 0; j < 8; j++) {
+            if (crc & 0x8000)
+                crc = (crc << 1) ^ CRC_CCITT_POLY;
+            else
+                crc = crc << 1;
+        }
+    }
+    return crc;
+}
+
+// --- Lookup tables ---
+// tables[0] is the classic byte table. tables[k][b] is the CRC contribution of
+// byte b followed by k zero bytes, which is what slicing-by-8 needs.
+using CrcCcittTables = std::array<std::array<uint16_t, 256>, 8>;
+
+constexpr CrcCcittTables make_crc_ccitt_tables() {
+    CrcCcittTables tables{};
+    for (int b = 0; b < 256; ++b) {
+        uint16_t crc = static_cast<uint16_t>(b << 8);
+        for (int j = 0; j < 8; ++j)
+            crc = (crc & 0x8000) ? static_cast<uint16_t>((crc << 1) ^ CRC_CCITT_POLY)
+                                 : static_cast<uint16_t>(crc << 1);
+        tables[0][b] = crc;
+    }
+    for (int k = 1; k < 8; ++k) {
+        for (int b = 0; b < 256; ++b) {
+            uint16_t prev = tables[k - 1][b];
+            tables[k][b] = static_cast<uint16_t>((prev << 8) ^ tables[0][prev >> 8]);
+        }
+    }
+    return tables;
+}
+
+inline constexpr CrcCcittTables CRC_CCITT_TABLES = make_crc_ccitt_tables();
+
+// --- Table-driven ---
+inline uint16_t crc_ccitt_table(const unsigned char* data, size_t len, uint16_t crc = CRC_CCITT_INIT) {
+    const auto& t = CRC_CCITT_TABLES[0];
+    for (size_t i = 0; i < len; i++)
+        crc = static_cast<uint16_t>((crc << 8) ^ t[(crc >> 8) ^ data[i]]);
+    return crc;
+}
+
+// --- Slicing-by-8 ---
+inline uint16_t crc_ccitt_slice8(const unsigned char* data, size_t len, uint16_t crc = CRC_CCITT_INIT) {
+    const auto& t = CRC_CCITT_TABLES;
+    while (len >= 8) {
+        // The 16-bit CRC only overlaps the first two bytes of the block.
+        uint8_t b0 = static_cast<uint8_t>(data[0] ^ (crc >> 8));
+        uint8_t b1 = static_cast<uint8_t>(data[1] ^ (crc & 0xFF));
+        crc = static_cast<uint16_t>(t[7][b0] ^ t[6][b1] ^ t[5][data[2]] ^ t[4][data[3]] ^
+                                    t[3][data[4]] ^ t[2][data[5]] ^ t[1][data[6]] ^ t[0][data[7]]);
+        data += 8;
+        len -= 8;
+    }
+    return crc_ccitt_table(data, len, crc);
+}
+
+// --- Carry-less multiply folding ---
+// x^n mod P, used to derive the folding constants at compile time.
+constexpr uint64_t crc_ccitt_xpow_mod(unsigned n) {
+    uint32_t r = 1;
+    for (unsigned i = 0; i < n; ++i) {
+        r <<= 1;
+        if (r & 0x10000)
+            r ^= 0x10000 | CRC_CCITT_POLY;
+    }
+    return r;
+}
+
+#if CRC_CCITT_HAVE_CLMUL
+
+// Minimum length for which the folding path beats slicing-by-8.
+const size_t CRC_CCITT_CLMUL_MIN_LEN = 128;
+
+#define CRC_CCITT_CLMUL_TARGET __attribute__((target("pclmul,ssse3")))
+
+CRC_CCITT_CLMUL_TARGET
+inline __m128i crc_ccitt_load_be128(const unsigned char* p) {
+    const __m128i bswap = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    return _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)), bswap);
+}
+
+// acc * x^d + next (mod P), with k = {x^d mod P, x^(d+64) mod P} as {low, high}.
+CRC_CCITT_CLMUL_TARGET
+inline __m128i crc_ccitt_fold128(__m128i acc, __m128i k, __m128i next) {
+    __m128i lo = _mm_clmulepi64_si128(acc, k, 0x00);
+    __m128i hi = _mm_clmulepi64_si128(acc, k, 0x11);
+    return _mm_xor_si128(_mm_xor_si128(lo, hi), next);
+}
+
+// Folds 64 bytes per iteration over four independent 128-bit lanes, then
+// collapses the lanes and finishes the last (< 64 + 16) bytes with the table.
+// Each lane value is only congruent to its part of the message mod P, which
+// is all the final byte-wise pass needs since the CRC is linear in its input.
+CRC_CCITT_CLMUL_TARGET
+inline uint16_t crc_ccitt_clmul_impl(const unsigned char* data, size_t len) {
+    const __m128i bswap = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    const __m128i k512 = _mm_set_epi64x(static_cast<long long>(crc_ccitt_xpow_mod(512 + 64)),
+                                        static_cast<long long>(crc_ccitt_xpow_mod(512)));
+    const __m128i k128 = _mm_set_epi64x(static_cast<long long>(crc_ccitt_xpow_mod(128 + 64)),
+                                        static_cast<long long>(crc_ccitt_xpow_mod(128)));
+
+    __m128i x0 = crc_ccitt_load_be128(data);
+    __m128i x1 = crc_ccitt_load_be128(data + 16);
+    __m128i x2 = crc_ccitt_load_be128(data + 32);
+    __m128i x3 = crc_ccitt_load_be128(data + 48);
+    // Initial value 0xFFFF is equivalent to inverting the first two bytes.
+    x0 = _mm_xor_si128(x0, _mm_set_epi64x(static_cast<long long>(0xFFFF000000000000ULL), 0));
+    data += 64;
+    len -= 64;
+
+    while (len >= 64) {
+        x0 = crc_ccitt_fold128(x0, k512, crc_ccitt_load_be128(data));
+        x1 = crc_ccitt_fold128(x1, k512, crc_ccitt_load_be128(data + 16));
+        x2 = crc_ccitt_fold128(x2, k512, crc_ccitt_load_be128(data + 32));
+        x3 = crc_ccitt_fold128(x3, k512, crc_ccitt_load_be128(data + 48));
+        data += 64;
+        len -= 64;
+    }
+
+    x1 = crc_ccitt_fold128(x0, k128, x1);
+    x2 = crc_ccitt_fold128(x1, k128, x2);
+    x3 = crc_ccitt_fold128(x2, k128, x3);
+    while (len >= 16) {
+        x3 = crc_ccitt_fold128(x3, k128, crc_ccitt_load_be128(data));
+        data += 16;
+        len -= 16;
+    }
+
+    alignas(16) unsigned char folded[16];
+    _mm_store_si128(reinterpret_cast<__m128i*>(folded), _mm_shuffle_epi8(x3, bswap));
+    uint16_t crc = crc_ccitt_slice8(folded, sizeof(folded), 0);
+    return crc_ccitt_table(data, len, crc);
+}
+
+inline bool crc_ccitt_cpu_has_clmul() {
+    unsigned eax = 0, ebx = 0, ecx = 0, edx = 0;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+        return false;
+    return (ecx & bit_PCLMUL) && (ecx & bit_SSSE3);
+}
+
+#endif // CRC_CCITT_HAVE_CLMUL
+
+// Falls back to slicing-by-8 for short inputs or CPUs without PCLMULQDQ.
+inline uint16_t crc_ccitt_clmul(const unsigned char* data, size_t len) {
+#if CRC_CCITT_HAVE_CLMUL
+    static const bool hasClmul = crc_ccitt_cpu_has_clmul();
+    if (hasClmul && len >= CRC_CCITT_CLMUL_MIN_LEN)
+        return crc_ccitt_clmul_impl(data, len);
+#endif
+    return crc_ccitt_slice8(data, len);
+}
+
+// --- Dispatch ---
+inline uint16_t calculate_crc(const unsigned char* data, size_t len) {
+    return crc_ccitt_clmul(data, len);
+}
+
+#endif // CRC_CCITT_H
@@ -0,0 +1,83 @@
+#ifndef DATA_FRAME_ENCODER_H
+#define DATA_FRAME_ENCODER_H
+
+// Zero-allocation C37.118.2 data frame encoder.
+//
+// encode_data_frame() writes a complete frame, CRC included, into a
+// caller-provided buffer for any runtime DataFrameLayout. Each virtual PMU
+// has its own channel counts and formats, so its layout is computed once when
+// it is configured and reused for every frame.
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+#include "c37118_layout.h"
+#include "crc_ccitt.h"
+
+// phasors holds 2 * phnmr values, {mag, angle rad} or {real, imag} pairs.
+// nominalFreq is only used by the integer format, where FREQ is sent as the
+// deviation from nominal in mHz.
+inline size_t encode_data_frame(unsigned char* out, const DataFrameLayout& layout,
+                                uint16_t pmuId, uint32_t soc, uint32_t fracsec, uint16_t stat,
+                                const float* phasors, float freq, float rocof,
+                                const float* analogs, const uint16_t* digitals,
+                                float nominalFreq = 50.0f)
+{
+    out[0] = SYNC_DATA;
+    out[1] = TYPE_DATA;
+    store_be16(out + 2, static_cast<uint16_t>(layout.frameSize));
+    store_be16(out + layout.idcodeOffset, pmuId);
+    store_be32(out + layout.socOffset, soc);
+    store_be32(out + layout.fracsecOffset, fracsec);
+    store_be16(out + layout.statOffset, stat);
+
+    unsigned char* p = out + layout.phasorOffset;
+    for (size_t i = 0; i < layout.phnmr; ++i) {
+        float a = phasors[2 * i];
+        float b = phasors[2 * i + 1];
+        if (layout.phasorFloat) {
+            store_be_float(p, a);
+            store_be_float(p + 4, b);
+            p += 8;
+        } else if (layout.polarFmt) {
+            store_be16(p, static_cast<uint16_t>(std::lround(a)));
+            store_be16(p + 2, static_cast<uint16_t>(std::lround(b * 10000.0f)));
+            p += 4;
+        } else {
+            store_be16(p, static_cast<uint16_t>(std::lround(a)));
+            store_be16(p + 2, static_cast<uint16_t>(std::lround(b)));
+            p += 4;
+        }
+    }
+
+    if (layout.freqFloat) {
+        store_be_float(out + layout.freqOffset, freq);
+        store_be_float(out + layout.dfreqOffset, rocof);
+    } else {
+        store_be16(out + layout.freqOffset, static_cast<uint16_t>(std::lround((freq - nominalFreq) * 1000.0f)));
+        store_be16(out + layout.dfreqOffset, static_cast<uint16_t>(std::lround(rocof * 100.0f)));
+    }
+
+    p = out + layout.analogOffset;
+    for (size_t i = 0; i < layout.annmr; ++i) {
+        if (layout.analogFloat) {
+            store_be_float(p, analogs[i]);
+            p += 4;
+        } else {
+            store_be16(p, static_cast<uint16_t>(std::lround(analogs[i])));
+            p += 2;
+        }
+    }
+
+    p = out + layout.digitalOffset;
+    for (size_t i = 0; i < layout.dgnmr; ++i) {
+        store_be16(p, digitals[i]);
+        p += 2;
+    }
+
+    store_be16(out + layout.chkOffset, calculate_crc(out, layout.chkOffset));
+    return layout.frameSize;
+}
+
+#endif // DATA_FRAME_ENCODER_H
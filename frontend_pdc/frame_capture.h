@@ -0,0 +1,283 @@
+#ifndef FRAME_CAPTURE_H
+#define FRAME_CAPTURE_H
+
+// Capture files of C37.118.2 frames for the PMU simulator.
+//
+// A capture is the 8-byte magic "PMUCAP01" followed by records of
+//   TIME(8, big-endian ns since the Unix epoch) FRAME(FRAMESIZE bytes)
+// where FRAME is one complete frame, CHK included, exactly as it went on the
+// wire. TIME is when the frame was sent (or, for converted streams, its
+// SOC/FRACSEC); frames sent in the same tick share one TIME. Configuration
+// frames precede the data frames of their PMU.
+//
+// CaptureWriter appends records through a large stdio buffer. CaptureFile
+// maps a capture read-only and hands out records as views into the mapping,
+// so a replay can pass frames to the socket layer without copying them.
+// convert_raw_stream() turns a raw byte dump of a C37.118.2 stream (e.g. the
+// TCP payload of a real PMU) into a capture.
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "c37118_framer.h"
+#include "c37118_layout.h"
+#include "crc_ccitt.h"
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+const char CAPTURE_MAGIC[8] = {'P', 'M', 'U', 'C', 'A', 'P', '0', '1'};
+const size_t CAPTURE_HEADER_SIZE = sizeof(CAPTURE_MAGIC);
+const size_t CAPTURE_RECORD_HEADER = 8;
+
+inline void store_be64(unsigned char* p, uint64_t v) {
+    store_be32(p, static_cast<uint32_t>(v >> 32));
+    store_be32(p + 4, static_cast<uint32_t>(v));
+}
+
+inline uint64_t load_be64(const unsigned char* p) {
+    return (static_cast<uint64_t>(load_be32(p)) << 32) | load_be32(p + 4);
+}
+
+inline bool is_config_frame(const unsigned char* frame) {
+    return frame[0] == SYNC_CFG2 && (frame[1] == TYPE_CFG2 || frame[1] == TYPE_CFG1);
+}
+
+inline bool is_data_frame(const unsigned char* frame) {
+    return frame[0] == SYNC_DATA && frame[1] == TYPE_DATA;
+}
+
+// Adds seconds to SOC and recomputes CHK; FRACSEC, quality bits included, is
+// left as it was.
+inline void shift_frame_soc(unsigned char* frame, size_t len, int64_t seconds) {
+    store_be32(frame + 6, static_cast<uint32_t>(load_be32(frame + 6) + seconds));
+    store_be16(frame + len - 2, calculate_crc(frame, len - 2));
+}
+
+struct CaptureRecord {
+    int64_t timeNs = 0;
+    const unsigned char* frame = nullptr;
+    size_t len = 0;
+};
+
+class CaptureWriter
+{
+public:
+    CaptureWriter() = default;
+    ~CaptureWriter() { close(); }
+
+    CaptureWriter(const CaptureWriter&) = delete;
+    CaptureWriter& operator=(const CaptureWriter&) = delete;
+
+    bool open(const std::string& path) {
+        close();
+        file = std::fopen(path.c_str(), "wb");
+        if (!file) return false;
+        buffer.resize(BUFFER_SIZE);
+        std::setvbuf(file, buffer.data(), _IOFBF, buffer.size());
+        if (std::fwrite(CAPTURE_MAGIC, 1, CAPTURE_HEADER_SIZE, file) != CAPTURE_HEADER_SIZE) {
+            close();
+            return false;
+        }
+        records = 0;
+        bytes = CAPTURE_HEADER_SIZE;
+        return true;
+    }
+
+    void close() {
+        if (!file) return;
+        std::fclose(file);
+        file = nullptr;
+    }
+
+    bool isOpen() const { return file != nullptr; }
+
+    bool write(int64_t timeNs, const unsigned char* frame, size_t len) {
+        unsigned char head[CAPTURE_RECORD_HEADER];
+        store_be64(head, static_cast<uint64_t>(timeNs));
+        if (std::fwrite(head, 1, sizeof(head), file) != sizeof(head) ||
+            std::fwrite(frame, 1, len, file) != len)
+            return false;
+        ++records;
+        bytes += sizeof(head) + len;
+        return true;
+    }
+
+    // Hands buffered records to the OS so a killed process loses little.
+    void flush() {
+        if (file) std::fflush(file);
+    }
+
+    uint64_t recordCount() const { return records; }
+    uint64_t byteCount() const { return bytes; }
+
+private:
+    static const size_t BUFFER_SIZE = 1 << 20;
+
+    std::FILE* file = nullptr;
+    std::vector<char> buffer;
+    uint64_t records = 0;
+    uint64_t bytes = 0;
+};
+
+class CaptureFile
+{
+public:
+    CaptureFile() = default;
+    ~CaptureFile() { close(); }
+
+    CaptureFile(const CaptureFile&) = delete;
+    CaptureFile& operator=(const CaptureFile&) = delete;
+
+    bool open(const std::string& path) {
+        close();
+#ifdef _WIN32
+        fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                 FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (fileHandle == INVALID_HANDLE_VALUE) return false;
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart < LONGLONG(CAPTURE_HEADER_SIZE)) {
+            close();
+            return false;
+        }
+        mapping = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+        size = static_cast<size_t>(fileSize.QuadPart);
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size < off_t(CAPTURE_HEADER_SIZE)) {
+            ::close(fd);
+            return false;
+        }
+        size = static_cast<size_t>(st.st_size);
+        void* view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (view == MAP_FAILED) view = nullptr;
+        else madvise(view, size, MADV_SEQUENTIAL);
+#endif
+        base = static_cast<const unsigned char*>(view);
+        if (!base || !std::equal(CAPTURE_MAGIC, CAPTURE_MAGIC + CAPTURE_HEADER_SIZE, base)) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close() {
+#ifdef _WIN32
+        if (base) UnmapViewOfFile(base);
+        if (mapping) CloseHandle(mapping);
+        if (fileHandle != INVALID_HANDLE_VALUE) CloseHandle(fileHandle);
+        mapping = nullptr;
+        fileHandle = INVALID_HANDLE_VALUE;
+#else
+        if (base) munmap(const_cast<unsigned char*>(base), size);
+#endif
+        base = nullptr;
+        size = 0;
+    }
+
+    bool isOpen() const { return base != nullptr; }
+    const unsigned char* data() const { return base; }
+    size_t byteSize() const { return size; }
+
+    // Offset of the first record, the cursor to start next() with.
+    size_t begin() const { return CAPTURE_HEADER_SIZE; }
+
+    // Reads the record at offset and advances it. Stops at the end of the
+    // file and at a record cut short by an interrupted capture.
+    bool next(size_t& offset, CaptureRecord& record) const {
+        if (offset + CAPTURE_RECORD_HEADER + 4 > size) return false;
+        const unsigned char* p = base + offset;
+        size_t len = load_be16(p + CAPTURE_RECORD_HEADER + 2);
+        if (len < StreamFramer::MIN_FRAME_SIZE || offset + CAPTURE_RECORD_HEADER + len > size) return false;
+        record.timeNs = static_cast<int64_t>(load_be64(p));
+        record.frame = p + CAPTURE_RECORD_HEADER;
+        record.len = len;
+        offset += CAPTURE_RECORD_HEADER + len;
+        return true;
+    }
+
+private:
+    const unsigned char* base = nullptr;
+    size_t size = 0;
+#ifdef _WIN32
+    HANDLE fileHandle = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#endif
+};
+
+// Converts a raw C37.118.2 byte stream into a capture stamped with each
+// frame's own SOC/FRACSEC. TIME_BASE comes from the configuration frames in
+// the stream; data frames of an IDCODE seen before its configuration are
+// dropped. Returns the number of records written, or -1 on an I/O error.
+inline int64_t convert_raw_stream(const std::string& inPath, const std::string& outPath) {
+    std::FILE* in = std::fopen(inPath.c_str(), "rb");
+    if (!in) return -1;
+    CaptureWriter out;
+    if (!out.open(outPath)) {
+        std::fclose(in);
+        return -1;
+    }
+
+    struct TimeBase {
+        uint16_t idCode;
+        uint32_t ticks;
+    };
+    std::vector<TimeBase> timeBases;
+    StreamFramer framer;
+    FrameView frame;
+    bool ok = true;
+    while (ok) {
+        size_t n = std::fread(framer.writePtr(), 1, framer.writable(), in);
+        if (n == 0) break;
+        framer.commit(n);
+        while (framer.next(frame)) {
+            uint16_t idCode = load_be16(frame.data + 4);
+            auto it = std::find_if(timeBases.begin(), timeBases.end(),
+                                   [&](const TimeBase& t) { return t.idCode == idCode; });
+            uint32_t ticks = 0;
+            if (is_config_frame(frame.data) && frame.size >= 20) {
+                ticks = load_be32(frame.data + 14) & 0x00FFFFFF;
+                if (ticks == 0) continue;
+                if (it == timeBases.end()) timeBases.push_back({idCode, ticks});
+                else it->ticks = ticks;
+            }
+            else if (it != timeBases.end()) {
+                ticks = it->ticks;
+            }
+            else {
+                continue;
+            }
+            uint32_t fracsec = load_be32(frame.data + 10) & 0x00FFFFFF;
+            int64_t timeNs = int64_t(load_be32(frame.data + 6)) * 1000000000 +
+                             int64_t(fracsec) * 1000000000 / ticks;
+            if (!out.write(timeNs, frame.data, frame.size)) {
+                ok = false;
+                break;
+            }
+        }
+        if (framer.writable() == 0) framer.reset();  // Frame longer than the ring: resync
+    }
+    ok = ok && !std::ferror(in);
+    std::fclose(in);
+    int64_t records = static_cast<int64_t>(out.recordCount());
+    out.close();
+    return ok ? records : -1;
+}
+
+#endif // FRAME_CAPTURE_H
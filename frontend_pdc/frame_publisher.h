@@ -0,0 +1,372 @@
+#ifndef FRAME_PUBLISHER_H
+#define FRAME_PUBLISHER_H
+
+// Encode-once fan-out of output frames to many TCP subscribers.
+//
+// FramePublisher copies the frames of one tick, as encoded once by the
+// engine into arenas it reuses, back to back into a pooled reference-counted
+// FrameBuffer. Frames that already lie in storage outliving every queue (a
+// replayed capture mapping) are not copied: the tick's FrameBuffer is then a
+// view of that storage. Each subscriber's FrameQueue takes a reference to
+// the tick's buffer together with the byte ranges of the frames it
+// subscribed to, with adjacent frames merged into one range. A subscriber of every PMU thus
+// costs one reference and one slice per tick, however many frames the tick
+// holds and however many other subscribers there are. CFG-2 frames are
+// encoded once per PMU; each request gets a copy in a small pooled buffer,
+// stamped with the present time, queued the same way so it stays in order
+// with the data frames around it.
+//
+// A buffer goes back to the pool when the last queue holding it has sent its
+// bytes, so a subscriber that falls behind keeps its ticks alive without
+// copies and the encoder arenas can be reused on the next tick. A queue that
+// grows too long sheds whole data frames, newest or oldest, never one that
+// has started to go out and never a CFG-2.
+//
+// Reference counts are plain integers: buffers are published, queued, sent
+// and released on the network thread only. The publisher must outlive every
+// FrameRef and FrameQueue taken from it.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "c37118_layout.h"
+#include "crc_ccitt.h"
+#include "pmu_sim_engine.h"
+#include "socket_compat.h"
+
+class FrameBuffer
+{
+public:
+    const unsigned char* data() const { return view ? view : bytes.data(); }
+    size_t size() const { return view ? viewSize : bytes.size(); }
+
+private:
+    friend class FrameRef;
+    friend class FramePublisher;
+
+    void release() {
+        if (--refs > 0) return;
+        freeList->push_back(this);
+    }
+
+    std::vector<unsigned char> bytes;    // Capacity kept while pooled
+    const unsigned char* view = nullptr; // External storage instead of bytes
+    size_t viewSize = 0;
+    uint32_t refs = 0;
+    std::vector<FrameBuffer*>* freeList = nullptr;
+};
+
+// Counted reference to a FrameBuffer.
+class FrameRef
+{
+public:
+    FrameRef() = default;
+    explicit FrameRef(FrameBuffer* buffer) : buffer(buffer) {
+        if (buffer) ++buffer->refs;
+    }
+    FrameRef(const FrameRef& other) : FrameRef(other.buffer) {}
+    FrameRef(FrameRef&& other) noexcept : buffer(other.buffer) { other.buffer = nullptr; }
+    FrameRef& operator=(FrameRef other) noexcept {
+        std::swap(buffer, other.buffer);
+        return *this;
+    }
+    ~FrameRef() { reset(); }
+
+    void reset() {
+        if (buffer) buffer->release();
+        buffer = nullptr;
+    }
+
+    explicit operator bool() const { return buffer != nullptr; }
+    bool operator==(const FrameRef& other) const { return buffer == other.buffer; }
+    const unsigned char* data() const { return buffer->data(); }
+    size_t size() const { return buffer->size(); }
+    uint32_t useCount() const { return buffer ? buffer->refs : 0; }
+
+private:
+    FrameBuffer* buffer = nullptr;
+};
+
+// Bytes queued for one subscriber, as ranges of shared buffers. Sent bytes
+// are consumed from the front; a partly sent range stays at the front.
+class FrameQueue
+{
+public:
+    // Appends bytes [offset, offset + len) of buffer, holding `frames` data
+    // frames, merged into the last range when it ends where this one starts.
+    // Ranges without data frames (CFG-2) are never shed.
+    void push(const FrameRef& buffer, size_t offset, size_t len, size_t frames = 0) {
+        if (len == 0) return;
+        queuedBytes += len;
+        queuedFrames += frames;
+        if (head < ranges.size()) {
+            Range& last = ranges.back();
+            if (last.buffer == buffer && last.offset + last.len == offset) {
+                last.len += len;
+                last.frames += frames;
+                return;
+            }
+        }
+        ranges.push_back({buffer, offset, len, frames});
+    }
+
+    bool empty() const { return queuedBytes == 0; }
+    size_t bytes() const { return queuedBytes; }
+    size_t frames() const { return queuedFrames; }
+    size_t rangeCount() const { return ranges.size() - head; }
+    // Ranges held, sent ones not yet reclaimed included.
+    size_t capacityRanges() const { return ranges.size(); }
+
+    // Sheds the data frames of buffer at the back of the queue, i.e. the tick
+    // just queued. Returns the frames shed.
+    size_t dropNewest(const FrameRef& buffer) {
+        size_t shed = 0;
+        while (ranges.size() > firstSheddable()) {
+            Range& last = ranges.back();
+            if (!(last.buffer == buffer) || last.frames == 0) break;
+            queuedBytes -= last.len;
+            queuedFrames -= last.frames;
+            shed += last.frames;
+            ranges.pop_back();
+        }
+        resetIfEmpty();
+        return shed;
+    }
+
+    // Sheds the oldest data frames not yet started, other than those of
+    // buffer (the tick being made room for), until at most maxBytes are
+    // queued or nothing sheddable is left. Returns the frames shed.
+    size_t dropOldest(size_t maxBytes, const FrameRef& buffer) {
+        size_t shed = 0;
+        size_t out = firstSheddable();
+        for (size_t i = out; i < ranges.size(); ++i) {
+            Range& r = ranges[i];
+            if (queuedBytes > maxBytes && r.frames > 0 && !(r.buffer == buffer)) {
+                queuedBytes -= r.len;
+                queuedFrames -= r.frames;
+                shed += r.frames;
+                r.buffer.reset();
+                continue;
+            }
+            if (out != i) ranges[out] = std::move(r);
+            ++out;
+        }
+        ranges.resize(out);
+        resetIfEmpty();
+        return shed;
+    }
+
+    // Points slices at the first ranges; returns how many were filled.
+    size_t gather(std::vector<IoSlice>& slices) const {
+        slices.resize(ranges.size() - head);
+        for (size_t i = head; i < ranges.size(); ++i) {
+            const Range& r = ranges[i];
+            set_io_slice(slices[i - head], r.buffer.data() + r.offset, r.len);
+        }
+        return slices.size();
+    }
+
+    // Drops sent bytes from the front, releasing the buffers fully sent.
+    void consume(size_t sent) {
+        queuedBytes -= sent;
+        while (sent > 0) {
+            Range& r = ranges[head];
+            if (sent < r.len) {
+                r.offset += sent;
+                r.len -= sent;
+                headStarted = true;
+                return;
+            }
+            sent -= r.len;
+            queuedFrames -= r.frames;
+            r.buffer.reset();
+            ++head;
+            headStarted = false;
+        }
+        resetIfEmpty();
+        reclaimSent();
+    }
+
+    void clear() {
+        ranges.clear();
+        head = 0;
+        headStarted = false;
+        queuedBytes = 0;
+        queuedFrames = 0;
+    }
+
+private:
+    struct Range {
+        FrameRef buffer;
+        size_t offset = 0;
+        size_t len = 0;
+        size_t frames = 0;  // Data frames in it, 0 = not sheddable
+    };
+
+    // A range that has partly gone out must be completed.
+    size_t firstSheddable() const { return head + (headStarted ? 1 : 0); }
+
+    void resetIfEmpty() {
+        if (head < ranges.size()) return;
+        ranges.clear();
+        head = 0;
+        headStarted = false;
+    }
+
+    // A queue that never empties (a reader slightly slower than the ticks)
+    // would otherwise keep every range it ever sent. The sent prefix is
+    // erased once it is at least half of the ranges, so the erase moves no
+    // more ranges than were sent since the last one: amortised O(1).
+    void reclaimSent() {
+        if (head < RECLAIM_MIN || head * 2 < ranges.size()) return;
+        ranges.erase(ranges.begin(), ranges.begin() + static_cast<std::ptrdiff_t>(head));
+        head = 0;
+    }
+
+    static const size_t RECLAIM_MIN = 64;
+
+    std::vector<Range> ranges;           // [head, end) still queued
+    size_t head = 0;
+    bool headStarted = false;            // Front range partly sent
+    size_t queuedBytes = 0;
+    size_t queuedFrames = 0;
+};
+
+class FramePublisher
+{
+public:
+    FramePublisher() = default;
+    FramePublisher(const FramePublisher&) = delete;
+    FramePublisher& operator=(const FramePublisher&) = delete;
+
+    // CFG-2 of every PMU index, encoded once.
+    void setConfigFrames(const std::vector<std::vector<unsigned char>>& frames) {
+        configs.clear();
+        for (const std::vector<unsigned char>& frame : frames)
+            configs.push_back(copyToBuffer(frame.data(), frame.size()));
+    }
+
+    const FrameRef& configFrame(size_t pmu) const { return configs[pmu]; }
+
+    // A copy of PMU pmu's CFG-2 with SOC/FRACSEC (time quality cleared) set
+    // and CHK recomputed, so a CFG-2 asked for late does not carry the
+    // startup time.
+    FrameRef configFrameAt(size_t pmu, uint32_t soc, uint32_t fracsec) {
+        const FrameRef& config = configs[pmu];
+        FrameRef ref = copyToBuffer(config.data(), config.size());
+        unsigned char* frame = currentBuffer->bytes.data();
+        store_be32(frame + 6, soc);
+        store_be32(frame + 10, fracsec & 0x00FFFFFF);
+        store_be16(frame + config.size() - 2, calculate_crc(frame, config.size() - 2));
+        return ref;
+    }
+
+    // Copies one tick of frames into a single pooled buffer; they are then
+    // queued to subscribers with enqueueTick().
+    void publish(const std::vector<EncodedFrame>& frames) {
+        size_t total = 0;
+        for (const EncodedFrame& frame : frames) total += frame.len;
+        current = acquire(total);
+        unsigned char* out = currentBuffer->bytes.data();
+        currentFrames.clear();
+        size_t offset = 0;
+        for (const EncodedFrame& frame : frames) {
+            std::memcpy(out + offset, frame.data, frame.len);
+            currentFrames.push_back({offset, frame.len, frame.pmuIndex});
+            offset += frame.len;
+        }
+        tickBytes = total;
+        tickContiguous = true;
+        ++ticks;
+        publishedBytes += total;
+    }
+
+    // Publishes a tick without copying it: its frames lie in [base, base +
+    // size), which stays valid and unchanged until every queue is gone.
+    void publishInPlace(const std::vector<EncodedFrame>& frames, const unsigned char* base, size_t size) {
+        current = acquireView(base, size);
+        currentFrames.clear();
+        tickBytes = 0;
+        tickContiguous = true;
+        for (const EncodedFrame& frame : frames) {
+            size_t offset = static_cast<size_t>(frame.data - base);
+            if (!currentFrames.empty() && currentFrames.back().offset + currentFrames.back().len != offset)
+                tickContiguous = false;
+            currentFrames.push_back({offset, frame.len, frame.pmuIndex});
+            tickBytes += frame.len;
+        }
+        ++ticks;
+        publishedBytes += tickBytes;
+    }
+
+    // Queues the published tick's frames of the PMUs marked in subscribed;
+    // all of them as one range when every PMU is and they are back to back.
+    void enqueueTick(FrameQueue& queue, const std::vector<char>& subscribed, size_t subscribedCount) const {
+        if (!current || currentFrames.empty()) return;
+        if (subscribedCount == subscribed.size() && tickContiguous) {
+            queue.push(current, currentFrames.front().offset, tickBytes, currentFrames.size());
+            return;
+        }
+        for (const TickFrame& frame : currentFrames) {
+            if (subscribed[frame.pmuIndex]) queue.push(current, frame.offset, frame.len, 1);
+        }
+    }
+
+    const FrameRef& tick() const { return current; }
+    uint64_t tickCount() const { return ticks; }
+    uint64_t byteCount() const { return publishedBytes; }
+    // Buffers ever allocated: stays flat unless subscribers fall behind.
+    size_t bufferCount() const { return buffers.size(); }
+
+private:
+    struct TickFrame {
+        size_t offset;
+        size_t len;
+        size_t pmuIndex;
+    };
+
+    FrameRef acquire(size_t size) {
+        if (freeBuffers.empty()) {
+            buffers.push_back(std::make_unique<FrameBuffer>());
+            buffers.back()->freeList = &freeBuffers;
+            freeBuffers.push_back(buffers.back().get());
+        }
+        currentBuffer = freeBuffers.back();
+        freeBuffers.pop_back();
+        currentBuffer->view = nullptr;
+        currentBuffer->viewSize = 0;
+        currentBuffer->bytes.resize(size);
+        return FrameRef(currentBuffer);
+    }
+
+    FrameRef acquireView(const unsigned char* base, size_t size) {
+        FrameRef ref = acquire(0);
+        currentBuffer->view = base;
+        currentBuffer->viewSize = size;
+        return ref;
+    }
+
+    FrameRef copyToBuffer(const unsigned char* data, size_t len) {
+        FrameRef ref = acquire(len);
+        std::memcpy(currentBuffer->bytes.data(), data, len);
+        return ref;
+    }
+
+    // Declared first so the references below are released before it goes.
+    std::vector<std::unique_ptr<FrameBuffer>> buffers;
+    std::vector<FrameBuffer*> freeBuffers;
+    FrameBuffer* currentBuffer = nullptr;  // Buffer last acquired
+    std::vector<FrameRef> configs;
+    FrameRef current;                      // Last published tick
+    std::vector<TickFrame> currentFrames;
+    size_t tickBytes = 0;
+    bool tickContiguous = true;            // currentFrames back to back
+    uint64_t ticks = 0;
+    uint64_t publishedBytes = 0;
+};
+
+#endif // FRAME_PUBLISHER_H
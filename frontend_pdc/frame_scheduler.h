@@ -0,0 +1,268 @@
+#ifndef FRAME_SCHEDULER_H
+#define FRAME_SCHEDULER_H
+
+// Deadline-based reporting clock for the PMU simulator.
+//
+// Reports of a PMU at R frames/s are due at the nominal instants S + k/R of
+// every UTC second S, k = 0..R-1. FrameScheduler walks those instants as
+// absolute deadlines (one sequence per reporting rate, merged when they
+// coincide) so error never accumulates, and hands out SOC/FRACSEC of the
+// nominal instant rather than of the moment the frame happens to be encoded.
+// DeadlineTimer sleeps until an absolute deadline: a CLOCK_REALTIME timerfd
+// that is watched by the poller on Linux, a poll timeout plus a short
+// sleep_until elsewhere.
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "socket_compat.h"
+
+#ifdef __linux__
+#include <sys/timerfd.h>
+#endif
+
+inline int64_t realtime_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// --- Jitter histogram ---
+// Lateness of each tick relative to its deadline, in fixed microsecond buckets.
+class JitterHistogram
+{
+public:
+    static constexpr std::array<int64_t, 11> BOUNDS_US = {10, 20, 50, 100, 200, 500, 1000, 2000, 5000, 10000, 20000};
+    static const size_t BUCKETS = BOUNDS_US.size() + 1;
+
+    void record(int64_t lateNs) {
+        int64_t us = std::max<int64_t>(0, lateNs / 1000);
+        size_t b = 0;
+        while (b < BOUNDS_US.size() && us >= BOUNDS_US[b]) ++b;
+        ++counts[b];
+        ++total;
+        sumUs += us;
+        maxUs = std::max(maxUs, us);
+    }
+
+    void reset() { *this = JitterHistogram(); }
+
+    uint64_t count() const { return total; }
+    uint64_t bucketCount(size_t b) const { return counts[b]; }
+    int64_t maxMicros() const { return maxUs; }
+    double meanMicros() const { return total ? static_cast<double>(sumUs) / total : 0.0; }
+
+    // Upper bound of the bucket holding the given quantile (0..1).
+    int64_t quantileMicros(double q) const {
+        uint64_t target = static_cast<uint64_t>(q * total);
+        uint64_t seen = 0;
+        for (size_t b = 0; b < BUCKETS; ++b) {
+            seen += counts[b];
+            if (seen > target) return b < BOUNDS_US.size() ? BOUNDS_US[b] : maxUs;
+        }
+        return maxUs;
+    }
+
+    std::string format() const {
+        std::string out;
+        int64_t lower = 0;
+        for (size_t b = 0; b < BUCKETS; ++b) {
+            if (counts[b] == 0) {
+                if (b < BOUNDS_US.size()) lower = BOUNDS_US[b];
+                continue;
+            }
+            std::string range = (b < BOUNDS_US.size())
+                ? std::to_string(lower) + "-" + std::to_string(BOUNDS_US[b]) + "us"
+                : ">=" + std::to_string(lower) + "us";
+            out += "  " + range + ": " + std::to_string(counts[b]) + "\n";
+            if (b < BOUNDS_US.size()) lower = BOUNDS_US[b];
+        }
+        return out;
+    }
+
+private:
+    std::array<uint64_t, BUCKETS> counts{};
+    uint64_t total = 0;
+    int64_t sumUs = 0;
+    int64_t maxUs = 0;
+};
+
+// --- Scheduler ---
+struct FrameTick {
+    uint64_t dueGroups = 0;  // Bit g set: rate group g reports at this instant
+    uint32_t soc = 0;
+    uint32_t fracsec = 0;    // Nominal instant in TIME_BASE units
+    int64_t deadlineNs = 0;  // Unix time of the nominal instant
+};
+
+class FrameScheduler
+{
+public:
+    FrameScheduler(const std::vector<uint16_t>& rates, uint32_t timeBase)
+        : timeBase(timeBase)
+    {
+        for (uint16_t rate : rates)
+            groups.push_back({rate, 0, 0, 0});
+    }
+
+    // Schedules every group at its first nominal instant at or after nowNs.
+    void start(int64_t nowNs) {
+        int64_t sec = nowNs / NS_PER_SEC;
+        int64_t intoSec = nowNs % NS_PER_SEC;
+        for (Group& g : groups) {
+            g.second = sec;
+            g.index = static_cast<uint32_t>((intoSec * g.rate + NS_PER_SEC - 1) / NS_PER_SEC);
+            normalize(g);
+        }
+    }
+
+    int64_t nextDeadlineNs() const {
+        int64_t next = INT64_MAX;
+        for (const Group& g : groups)
+            next = std::min(next, g.deadlineNs);
+        return next;
+    }
+
+    // Returns the earliest pending instant and advances every group due at it.
+    // Instants that are already fully in the past at nowNs are skipped and
+    // counted in missedFrames(), so a stall does not cause a catch-up burst.
+    FrameTick pop(int64_t nowNs) {
+        FrameTick tick;
+        tick.deadlineNs = nextDeadlineNs();
+        for (size_t i = 0; i < groups.size(); ++i) {
+            Group& g = groups[i];
+            if (g.deadlineNs != tick.deadlineNs) continue;
+            tick.dueGroups |= uint64_t(1) << i;
+            tick.soc = static_cast<uint32_t>(g.second);
+            tick.fracsec = static_cast<uint32_t>((static_cast<uint64_t>(g.index) * timeBase + g.rate / 2) / g.rate);
+
+            ++g.index;
+            normalize(g);
+            while (g.deadlineNs <= nowNs) {
+                ++missed;
+                ++g.index;
+                normalize(g);
+            }
+        }
+        return tick;
+    }
+
+    uint64_t missedFrames() const { return missed; }
+
+private:
+    static constexpr int64_t NS_PER_SEC = 1000000000;
+
+    struct Group {
+        uint16_t rate;
+        int64_t second;
+        uint32_t index;
+        int64_t deadlineNs;
+    };
+
+    static void normalize(Group& g) {
+        g.second += g.index / g.rate;
+        g.index %= g.rate;
+        g.deadlineNs = g.second * NS_PER_SEC + static_cast<int64_t>(g.index) * NS_PER_SEC / g.rate;
+    }
+
+    uint32_t timeBase;
+    std::vector<Group> groups;
+    uint64_t missed = 0;
+};
+
+// --- Deadline timer ---
+class DeadlineTimer
+{
+public:
+    DeadlineTimer() {
+#ifdef __linux__
+        fd = timerfd_create(CLOCK_REALTIME, TFD_NONBLOCK | TFD_CLOEXEC);
+#endif
+    }
+
+    ~DeadlineTimer() {
+#ifdef __linux__
+        if (fd >= 0) close(fd);
+#endif
+    }
+
+    DeadlineTimer(const DeadlineTimer&) = delete;
+    DeadlineTimer& operator=(const DeadlineTimer&) = delete;
+
+    // Socket-like handle to register with the poller, or INVALID_SOCKET when
+    // the platform has no timer descriptor or it could not be created.
+    SOCKET handle() const {
+#ifdef __linux__
+        return fd >= 0 ? fd : INVALID_SOCKET;
+#else
+        return INVALID_SOCKET;
+#endif
+    }
+
+    // Gives up the timer descriptor (the poller would not take it): deadlines
+    // are then kept with the poll timeout, as without a kernel timer.
+    void releaseHandle() {
+#ifdef __linux__
+        if (fd >= 0) close(fd);
+        fd = -1;
+#endif
+    }
+
+    void arm(int64_t deadlineNs) {
+        deadline = deadlineNs;
+#ifdef __linux__
+        if (fd < 0) return;
+        itimerspec spec{};
+        spec.it_value.tv_sec = static_cast<time_t>(deadlineNs / 1000000000);
+        spec.it_value.tv_nsec = static_cast<long>(deadlineNs % 1000000000);
+        timerfd_settime(fd, TFD_TIMER_ABSTIME, &spec, nullptr);
+#endif
+    }
+
+    void disarm() {
+        deadline = INT64_MAX;
+#ifdef __linux__
+        if (fd < 0) return;
+        itimerspec spec{};
+        timerfd_settime(fd, 0, &spec, nullptr);
+#endif
+    }
+
+    // Clears the expiration count after the handle became readable.
+    void consume() {
+#ifdef __linux__
+        if (fd < 0) return;
+        uint64_t expirations;
+        ssize_t n = read(fd, &expirations, sizeof(expirations));
+        (void)n;
+#endif
+    }
+
+    // Poll timeout to use alongside the timer: -1 when the kernel timer wakes
+    // the poller, otherwise the milliseconds left (rounded down, see finishWait()).
+    int pollTimeoutMs(int64_t nowNs) const {
+        if (deadline == INT64_MAX || handle() != INVALID_SOCKET) return -1;
+        return static_cast<int>(std::max<int64_t>(0, (deadline - nowNs) / 1000000));
+    }
+
+    // Without a kernel timer the poll timeout only has millisecond
+    // resolution; sleep away the sub-millisecond remainder.
+    void finishWait() const {
+        if (deadline == INT64_MAX || handle() != INVALID_SOCKET) return;
+        int64_t remaining = deadline - realtime_ns();
+        if (remaining > 0 && remaining < 2000000)
+            std::this_thread::sleep_for(std::chrono::nanoseconds(remaining));
+    }
+
+private:
+#ifdef __linux__
+    int fd = -1;
+#endif
+    int64_t deadline = INT64_MAX;
+};
+
+#endif // FRAME_SCHEDULER_H
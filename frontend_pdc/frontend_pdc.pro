@@ -8,11 +8,29 @@ CONFIG += c++17
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
 SOURCES += \
+    concentrator.cpp \
+    ingest_worker.cpp \
     main.cpp \
     mainwindow.cpp \
+    plot_widget.cpp \
 
 HEADERS += \
-    mainwindow.h
+    c37118_decoder.h \
+    c37118_framer.h \
+    c37118_layout.h \
+    channel_store.h \
+    concentrator.h \
+    crc_ccitt.h \
+    history_archive.h \
+    ingest_worker.h \
+    latency_histogram.h \
+    m4_decimator.h \
+    mainwindow.h \
+    perf_counters.h \
+    plot_widget.h \
+    sample_ring.h \
+    sliding_extrema.h \
+    time_aligner.h
 
 FORMS += \
     mainwindow.ui
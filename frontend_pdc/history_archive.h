@@ -0,0 +1,414 @@
+#ifndef HISTORY_ARCHIVE_H
+#define HISTORY_ARCHIVE_H
+
+// Append-only on-disk sample history, read through memory mappings.
+//
+// An archive is a directory holding one channel layout. Samples are stored
+// as columns split into segments of SEGMENT_SAMPLES: per segment there is a
+// time file, one file per channel (float or double, like ChannelStore) and
+// an index file with one record per INDEX_BLOCK samples, holding the
+// block's first timestamp and every channel's min/max. Segment files are
+// preallocated and mapped once, so appends are plain stores into the
+// mapping and reads walk the page cache without copying anything to the
+// heap; RAM use does not depend on how much history is on disk.
+//
+// Time lookups binary-search the index records, then one block of the time
+// column. extrema() reads the partial blocks at the ends of a range and the
+// index records in between.
+//
+// Durability is batched: a background thread flushes the mappings every
+// SYNC_SECONDS and only then records the new sample count in the header, so
+// after a crash the archive reopens at the last synced sample. Reads and
+// appends happen on one thread (the GUI's); the sync thread only flushes.
+
+#include <QByteArray>
+#include <QDir>
+#include <QFile>
+#include <QString>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+class HistoryArchive
+{
+public:
+    static const size_t SEGMENT_SAMPLES = 1u << 22;  // About 23 hours at 50 frames/s
+    static const size_t INDEX_BLOCK = 4096;
+    static constexpr double SYNC_SECONDS = 2.0;
+
+    HistoryArchive() = default;
+    HistoryArchive(const HistoryArchive&) = delete;
+    HistoryArchive& operator=(const HistoryArchive&) = delete;
+    ~HistoryArchive() { close(); }
+
+    // Opens the archive in dir, creating it if there is none. floatColumns[c]
+    // selects float32 storage for channel c and must match an existing
+    // archive's layout.
+    bool open(const QString& dir, const std::vector<bool>& floatColumns) {
+        close();
+        if (!QDir().mkpath(dir)) return false;
+        path = dir;
+        isFloat = floatColumns;
+        header.reset(new QFile(QDir(path).filePath("header")));
+        if (!header->open(QIODevice::ReadWrite)) return close(), false;
+
+        uint64_t stored = 0;
+        double storedOrigin = 0.0;
+        if (header->size() > 0 && !readHeader(stored, storedOrigin)) return close(), false;
+        originTime = storedOrigin;
+        for (size_t s = 0; s * SEGMENT_SAMPLES < stored; ++s)
+            if (!addSegment()) return close(), false;
+        count = static_cast<size_t>(stored);
+        published.store(stored, std::memory_order_relaxed);
+        synced = stored;  // Already on disk: the first sync starts at its segment
+        if (header->size() == 0 && !writeHeader(0)) return close(), false;
+        rebuildLastBlock();
+
+        stopping = false;
+        syncer = std::thread([this]() { syncLoop(); });
+        return true;
+    }
+
+    // Flushes everything appended and releases the mappings.
+    void close() {
+        if (syncer.joinable()) {
+            {
+                std::lock_guard<std::mutex> lock(syncMutex);
+                stopping = true;
+            }
+            wake.notify_all();
+            syncer.join();
+        }
+        segments.clear();
+        header.reset();
+        count = 0;
+        published.store(0, std::memory_order_relaxed);
+        synced = 0;
+    }
+
+    bool isOpen() const { return header != nullptr; }
+    size_t channelCount() const { return isFloat.size(); }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    uint64_t firstIndex() const { return 0; }  // Nothing is ever dropped
+
+    // Size of the mapped segments, which the page cache holds as they fill.
+    size_t mappedBytes() const {
+        size_t bytes = 0;
+        for (const std::unique_ptr<Segment>& seg : segments)
+            for (qint64 n : seg->bytes) bytes += static_cast<size_t>(n);
+        return bytes;
+    }
+
+    // Absolute time that the stored (relative) timestamps count from.
+    double origin() const { return originTime; }
+    void setOrigin(double t) {
+        std::lock_guard<std::mutex> lock(syncMutex);
+        originTime = t;
+    }
+
+    // row holds one value per channel. False if a new segment could not be
+    // allocated (disk full); the sample is not stored.
+    bool append(double time, const double* row) {
+        if (count == segments.size() * SEGMENT_SAMPLES && !addSegment()) return false;
+        Segment& seg = *segments[count / SEGMENT_SAMPLES];
+        size_t slot = count % SEGMENT_SAMPLES;
+        double* record = seg.record(slot / INDEX_BLOCK, channelCount());
+        bool blockStart = slot % INDEX_BLOCK == 0;
+        seg.times()[slot] = time;
+        if (blockStart) record[0] = time;
+        for (size_t c = 0; c < channelCount(); ++c) {
+            double stored;
+            if (isFloat[c]) stored = seg.floats(c)[slot] = static_cast<float>(row[c]);
+            else stored = seg.doubles(c)[slot] = row[c];
+            double& lo = record[1 + 2 * c];
+            double& hi = record[2 + 2 * c];
+            if (blockStart || stored < lo) lo = stored;
+            if (blockStart || stored > hi) hi = stored;
+        }
+        ++count;
+        published.store(count, std::memory_order_release);
+        return true;
+    }
+
+    double time(size_t i) const {
+        return segments[i / SEGMENT_SAMPLES]->times()[i % SEGMENT_SAMPLES];
+    }
+
+    double value(size_t channel, size_t i) const {
+        const Segment& seg = *segments[i / SEGMENT_SAMPLES];
+        size_t slot = i % SEGMENT_SAMPLES;
+        return isFloat[channel] ? seg.floats(channel)[slot] : seg.doubles(channel)[slot];
+    }
+
+    // First sample at or after t, and first sample after t (size() if none).
+    size_t lowerBound(double t) const {
+        return partitionPoint([t](double time) { return time < t; });
+    }
+    size_t upperBound(double t) const {
+        return partitionPoint([t](double time) { return time <= t; });
+    }
+
+    // Smallest and largest value of one channel over samples [begin, end);
+    // false if the range is empty.
+    bool extrema(size_t channel, size_t begin, size_t end, double& lo, double& hi) const {
+        end = std::min(end, count);
+        if (begin >= end) return false;
+        lo = std::numeric_limits<double>::infinity();
+        hi = -lo;
+        auto widen = [&lo, &hi](double, double v) {
+            lo = std::min(lo, v);
+            hi = std::max(hi, v);
+        };
+        size_t firstFull = (begin + INDEX_BLOCK - 1) / INDEX_BLOCK;
+        size_t lastFull = end / INDEX_BLOCK;
+        if (firstFull >= lastFull) {
+            forEach(channel, begin, end, widen);
+            return true;
+        }
+        forEach(channel, begin, firstFull * INDEX_BLOCK, widen);
+        forEach(channel, lastFull * INDEX_BLOCK, end, widen);
+        for (size_t block = firstFull; block < lastFull; ++block) {
+            const double* record = blockRecord(block);
+            lo = std::min(lo, record[1 + 2 * channel]);
+            hi = std::max(hi, record[2 + 2 * channel]);
+        }
+        return true;
+    }
+
+    // Calls f(time, value) for samples [begin, end) of one channel, a
+    // segment's contiguous run at a time.
+    template <typename F>
+    void forEach(size_t channel, size_t begin, size_t end, F f) const {
+        end = std::min(end, count);
+        while (begin < end) {
+            const Segment& seg = *segments[begin / SEGMENT_SAMPLES];
+            size_t slot = begin % SEGMENT_SAMPLES;
+            size_t run = std::min(end - begin, SEGMENT_SAMPLES - slot);
+            const double* t = seg.times() + slot;
+            if (isFloat[channel]) {
+                const float* v = seg.floats(channel) + slot;
+                for (size_t k = 0; k < run; ++k) f(t[k], static_cast<double>(v[k]));
+            }
+            else {
+                const double* v = seg.doubles(channel) + slot;
+                for (size_t k = 0; k < run; ++k) f(t[k], v[k]);
+            }
+            begin += run;
+        }
+    }
+
+private:
+    static constexpr char MAGIC[8] = {'P', 'M', 'U', 'H', 'I', 'S', 'T', '1'};
+
+    // header: MAGIC, uint32 channels, uint8 isFloat per channel, double
+    // origin, uint64 synced sample count.
+    struct Segment {
+        std::vector<std::unique_ptr<QFile>> files;  // Time, channels, index
+        std::vector<uchar*> maps;
+        std::vector<qint64> bytes;
+
+        double* times() const { return reinterpret_cast<double*>(maps[0]); }
+        double* doubles(size_t c) const { return reinterpret_cast<double*>(maps[1 + c]); }
+        float* floats(size_t c) const { return reinterpret_cast<float*>(maps[1 + c]); }
+        double* record(size_t block, size_t channels) const {
+            return reinterpret_cast<double*>(maps.back()) + block * (1 + 2 * channels);
+        }
+    };
+
+    const double* blockRecord(size_t block) const {
+        size_t perSegment = SEGMENT_SAMPLES / INDEX_BLOCK;
+        return segments[block / perSegment]->record(block % perSegment, channelCount());
+    }
+
+    template <typename Pred>
+    size_t partitionPoint(Pred before) const {
+        // Blocks first, by their first timestamp, then within one block.
+        size_t lo = 0, hi = (count + INDEX_BLOCK - 1) / INDEX_BLOCK;
+        while (lo < hi) {
+            size_t mid = lo + (hi - lo) / 2;
+            if (before(blockRecord(mid)[0])) lo = mid + 1;
+            else hi = mid;
+        }
+        if (lo == 0) return 0;
+        size_t first = (lo - 1) * INDEX_BLOCK + 1;  // The block's first sample is before
+        size_t last = std::min(lo * INDEX_BLOCK, count);
+        while (first < last) {
+            size_t mid = first + (last - first) / 2;
+            if (before(time(mid))) first = mid + 1;
+            else last = mid;
+        }
+        return first;
+    }
+
+    bool addSegment() {
+        std::unique_ptr<Segment> seg(new Segment());
+        size_t index = segments.size();
+        std::vector<qint64> sizes;
+        sizes.push_back(static_cast<qint64>(SEGMENT_SAMPLES * sizeof(double)));
+        for (bool f : isFloat)
+            sizes.push_back(static_cast<qint64>(SEGMENT_SAMPLES * (f ? sizeof(float) : sizeof(double))));
+        sizes.push_back(static_cast<qint64>(SEGMENT_SAMPLES / INDEX_BLOCK * (1 + 2 * channelCount()) * sizeof(double)));
+
+        for (size_t column = 0; column < sizes.size(); ++column) {
+            QString name = column == 0 ? QString("time") :
+                           column + 1 == sizes.size() ? QString("index") :
+                           QString("ch%1").arg(column - 1, 3, 10, QChar('0'));
+            name += QString(".%1").arg(index, 6, 10, QChar('0'));
+            std::unique_ptr<QFile> file(new QFile(QDir(path).filePath(name)));
+            if (!file->open(QIODevice::ReadWrite)) return false;
+            if (file->size() < sizes[column] && !allocate(*file, sizes[column])) return false;
+            uchar* map = file->map(0, sizes[column]);
+            if (!map) return false;
+            seg->files.push_back(std::move(file));
+            seg->maps.push_back(map);
+            seg->bytes.push_back(sizes[column]);
+        }
+        std::lock_guard<std::mutex> lock(syncMutex);
+        segments.push_back(std::move(seg));
+        return true;
+    }
+
+    // Reserves the disk blocks up front where the platform allows it, so a
+    // full disk fails here rather than as a fault on a store into the mapping.
+    static bool allocate(QFile& file, qint64 bytes) {
+#if defined(__linux__)
+        file.flush();
+        return posix_fallocate(file.handle(), 0, bytes) == 0;
+#else
+        return file.resize(bytes);
+#endif
+    }
+
+    // The index record of the newest block may hold values whose count was
+    // never synced; recompute it from the samples that were.
+    void rebuildLastBlock() {
+        if (count % INDEX_BLOCK == 0) return;
+        size_t begin = count - count % INDEX_BLOCK;
+        double* record = segments[begin / SEGMENT_SAMPLES]->record((begin % SEGMENT_SAMPLES) / INDEX_BLOCK, channelCount());
+        record[0] = time(begin);
+        for (size_t c = 0; c < channelCount(); ++c) {
+            double lo = std::numeric_limits<double>::infinity(), hi = -lo;
+            forEach(c, begin, count, [&lo, &hi](double, double v) {
+                lo = std::min(lo, v);
+                hi = std::max(hi, v);
+            });
+            record[1 + 2 * c] = lo;
+            record[2 + 2 * c] = hi;
+        }
+    }
+
+    bool readHeader(uint64_t& stored, double& storedOrigin) {
+        QByteArray bytes = header->readAll();
+        size_t channels = channelCount();
+        size_t expected = sizeof(MAGIC) + sizeof(uint32_t) + channels + sizeof(double) + sizeof(uint64_t);
+        if (static_cast<size_t>(bytes.size()) != expected || std::memcmp(bytes.constData(), MAGIC, sizeof(MAGIC)) != 0)
+            return false;
+        const char* p = bytes.constData() + sizeof(MAGIC);
+        uint32_t storedChannels;
+        std::memcpy(&storedChannels, p, sizeof(storedChannels));
+        p += sizeof(storedChannels);
+        if (storedChannels != channels) return false;
+        for (size_t c = 0; c < channels; ++c)
+            if ((p[c] != 0) != isFloat[c]) return false;
+        p += channels;
+        std::memcpy(&storedOrigin, p, sizeof(storedOrigin));
+        std::memcpy(&stored, p + sizeof(storedOrigin), sizeof(stored));
+        return true;
+    }
+
+    bool writeHeader(uint64_t synced) {
+        QByteArray bytes(MAGIC, sizeof(MAGIC));
+        uint32_t channels = static_cast<uint32_t>(channelCount());
+        bytes.append(reinterpret_cast<const char*>(&channels), sizeof(channels));
+        for (bool f : isFloat) bytes.append(f ? '\1' : '\0');
+        double t;
+        {
+            std::lock_guard<std::mutex> lock(syncMutex);
+            t = originTime;
+        }
+        bytes.append(reinterpret_cast<const char*>(&t), sizeof(t));
+        bytes.append(reinterpret_cast<const char*>(&synced), sizeof(synced));
+        return header->seek(0) && header->write(bytes) == bytes.size() && syncFile(*header);
+    }
+
+    static bool syncFile(QFile& file) {
+        if (!file.flush()) return false;
+#ifdef _WIN32
+        return FlushFileBuffers(reinterpret_cast<HANDLE>(_get_osfhandle(file.handle()))) != 0;
+#else
+        return fsync(file.handle()) == 0;
+#endif
+    }
+
+    static bool syncMapping(uchar* map, qint64 bytes, QFile& file) {
+#ifdef _WIN32
+        return FlushViewOfFile(map, static_cast<SIZE_T>(bytes)) != 0 && syncFile(file);
+#else
+        (void)file;
+        return msync(map, static_cast<size_t>(bytes), MS_SYNC) == 0;
+#endif
+    }
+
+    // Flushes the segments written since the last sync, then the header.
+    void syncNow() {
+        uint64_t target = published.load(std::memory_order_acquire);
+        if (target == synced) return;
+        {
+            std::lock_guard<std::mutex> lock(syncMutex);
+            size_t first = static_cast<size_t>(synced / SEGMENT_SAMPLES);
+            size_t last = std::min(segments.size(), static_cast<size_t>((target + SEGMENT_SAMPLES - 1) / SEGMENT_SAMPLES));
+            for (size_t s = first; s < last; ++s) {
+                Segment& seg = *segments[s];
+                for (size_t f = 0; f < seg.files.size(); ++f)
+                    syncMapping(seg.maps[f], seg.bytes[f], *seg.files[f]);
+            }
+        }
+        if (writeHeader(target)) synced = target;
+    }
+
+    void syncLoop() {
+        auto interval = std::chrono::duration<double>(SYNC_SECONDS);
+        std::unique_lock<std::mutex> lock(syncMutex);
+        while (!stopping) {
+            wake.wait_for(lock, interval, [this]() { return stopping; });
+            lock.unlock();
+            syncNow();
+            lock.lock();
+        }
+    }
+
+    QString path;
+    std::vector<bool> isFloat;
+    std::unique_ptr<QFile> header;
+    std::vector<std::unique_ptr<Segment>> segments;  // Appended under syncMutex
+    size_t count = 0;                   // Appended samples
+    std::atomic<uint64_t> published{0}; // count, for the sync thread
+    uint64_t synced = 0;                // Sync thread only (and open/close)
+    double originTime = 0.0;            // Under syncMutex
+
+    std::thread syncer;
+    std::mutex syncMutex;
+    std::condition_variable wake;
+    bool stopping = false;
+};
+
+#endif // HISTORY_ARCHIVE_H
@@ -0,0 +1,184 @@
+#include "ingest_worker.h"
+
+#include <QDateTime>
+#include <QDebug>
+#include <QElapsedTimer>
+
+#include <algorithm>
+#include <cmath>
+
+IngestWorker::IngestWorker(const QString &host, quint16 port, QObject *parent)
+    : QObject(parent), host(host), port(port)
+{
+    qRegisterMetaType<ConfigFrame>();
+    qRegisterMetaType<std::shared_ptr<SampleRing>>();
+    qRegisterMetaType<AlignedStreams>();
+}
+
+bool IngestWorker::parseEndpoint(const QString &text, QString &host, quint16 &port)
+{
+    int colon = text.lastIndexOf(':');
+    if(colon <= 0) return false;
+    bool ok = false;
+    uint value = text.mid(colon + 1).toUInt(&ok);
+    if(!ok || value == 0 || value > 65535) return false;
+    host = text.left(colon);
+    port = static_cast<quint16>(value);
+    return true;
+}
+
+void IngestWorker::concentrateAs(int sourceNumber)
+{
+    source = sourceNumber;
+    pmuIdCode = 0xFFFF;  // Every PMU on the connection
+}
+
+void IngestWorker::start()
+{
+    socket = new QTcpSocket(this);
+    connect(socket, &QTcpSocket::connected, this, &IngestWorker::onConnected);
+    connect(socket, &QTcpSocket::readyRead, this, &IngestWorker::onReadyRead);
+    socket->connectToHost(host, port);
+}
+
+void IngestWorker::onConnected()
+{
+    framer.reset();
+    sendCommand(CMD_SEND_CFG2);
+}
+
+void IngestWorker::sendCommand(uint16_t command)
+{
+    unsigned char frame[COMMAND_FRAME_SIZE];
+    build_command_frame(frame, pmuIdCode, command, static_cast<uint32_t>(QDateTime::currentSecsSinceEpoch()));
+    socket->write(reinterpret_cast<const char*>(frame), COMMAND_FRAME_SIZE);
+}
+
+void IngestWorker::setAligner(const AlignedStreams &aligned)
+{
+    aligner = aligned.aligner;
+    for(Stream &stream : streams) {
+        auto it = std::find(aligned.streams.begin(), aligned.streams.end(), std::make_pair(source, stream.idCode));
+        stream.column = it != aligned.streams.end() ? static_cast<int>(it - aligned.streams.begin()) : -1;
+    }
+    sendCommand(CMD_TURN_ON_TX);
+}
+
+// A new or changed CFG-2 of one PMU stream; the concentrator rebuilds its
+// combined configuration, until then the stream's data is not aligned.
+void IngestWorker::handleStreamConfig(const unsigned char *frame, size_t len)
+{
+    uint16_t idCode = load_be16(frame + 4);
+    QByteArray body(reinterpret_cast<const char*>(frame) + 14, static_cast<int>(len) - 16);
+    int index = streamIndex.value(idCode, -1);
+    if(index >= 0 && streams[index].configBody == body) return;
+    ConfigFrame cfg;
+    if(!parse_config_frame(frame, len, cfg)) {
+        qWarning() << "Ignoring malformed configuration frame of PMU" << idCode;
+        return;
+    }
+    if(index < 0) {
+        index = static_cast<int>(streams.size());
+        streams.emplace_back();
+        streamIndex.insert(idCode, index);
+    }
+    Stream &stream = streams[index];
+    stream.idCode = idCode;
+    stream.configBody = body;
+    stream.timeBase = cfg.timeBase;
+    stream.decoder.configure(cfg);
+    stream.column = -1;
+    emit streamConfigured(source, cfg);
+}
+
+// Decodes a data frame straight into its slot of the aligner.
+void IngestWorker::insertAligned(const unsigned char *frame, size_t len)
+{
+    if(!aligner) return;
+    int index = streamIndex.value(load_be16(frame + 4), -1);
+    if(index < 0) return;
+    Stream &stream = streams[index];
+    if(stream.column < 0) return;
+    if(len != stream.decoder.expectedFrameSize()) {
+        ++batchMalformed;
+        return;
+    }
+    uint64_t frameIndex = aligner->frameIndex(load_be32(frame + 6), load_be32(frame + 10) & 0x00FFFFFF,
+                                              stream.timeBase);
+    FrameTime time;
+    aligner->insert(static_cast<size_t>(stream.column), frameIndex, aligner_clock_ns(), [&](double *block) {
+        stream.decoder.decode(frame, len, block, time);
+    });
+    ++batchFrames;
+    if(latency && time.soc) latency->parse.record(wall_clock_ns() - frame_time_ns(time));
+}
+
+void IngestWorker::handleFrame(const unsigned char *frame, size_t len)
+{
+    if(source >= 0) {
+        FrameType type = frame_type(frame);
+        if(type == FrameType::Config1 || type == FrameType::Config2) handleStreamConfig(frame, len);
+        else if(type == FrameType::Data) insertAligned(frame, len);
+        return;
+    }
+    switch(frame_type(frame)) {
+    case FrameType::Config1:
+    case FrameType::Config2: {
+        QByteArray body(reinterpret_cast<const char*>(frame) + 14, static_cast<int>(len) - 16);
+        if(decoder.configured() && body == configBody) return;
+        ConfigFrame cfg;
+        if(!parse_config_frame(frame, len, cfg)) {
+            qWarning() << "Ignoring malformed configuration frame";
+            return;
+        }
+        configBody = body;
+        decoder.configure(cfg);
+        decodedRow.resize(static_cast<int>(decoder.channelCount()));
+        double rows = cfg.framePeriod() > 0 ? std::ceil(QUEUE_SECONDS / cfg.framePeriod()) : 0.0;
+        ring = std::make_shared<SampleRing>(decoder.channelCount(),
+                                            qMax(MIN_QUEUE_ROWS, static_cast<size_t>(rows)));
+        emit configReceived(cfg, ring);
+        sendCommand(CMD_TURN_ON_TX);
+        return;
+    }
+    case FrameType::Data: {
+        FrameTime time;
+        if(!ring) return;
+        if(!decoder.decode(frame, len, decodedRow.data(), time)) {
+            ++batchMalformed;
+            return;
+        }
+        ++batchFrames;
+        if(latency) latency->parse.record(wall_clock_ns() - frame_time_ns(time));
+        ring->push(time.seconds, decodedRow.constData());
+        return;
+    }
+    default:
+        return;
+    }
+}
+
+void IngestWorker::onReadyRead()
+{
+    // Read straight into the framer's ring and drain complete frames after
+    // every read, so a burst larger than the free space is still consumed.
+    QElapsedTimer timer;
+    if(counters) timer.start();
+    FrameView frame;
+    uint64_t bytes = 0;
+    while(socket->bytesAvailable() > 0) {
+        if(framer.writable() == 0) framer.reset();  // Frame longer than the ring: resync
+        qint64 n = socket->read(reinterpret_cast<char*>(framer.writePtr()),
+                                static_cast<qint64>(framer.writable()));
+        if(n <= 0) break;
+        framer.commit(static_cast<size_t>(n));
+        bytes += static_cast<uint64_t>(n);
+        while(framer.next(frame))
+            handleFrame(frame.data, frame.size);
+    }
+    if(!counters) return;
+    batchMalformed += framer.crcErrors() - reportedCrcErrors;
+    reportedCrcErrors = framer.crcErrors();
+    counters->addBatch(batchFrames, batchMalformed, bytes, timer.nsecsElapsed());
+    batchFrames = batchMalformed = 0;
+}
@@ -0,0 +1,116 @@
+#ifndef INGEST_WORKER_H
+#define INGEST_WORKER_H
+
+// C37.118.2 client that runs on its own thread.
+//
+// IngestWorker owns the TCP connection: it reads into the framer, validates
+// and decodes frames and answers configuration frames with the commands the
+// PMU expects, so a blocked GUI thread (a modal dialog, a slow repaint)
+// never stalls the socket. Decoded samples go into a SampleRing that the GUI
+// drains on its render timer. Every new configuration comes with a fresh
+// ring sized for it, handed over through configReceived(); samples of the
+// previous configuration still queued are discarded with the old ring.
+//
+// For the concentrator (concentrateAs()) the worker asks for the CFG-2 of
+// every PMU on the connection instead, announces each PMU stream with
+// streamConfigured() and inserts decoded data frames straight into the
+// TimeAligner handed over with setAligner(), next to the other sources.
+//
+// Create it without a parent, moveToThread() it and invoke start() through
+// the event loop; the socket is created on the worker thread.
+
+#include <QObject>
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+#include <QTcpSocket>
+#include <QVector>
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "c37118_decoder.h"
+#include "c37118_framer.h"
+#include "latency_histogram.h"
+#include "perf_counters.h"
+#include "sample_ring.h"
+#include "time_aligner.h"
+
+// An aligner and the PMU streams it concentrates, in column order, each as
+// (source number, IDCODE).
+struct AlignedStreams {
+    std::shared_ptr<TimeAligner> aligner;
+    std::vector<std::pair<int, uint16_t>> streams;
+};
+
+Q_DECLARE_METATYPE(ConfigFrame)
+Q_DECLARE_METATYPE(std::shared_ptr<SampleRing>)
+Q_DECLARE_METATYPE(AlignedStreams)
+
+class IngestWorker : public QObject
+{
+    Q_OBJECT
+public:
+    // Seconds of samples the ring holds while the GUI is not draining it.
+    static constexpr double QUEUE_SECONDS = 4.0;
+    static const size_t MIN_QUEUE_ROWS = 1024;
+
+    IngestWorker(const QString &host, quint16 port, QObject *parent = nullptr);
+    // Splits "host:port".
+    static bool parseEndpoint(const QString &text, QString &host, quint16 &port);
+    // Feeds the concentrator as its source number source; call before start().
+    void concentrateAs(int source);
+    // Records the parse stage of every data frame; call before start().
+    void setLatency(const std::shared_ptr<PipelineLatency> &stats) { latency = stats; }
+    // Counts frames and times every socket read; call before start().
+    void setCounters(const std::shared_ptr<IngestCounters> &stats) { counters = stats; }
+
+public slots:
+    void start();
+    void setAligner(const AlignedStreams &aligned);
+
+signals:
+    void configReceived(const ConfigFrame &cfg, const std::shared_ptr<SampleRing> &ring);
+    void streamConfigured(int source, const ConfigFrame &cfg);
+
+private slots:
+    void onConnected();
+    void onReadyRead();
+
+private:
+    // One PMU stream of a concentrated connection.
+    struct Stream {
+        uint16_t idCode = 0;
+        QByteArray configBody;
+        uint32_t timeBase = 1000000;
+        DataFrameDecoder decoder;
+        int column = -1;             // Index in the aligner, -1 = not concentrated
+    };
+
+    void handleFrame(const unsigned char *frame, size_t len);
+    void handleStreamConfig(const unsigned char *frame, size_t len);
+    void insertAligned(const unsigned char *frame, size_t len);
+    void sendCommand(uint16_t command);
+
+    QString host;
+    quint16 port;
+    QTcpSocket *socket = nullptr;
+    uint16_t pmuIdCode = 1;          // IDCODE the commands are addressed to
+    int source = -1;                 // Concentrator source number, -1 = direct
+    StreamFramer framer;             // Received bytes not yet framed
+    QByteArray configBody;           // Last applied CFG-2 without header time and CHK
+    DataFrameDecoder decoder;
+    QVector<double> decodedRow;
+    std::shared_ptr<SampleRing> ring;
+    std::vector<Stream> streams;     // Concentrated mode
+    QHash<quint16, int> streamIndex; // IDCODE -> streams index
+    std::shared_ptr<TimeAligner> aligner;
+    std::shared_ptr<PipelineLatency> latency;
+    std::shared_ptr<IngestCounters> counters;
+    uint64_t batchFrames = 0;        // Counted during one onReadyRead()
+    uint64_t batchMalformed = 0;
+    uint64_t reportedCrcErrors = 0;  // framer.crcErrors() already published
+};
+
+#endif // INGEST_WORKER_H
@@ -0,0 +1,148 @@
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+// Lock-free log-linear latency histogram.
+//
+// Values (ns) fall into 16 linear sub-buckets per power of two, so every
+// quantile is reported within about 6 % of the true value over the whole range
+// from 1 ns to ~36 minutes, in a fixed 5 KB of counters. record() is two
+// relaxed atomic adds (plus a rare CAS for a new maximum) and may be called
+// from any number of threads; readers take quantiles at any time without
+// stopping the writers (a read during writes can miss the samples in flight).
+//
+// PipelineLatency holds one histogram per stage of the frontend's data path,
+// measured from the SOC/FRACSEC stamped into each data frame.
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Wall clock, the clock SOC/FRACSEC are stamped with.
+inline int64_t wall_clock_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+class LatencyHistogram
+{
+public:
+    static const int SUB_BITS = 4;
+    static const int SUB_BUCKETS = 1 << SUB_BITS;
+    static const int MAX_BITS = 41;  // Values are clamped below 2^41 ns
+    static const int BUCKETS = (MAX_BITS - SUB_BITS + 1) * SUB_BUCKETS;
+
+    LatencyHistogram() { reset(); }
+
+    // Negative latencies (clock steps, skew between hosts) count as 0.
+    void record(int64_t ns) {
+        uint64_t v = ns > 0 ? static_cast<uint64_t>(ns) : 0;
+        buckets[bucketOf(v)].fetch_add(1, std::memory_order_relaxed);
+        sum.fetch_add(v, std::memory_order_relaxed);
+        uint64_t seen = maxValue.load(std::memory_order_relaxed);
+        while (v > seen && !maxValue.compare_exchange_weak(seen, v, std::memory_order_relaxed)) {
+        }
+    }
+
+    void reset() {
+        for (std::atomic<uint64_t>& b : buckets) b.store(0, std::memory_order_relaxed);
+        sum.store(0, std::memory_order_relaxed);
+        maxValue.store(0, std::memory_order_relaxed);
+    }
+
+    uint64_t count() const {
+        uint64_t n = 0;
+        for (const std::atomic<uint64_t>& b : buckets) n += b.load(std::memory_order_relaxed);
+        return n;
+    }
+    uint64_t maxNs() const { return maxValue.load(std::memory_order_relaxed); }
+    double meanNs() const {
+        uint64_t n = count();
+        return n ? double(sum.load(std::memory_order_relaxed)) / n : 0.0;
+    }
+
+    // Value below which a fraction q of the samples fall: the midpoint of
+    // the bucket holding it, capped at the maximum seen. 0 when empty.
+    uint64_t quantileNs(double q) const {
+        uint64_t n = 0;
+        uint64_t counts[BUCKETS];
+        for (int i = 0; i < BUCKETS; ++i) {
+            counts[i] = buckets[i].load(std::memory_order_relaxed);
+            n += counts[i];
+        }
+        if (n == 0) return 0;
+        uint64_t rank = static_cast<uint64_t>(q * n);
+        if (rank >= n) rank = n - 1;
+        uint64_t seen = 0;
+        for (int i = 0; i < BUCKETS; ++i) {
+            seen += counts[i];
+            if (seen > rank) {
+                uint64_t mid = bucketLow(i) + (bucketLow(i + 1) - bucketLow(i)) / 2;
+                uint64_t maxNs = maxValue.load(std::memory_order_relaxed);
+                return mid < maxNs ? mid : maxNs;
+            }
+        }
+        return maxValue.load(std::memory_order_relaxed);
+    }
+
+    // Occupied buckets for printing or export, as [low, high) ns and count.
+    template <typename F>
+    void forEachBucket(F f) const {
+        for (int i = 0; i < BUCKETS; ++i) {
+            uint64_t c = buckets[i].load(std::memory_order_relaxed);
+            if (c) f(bucketLow(i), bucketLow(i + 1), c);
+        }
+    }
+
+private:
+    static int bucketOf(uint64_t v) {
+        if (v < SUB_BUCKETS) return static_cast<int>(v);
+        if (v >> MAX_BITS) v = (uint64_t(1) << MAX_BITS) - 1;
+        int msb = 63 - count_leading_zeros(v);
+        int shift = msb - SUB_BITS;
+        return (msb - SUB_BITS + 1) * SUB_BUCKETS + static_cast<int>((v >> shift) & (SUB_BUCKETS - 1));
+    }
+
+    static uint64_t bucketLow(int index) {
+        if (index < SUB_BUCKETS) return static_cast<uint64_t>(index);
+        int msb = index / SUB_BUCKETS + SUB_BITS - 1;
+        uint64_t sub = static_cast<uint64_t>(index % SUB_BUCKETS);
+        return (uint64_t(SUB_BUCKETS) + sub) << (msb - SUB_BITS);
+    }
+
+    static int count_leading_zeros(uint64_t v) {
+#if defined(_MSC_VER)
+        unsigned long index;
+        _BitScanReverse64(&index, v);
+        return 63 - static_cast<int>(index);
+#else
+        return __builtin_clzll(v);
+#endif
+    }
+
+    std::atomic<uint64_t> buckets[BUCKETS];
+    std::atomic<uint64_t> sum;
+    std::atomic<uint64_t> maxValue;
+};
+
+// Age of a sample at each stage, from the frame's SOC/FRACSEC:
+//   parse   decoded on the ingest thread (or inserted into the concentrator)
+//   insert  moved from the ingest queue into the plotted history
+//   paint   first painted by the main plot
+struct PipelineLatency {
+    LatencyHistogram parse;
+    LatencyHistogram insert;
+    LatencyHistogram paint;
+
+    void reset() {
+        parse.reset();
+        insert.reset();
+        paint.reset();
+    }
+};
+
+#endif // LATENCY_HISTOGRAM_H
@@ -0,0 +1,89 @@
+#ifndef M4_DECIMATOR_H
+#define M4_DECIMATOR_H
+
+// Pixel-aware min/max (M4) decimation for line plots.
+//
+// A polyline drawn into a plot W pixels wide can show at most W distinct
+// columns. For every column M4Decimator keeps the first, minimum, maximum and
+// last sample that falls into it, in x order, which rasterizes to the same
+// pixels as the full series: every peak and the line entering and leaving
+// each column survive. The output is therefore at most 4*W points whatever
+// the number of samples in the window.
+//
+// Samples are pushed in ascending x with add(); emit(x, y) is called for the
+// kept points of a column as soon as the input moves past it, so the
+// decimated series is built in one streaming pass without a copy of the raw
+// window.
+
+#include <cmath>
+#include <cstddef>
+
+class M4Decimator
+{
+public:
+    // The plot spans [x0, x1] over `columns` pixels.
+    M4Decimator(double x0, double x1, int columns)
+        : origin(x0), columnCount(columns > 0 ? columns : 1) {
+        scale = (x1 > x0) ? columnCount / (x1 - x0) : 0.0;
+    }
+
+    template <typename Emit>
+    void add(double x, double y, Emit&& emit) {
+        long column = columnOf(x);
+        if (count > 0 && column != current) flush(emit);
+        if (count == 0) {
+            current = column;
+            first = minPt = maxPt = last = {x, y};
+        }
+        else {
+            if (y < minPt.y) minPt = {x, y};
+            if (y > maxPt.y) maxPt = {x, y};
+            last = {x, y};
+        }
+        ++count;
+    }
+
+    // Emits the last column; call once after the final add().
+    template <typename Emit>
+    void finish(Emit&& emit) {
+        if (count > 0) flush(emit);
+    }
+
+    // Upper bound on the points emitted for one window.
+    size_t maxPoints() const { return 4 * static_cast<size_t>(columnCount); }
+
+private:
+    struct Point {
+        double x;
+        double y;
+    };
+
+    long columnOf(double x) const {
+        double c = std::floor((x - origin) * scale);
+        if (c < 0) return 0;
+        if (c >= columnCount) return columnCount - 1;
+        return static_cast<long>(c);
+    }
+
+    template <typename Emit>
+    void flush(Emit& emit) {
+        // first <= min/max (in the order they occurred) <= last along x; a
+        // sample that is several of them at once is emitted once.
+        bool minFirst = minPt.x <= maxPt.x;
+        const Point kept[4] = {first, minFirst ? minPt : maxPt, minFirst ? maxPt : minPt, last};
+        emit(kept[0].x, kept[0].y);
+        for (int i = 1; i < 4; ++i) {
+            if (kept[i].x != kept[i - 1].x) emit(kept[i].x, kept[i].y);
+        }
+        count = 0;
+    }
+
+    double origin;
+    double scale;
+    long columnCount;
+    long current = 0;
+    size_t count = 0;  // Samples in the current column
+    Point first{}, minPt{}, maxPt{}, last{};
+};
+
+#endif // M4_DECIMATOR_H
@@ -1,11 +1,59 @@
 #include "mainwindow.h"
 
 #include <QApplication>
+#include <QCommandLineParser>
+#include <QDebug>
 
 int main(int argc, char *argv[])
 {
     QApplication a(argc, argv);
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption retentionOption("retention", "Seconds of history kept for scrolling back, 0 = no limit (default 3600).", "seconds");
+    QCommandLineOption memoryOption("max-history-mb", "Memory cap of the history in MB, 0 = no cap (default 256).", "MB");
+    QCommandLineOption fpsOption("fps", "Plot redraws per second, 10-60 (default: screen refresh rate).", "hz");
+    parser.addOption(retentionOption);
+    parser.addOption(memoryOption);
+    QCommandLineOption archiveOption("archive", "Directory to keep the full history in, on disk (default: memory only).", "dir");
+    parser.addOption(archiveOption);
+    QCommandLineOption rendererOption("renderer", "Plot renderer: charts (QtCharts) or raster (default charts).", "name");
+    parser.addOption(fpsOption);
+    parser.addOption(rendererOption);
+    QCommandLineOption pmuOption("pmu", "PMU or PDC to read, host:port; repeat to concentrate several (default localhost:4712).", "address");
+    QCommandLineOption concentrateOption("concentrate", "Time-align the PMU streams into one, also with a single --pmu (implied by several).");
+    QCommandLineOption waitOption("wait-ms", QString("How long the concentrator waits for late PMUs (default %1).").arg(Concentrator::DEFAULT_WAIT_MS), "ms");
+    parser.addOption(pmuOption);
+    parser.addOption(concentrateOption);
+    parser.addOption(waitOption);
+    QCommandLineOption perfOption("perf", "Show the performance overlay (frame rate, parse and render cost, memory) in the status bar.");
+    parser.addOption(perfOption);
+    parser.process(a);
+
+    QStringList sources = parser.values(pmuOption);
+    if(sources.isEmpty()) sources << "localhost:4712";
+    for(const QString &source : sources) {
+        QString host;
+        quint16 port = 0;
+        if(!IngestWorker::parseEndpoint(source, host, port)) {
+            qCritical() << "Invalid PMU address" << source << "(expected host:port)";
+            return 1;
+        }
+    }
+    int waitMs = Concentrator::DEFAULT_WAIT_MS;
+    if(parser.isSet(waitOption)) waitMs = qMax(1, parser.value(waitOption).toInt());
+
+    Retention retention;
+    if(parser.isSet(retentionOption)) retention.seconds = parser.value(retentionOption).toDouble();
+    if(parser.isSet(memoryOption)) retention.maxBytes = static_cast<size_t>(parser.value(memoryOption).toULongLong()) << 20;
+
     MainWindow w;
+    w.setRetention(retention);
+    if(parser.isSet(archiveOption)) w.setArchiveDir(parser.value(archiveOption));
+    if(parser.isSet(fpsOption)) w.setRenderRate(parser.value(fpsOption).toInt());
+    if(parser.value(rendererOption) == "raster") w.setRasterPlots(true);
+    if(parser.isSet(perfOption)) w.setPerfOverlay(true);
+    w.connectPmus(sources, parser.isSet(concentrateOption) || sources.size() > 1, waitMs);
     w.show();
     return a.exec();
 }
@@ -7,36 +7,103 @@
 #include <QInputDialog>
 #include <QDebug>
 #include <QSplitter>
+#include <QToolButton>
+#include <QStatusBar>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QFileInfo>
+#include <QGuiApplication>
+#include <QScreen>
 
-// -------- SplitPlotWidget Implementation --------
-SplitPlotWidget::SplitPlotWidget(int variableIndex, QString variableName, QString unit, QColor color, QWidget *parent)
+#include <cmath>
+
+#include "m4_decimator.h"
+
+// Dashboard panes beside the main plot; 16 channels on screen in all.
+static const int MAX_DASHBOARD_PANES = 15;
+
+// Horizontal pixels of a chart's plot area, the resolution series are
+// decimated to.
+static int plot_columns(const QChart *chart, const QChartView *view)
+{
+    int width = static_cast<int>(chart->plotArea().width());
+    return width > 0 ? width : qMax(1, view->width());
+}
+
+void PaneChartView::paintEvent(QPaintEvent *event)
+{
+    QElapsedTimer timer;
+    timer.start();
+    QChartView::paintEvent(event);
+    paintMicros = timer.nsecsElapsed() / 1000.0;
+    emit painted();
+}
+
+// -------- PlotPane Implementation --------
+PlotPane::PlotPane(const QString &chartTitle, bool closable, QWidget *parent)
     : QWidget(parent)
 {
     QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->setContentsMargins(0, 0, 0, 0);
+    if(closable) {
+        QHBoxLayout *header = new QHBoxLayout();
+        nameLabel = new QLabel();
+        QToolButton *closeButton = new QToolButton();
+        closeButton->setText("x");
+        closeButton->setAutoRaise(true);
+        connect(closeButton, &QToolButton::clicked, this, [this]() { emit closeRequested(this); });
+        header->addWidget(nameLabel, 1);
+        header->addWidget(closeButton);
+        layout->addLayout(header);
+    }
     series = new QSplineSeries();
-    series->setColor(color);
     chart = new QChart();
     chart->addSeries(series);
     chart->createDefaultAxes();
     chart->legend()->hide();
-    chart->setTitle("Real-Time PMU Data Visualization");
+    chart->setTitle(chartTitle);
     QList<QAbstractAxis*> axesX = chart->axes(Qt::Horizontal);
     if (!axesX.isEmpty()) axesX.first()->setTitleText("Time (s)");
-    QList<QAbstractAxis*> axesY = chart->axes(Qt::Vertical);
-    if (!axesY.isEmpty()) axesY.first()->setTitleText(unit);
-    chartView = new QChartView(chart);
+    chartView = new PaneChartView(chart);
     chartView->setRenderHint(QPainter::Antialiasing);
-    chartView->setMinimumHeight(300);
-    layout->addWidget(new QLabel(variableName));
+    plotWidget = new PlotWidget();
+    plotWidget->setVisible(false);
+    connect(chartView, &PaneChartView::painted, this, &PlotPane::painted);
+    connect(plotWidget, &PlotWidget::painted, this, &PlotPane::painted);
     layout->addWidget(chartView);
+    layout->addWidget(plotWidget);
+}
+
+void PlotPane::setChannel(int channel, const QString &name, const QString &unit, const QColor &color)
+{
+    channelIndex = channel;
+    if(nameLabel) nameLabel->setText(name);
+    series->setColor(color);
+    QList<QAbstractAxis*> axesY = chart->axes(Qt::Vertical);
+    if (!axesY.isEmpty()) axesY.first()->setTitleText(unit);
+    plotWidget->setColor(color);
+    plotWidget->setTitles(chart->title(), "Time (s)", unit);
+}
+
+void PlotPane::setRaster(bool raster)
+{
+    chartView->setVisible(!raster);
+    plotWidget->setVisible(raster);
+    plotWidget->invalidate();
+}
+
+double PlotPane::lastPaintMicros() const
+{
+    return plotWidget->isHidden() ? chartView->lastPaintMicros() : plotWidget->lastPaintMicros();
+}
+
+int PlotPane::plotColumns() const
+{
+    return plot_columns(chart, chartView);
 }
 
-void SplitPlotWidget::updateData(const QVector<double>& x, const QVector<double>& y)
+void PlotPane::updateData(const PlotWindow &window, double minY, double maxY)
 {
-    QVector<QPointF> points;
-    int N = qMin(x.size(), y.size());
-    for(int i = 0; i < N; ++i)
-        points.append(QPointF(x[i], y[i]));
     series->replace(points);
 
     // Axis handling
@@ -44,12 +111,7 @@ void SplitPlotWidget::updateData(const QVector<double>& x, const QVector<double>
     QList<QAbstractAxis*> axesY = chart->axes(Qt::Vertical);
     if(!points.isEmpty()) {
         if (!axesX.isEmpty())
-            axesX.first()->setRange(points.first().x(), points.last().x());
-        double minY = points.first().y(), maxY = points.first().y();
-        for(const QPointF &pt : points) {
-            if(pt.y() < minY) minY = pt.y();
-            if(pt.y() > maxY) maxY = pt.y();
-        }
+            axesX.first()->setRange(window.x0, window.x1);
         double yPad = (maxY - minY) * 0.1;
         if(yPad == 0) yPad = 1.0;
         if (!axesY.isEmpty())
@@ -60,36 +122,42 @@ void SplitPlotWidget::updateData(const QVector<double>& x, const QVector<double>
 // -------- MainWindow Implementation --------
 
 QString MainWindow::getYAxisUnit(int variableIndex) {
-    if(variableIndex == 0 || variableIndex == 3 || variableIndex == 6) return "Volts";
-    if(variableIndex == 1 || variableIndex == 4 || variableIndex == 7) return "rad";
-    if(variableIndex == 2 || variableIndex == 5 || variableIndex == 8) return "deg";
-    if(variableIndex == 9) return "Hz";
-    if(variableIndex == 10) return "Hz/s";
-    if(variableIndex >= 11 && variableIndex <= 14) return "a.u.";
+    if(variableIndex >= 0 && variableIndex < channelUnits.size()) return channelUnits[variableIndex];
     return "";
 }
 
 QString MainWindow::variableLabel(int idx) const {
-    switch(idx) {
-    case 0: return "Phase 1 Magnitude";
-    case 1: return "Phase 1 Angle (rad)";
-    case 2: return "Phase 1 Angle (deg)";
-    case 3: return "Phase 2 Magnitude";
-    case 4: return "Phase 2 Angle (rad)";
-    case 5: return "Phase 2 Angle (deg)";
-    case 6: return "Phase 3 Magnitude";
-    case 7: return "Phase 3 Angle (rad)";
-    case 8: return "Phase 3 Angle (deg)";
-    case 9: return "Frequency";
-    case 10: return "ROCOF";
-    case 11: return "Analog 1";
-    case 12: return "Analog 2";
-    case 13: return "Analog 3";
-    case 14: return "Analog 4";
-    default: return "Var";
+    if(idx >= 0 && idx < channelNames.size()) return channelNames[idx];
+    return "Var";
+}
+
+// Channels of the default 3-phasor, 4-analog PMU until a CFG-2 arrives.
+void MainWindow::setDefaultChannels()
+{
+    channelNames.clear();
+    channelUnits.clear();
+    for(int phase = 1; phase <= 3; ++phase) {
+        channelNames << QString("Phase %1 Magnitude").arg(phase) << QString("Phase %1 Angle (rad)").arg(phase)
+                     << QString("Phase %1 Angle (deg)").arg(phase);
+        channelUnits << "Volts" << "rad" << "deg";
+    }
+    channelNames << "Frequency" << "ROCOF";
+    channelUnits << "Hz" << "Hz/s";
+    for(int analog = 1; analog <= 4; ++analog) {
+        channelNames << QString("Analog %1").arg(analog);
+        channelUnits << "a.u.";
     }
 }
 
+void MainWindow::populateVariableCombo()
+{
+    variableCombo->blockSignals(true);
+    variableCombo->clear();
+    variableCombo->addItems(channelNames);
+    variableCombo->setCurrentIndex(currentVariable);
+    variableCombo->blockSignals(false);
+}
+
 QColor MainWindow::variableColor(int idx) const {
     static const QVector<QColor> colors = {
         Qt::red, Qt::blue, Qt::darkGreen, Qt::magenta, Qt::darkCyan, Qt::darkYellow, Qt::darkRed,
@@ -101,16 +169,56 @@ QColor MainWindow::variableColor(int idx) const {
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
 {
+    setDefaultChannels();
     setupUI();
-    dataBuffers.resize(15);
-    for(auto& buffer : dataBuffers) buffer.reserve(10000);
-    timeBuffer.reserve(10000);
+    resetHistory(std::vector<bool>(channelNames.size(), false));
+
+    renderTimer = new QTimer(this);
+    renderTimer->setTimerType(Qt::PreciseTimer);
+    connect(renderTimer, &QTimer::timeout, this, &MainWindow::onRenderTick);
+    QScreen *screen = QGuiApplication::primaryScreen();
+    setRenderRate(screen ? qRound(screen->refreshRate()) : 30);
 
-    socket = new QTcpSocket(this);
-    connect(socket, &QTcpSocket::readyRead, this, &MainWindow::onReadyRead);
+    perfTimer = new QTimer(this);
+    connect(perfTimer, &QTimer::timeout, this, &MainWindow::updatePerfOverlay);
+}
 
-    // Auto-connect on startup
-    socket->connectToHost("localhost", 4712);
+MainWindow::~MainWindow()
+{
+    if(!ingestThread) return;
+    ingestThread->quit();
+    ingestThread->wait();
+}
+
+// Starts ingest on its own thread: one IngestWorker for a single source, or a
+// Concentrator that time-aligns the PMU streams of all of them.
+void MainWindow::connectPmus(const QStringList &sources, bool concentrate, int waitMs)
+{
+    if(ingestThread || sources.isEmpty()) return;
+    ingestThread = new QThread(this);
+    if(concentrate) {
+        Concentrator *concentrator = new Concentrator(sources, waitMs);
+        concentrator->setLatency(latency);
+        concentrator->setCounters(ingestCounters);
+        concentrator->moveToThread(ingestThread);
+        connect(ingestThread, &QThread::started, concentrator, &Concentrator::start);
+        connect(ingestThread, &QThread::finished, concentrator, &QObject::deleteLater);
+        connect(concentrator, &Concentrator::configReceived, this, &MainWindow::onConfigReceived);
+        connect(concentrator, &Concentrator::statusChanged, concentratorLabel, &QLabel::setText);
+    }
+    else {
+        QString host;
+        quint16 port = 0;
+        IngestWorker::parseEndpoint(sources.first(), host, port);
+        IngestWorker *ingest = new IngestWorker(host, port);
+        ingest->setLatency(latency);
+        ingest->setCounters(ingestCounters);
+        ingest->moveToThread(ingestThread);
+        connect(ingestThread, &QThread::started, ingest, &IngestWorker::start);
+        connect(ingestThread, &QThread::finished, ingest, &QObject::deleteLater);
+        connect(ingest, &IngestWorker::configReceived, this, &MainWindow::onConfigReceived);
+    }
+    ingestThread->start();
 }
 
 void MainWindow::setupUI()
@@ -123,15 +231,7 @@ void MainWindow::setupUI()
 
     controlsLayout->addWidget(new QLabel("Select Variable:"));
     variableCombo = new QComboBox();
-    for(int phase = 1; phase <= 3; ++phase) {
-        variableCombo->addItem(QString("Phase %1 Magnitude").arg(phase));
-        variableCombo->addItem(QString("Phase %1 Angle (rad)").arg(phase));
-        variableCombo->addItem(QString("Phase %1 Angle (deg)").arg(phase));
-    }
-    variableCombo->addItem("Frequency");
-    variableCombo->addItem("ROCOF");
-    for(int analog = 1; analog <= 4; ++analog)
-        variableCombo->addItem(QString("Analog %1").arg(analog));
+    populateVariableCombo();
     connect(variableCombo, QOverload<int>::of(&QComboBox::currentIndexChanged),
             this, &MainWindow::onComboChanged);
     controlsLayout->addWidget(variableCombo);
@@ -150,48 +250,51 @@ void MainWindow::setupUI()
 
     controlsLayout->addSpacing(15);
 
-    splitViewButton = new QPushButton("Split View");
-    closeSplitButton = new QPushButton("Close Split");
-    connect(splitViewButton, &QPushButton::clicked, this, &MainWindow::onSplitViewClicked);
-    connect(closeSplitButton, &QPushButton::clicked, this, &MainWindow::onCloseSplitView);
-    controlsLayout->addWidget(splitViewButton);
-    controlsLayout->addWidget(closeSplitButton);
-    closeSplitButton->setVisible(false);
+    addPaneButton = new QPushButton("Add Pane");
+    allChannelsButton = new QPushButton("All Channels");
+    closePanesButton = new QPushButton("Close Panes");
+    connect(addPaneButton, &QPushButton::clicked, this, &MainWindow::onAddPaneClicked);
+    connect(allChannelsButton, &QPushButton::clicked, this, &MainWindow::onAllChannelsClicked);
+    connect(closePanesButton, &QPushButton::clicked, this, &MainWindow::onClosePanes);
+    controlsLayout->addWidget(addPaneButton);
+    controlsLayout->addWidget(allChannelsButton);
+    controlsLayout->addWidget(closePanesButton);
+    closePanesButton->setVisible(false);
+
+    controlsLayout->addSpacing(15);
+
+    controlsLayout->addWidget(new QLabel("Renderer:"));
+    rendererCombo = new QComboBox();
+    rendererCombo->addItems(QStringList() << "QtCharts" << "Raster");
+    connect(rendererCombo, QOverload<int>::of(&QComboBox::currentIndexChanged),
+            this, &MainWindow::onRendererChanged);
+    controlsLayout->addWidget(rendererCombo);
 
     mainLayout->addLayout(controlsLayout);
 
     // Splitter for plots
     splitter = new QSplitter(Qt::Horizontal);
-    mainPlotWidget = new QWidget();
-    QVBoxLayout *mainPlotLayout = new QVBoxLayout(mainPlotWidget);
 
     // Main plot setup
-    series = new QSplineSeries();
-    series->setColor(variableColor(0));
-    chart = new QChart();
-    chart->addSeries(series);
-    chart->createDefaultAxes();
-    chart->legend()->hide();
-    chart->setTitle("Real-Time PMU Data Visualization");
-    QList<QAbstractAxis*> axesX = chart->axes(Qt::Horizontal);
-    if (!axesX.isEmpty())
-        axesX.first()->setTitleText("Time (s)");
-    QList<QAbstractAxis*> axesY = chart->axes(Qt::Vertical);
-    if (!axesY.isEmpty())
-        axesY.first()->setTitleText(getYAxisUnit(0));
-    chartView = new QChartView(chart);
-    chartView->setRenderHint(QPainter::Antialiasing);
-    chartView->setMinimumHeight(350);
-    mainPlotLayout->addWidget(chartView);
-    mainPlotWidget->setLayout(mainPlotLayout);
-
-    splitter->addWidget(mainPlotWidget);
+    mainPane = new PlotPane("Real-Time PMU Data Visualization", false);
+    mainPane->setChannel(0, variableLabel(0), getYAxisUnit(0), variableColor(0));
+    mainPane->setMinimumHeight(350);
+    attachSources(mainPane);
+    connect(mainPane, &PlotPane::painted, this, &MainWindow::onMainPanePainted);
+    splitter->addWidget(mainPane);
+
+    // Dashboard grid, hidden while it has no panes
+    paneGrid = new QWidget();
+    paneLayout = new QGridLayout(paneGrid);
+    paneLayout->setContentsMargins(0, 0, 0, 0);
+    paneGrid->setVisible(false);
+    splitter->addWidget(paneGrid);
     mainLayout->addWidget(splitter);
 
     // Scrollbar
     QHBoxLayout *scrollLayout = new QHBoxLayout();
     hScrollBar = new QScrollBar(Qt::Horizontal);
-    int maxPoints = static_cast<int>(windowSizeSec / 0.02);
+    int maxPoints = static_cast<int>(windowSizeSec / samplePeriod);
     hScrollBar->setRange(0, 0);
     hScrollBar->setPageStep(maxPoints);
     connect(hScrollBar, &QScrollBar::valueChanged, this, &MainWindow::onScrollBarChanged);
@@ -204,156 +307,563 @@ void MainWindow::setupUI()
     mainLayout->addLayout(scrollLayout);
 
     setCentralWidget(central);
+
+    concentratorLabel = new QLabel();
+    statusBar()->addWidget(concentratorLabel);
+    queueLabel = new QLabel();
+    statusBar()->addPermanentWidget(queueLabel);
+    updateQueueStatus();
+    perfLabel = new QLabel();
+    perfLabel->setVisible(false);
+    statusBar()->addPermanentWidget(perfLabel);
+    perfButton = new QToolButton();
+    perfButton->setText("Perf");
+    perfButton->setToolTip("Show ingest rate, parse and render cost and memory use");
+    perfButton->setCheckable(true);
+    perfButton->setAutoRaise(true);
+    connect(perfButton, &QToolButton::toggled, this, &MainWindow::setPerfOverlay);
+    statusBar()->addPermanentWidget(perfButton);
+}
+
+// The worker only reports new or changed configurations. Samples still queued
+// in the previous ring belong to the old channel layout and are dropped.
+void MainWindow::onConfigReceived(const ConfigFrame &cfg, const std::shared_ptr<SampleRing> &ring)
+{
+    ingestRing = ring;
+    applyConfig(cfg);
+}
+
+// The CFG-2 defines the channels; a new or changed one restarts the plot.
+void MainWindow::applyConfig(const ConfigFrame &cfg)
+{
+    channelNames.clear();
+    channelUnits.clear();
+    std::vector<bool> floatColumns;
+    for(const ChannelInfo &channel : decoded_channels(cfg)) {
+        channelNames << QString::fromStdString(channel.name);
+        channelUnits << QString::fromStdString(channel.unit);
+        floatColumns.push_back(channel.float32);
+    }
+    if(cfg.framePeriod() > 0) samplePeriod = cfg.framePeriod();
+
+    onClosePanes();
+    layoutKnown = true;
+    resetHistory(floatColumns);
+
+    if(currentVariable >= channelNames.size()) currentVariable = 0;
+    populateVariableCombo();
+    onComboChanged(currentVariable);
+}
+
+void MainWindow::setRetention(const Retention &newRetention)
+{
+    retention = newRetention;
+    resetHistory(historyColumns);
+}
+
+// Archives history under dir. The most recent archive there is shown right
+// away, before the PMU has sent its configuration.
+void MainWindow::setArchiveDir(const QString &dir)
+{
+    archiveRoot = dir;
+    if(!layoutKnown && loadLatestArchiveLayout()) return;
+    resetHistory(historyColumns);
+}
+
+// Channel layout as stored next to an archive; its hash names the archive.
+QByteArray MainWindow::archiveLayout() const
+{
+    QByteArray layout = "period " + QByteArray::number(samplePeriod, 'g', 17) + "\n";
+    for(int i = 0; i < channelNames.size(); ++i) {
+        bool isFloat = i < static_cast<int>(historyColumns.size()) && historyColumns[i];
+        layout += (isFloat ? "f32\t" : "f64\t") + channelUnits.value(i).toUtf8() + "\t" + channelNames[i].toUtf8() + "\n";
+    }
+    return layout;
+}
+
+// Opens (or starts) the archive for the current layout. The plots then read
+// it instead of the in-memory history, continuing its time axis.
+void MainWindow::openArchive()
+{
+    archive.close();
+    if(archiveRoot.isEmpty() || !layoutKnown) return;
+
+    QByteArray layout = archiveLayout();
+    QString key = QString::fromLatin1(QCryptographicHash::hash(layout, QCryptographicHash::Md5).toHex().left(16));
+    QString dir = QDir(archiveRoot).filePath(key);
+    if(!archive.open(dir, historyColumns)) {
+        qWarning() << "Cannot open history archive" << dir << "- keeping history in memory only";
+        return;
+    }
+    QFile layoutFile(QDir(dir).filePath("layout"));
+    if(!layoutFile.exists() && layoutFile.open(QIODevice::WriteOnly)) layoutFile.write(layout);
+    if(!archive.empty()) timeOrigin = archive.origin();
+}
+
+// Takes the channels of the most recently written archive.
+bool MainWindow::loadLatestArchiveLayout()
+{
+    QString latest;
+    QDateTime latestTime;
+    for(const QFileInfo &entry : QDir(archiveRoot).entryInfoList(QDir::Dirs | QDir::NoDotAndDotDot)) {
+        QFileInfo header(QDir(entry.filePath()).filePath("header"));
+        if(header.exists() && (latest.isEmpty() || header.lastModified() > latestTime)) {
+            latest = entry.filePath();
+            latestTime = header.lastModified();
+        }
+    }
+    QFile layoutFile(QDir(latest).filePath("layout"));
+    if(latest.isEmpty() || !layoutFile.open(QIODevice::ReadOnly)) return false;
+
+    QStringList names, units;
+    std::vector<bool> floatColumns;
+    double period = 0.0;
+    for(const QByteArray &line : layoutFile.readAll().split('\n')) {
+        if(line.startsWith("period ")) {
+            period = line.mid(7).toDouble();
+            continue;
+        }
+        QList<QByteArray> fields = line.split('\t');
+        if(fields.size() != 3) continue;
+        floatColumns.push_back(fields[0] == "f32");
+        units << QString::fromUtf8(fields[1]);
+        names << QString::fromUtf8(fields[2]);
+    }
+    if(names.isEmpty() || period <= 0) return false;
+
+    channelNames = names;
+    channelUnits = units;
+    samplePeriod = period;
+    layoutKnown = true;
+    resetHistory(floatColumns);
+    if(currentVariable >= channelNames.size()) currentVariable = 0;
+    populateVariableCombo();
+    onComboChanged(currentVariable);
+    return true;
+}
+
+// Sizes the history for the current channels, sample rate and retention.
+void MainWindow::resetHistory(const std::vector<bool> &floatColumns)
+{
+    historyColumns = floatColumns;
+    history.configure(historyColumns, samplePeriod, retention);
+    timeOrigin = -1.0;
+    paintedEnd = shownEnd = UNTRACKED;
+    openArchive();
+    scrollBase = history.firstIndex();
+    resetLiveExtrema();
+    hScrollBar->setRange(0, 0);
+    updateScrollRange();
+    mainPane->rasterPlot()->invalidate();
+    for(PlotPane *pane : panes) pane->rasterPlot()->invalidate();
+    plotDirty = panesDirty = true;
+}
+
+// Switches all panes between QChartView and the raster PlotWidget.
+void MainWindow::setRasterPlots(bool raster)
+{
+    rasterPlots = raster;
+    rendererCombo->blockSignals(true);
+    rendererCombo->setCurrentIndex(raster ? 1 : 0);
+    rendererCombo->blockSignals(false);
+    mainPane->setRaster(raster);
+    for(PlotPane *pane : panes) pane->setRaster(raster);
+    plotDirty = panesDirty = true;
 }
 
-void MainWindow::onReadyRead()
+void MainWindow::onRendererChanged(int index)
 {
-    while(socket->canReadLine()) {
-        QByteArray line = socket->readLine().trimmed();
-        QList<QByteArray> values = line.split(',');
+    setRasterPlots(index == 1);
+}
 
-        if(values.size() != 15) continue;
+// Redraws happen at most hz times a second (10-60), whatever the frame rate.
+void MainWindow::setRenderRate(int hz)
+{
+    hz = qBound(10, hz, 60);
+    renderTimer->start(1000 / hz);
+}
 
-        timeBuffer.append(timeBuffer.size());
-        for(int i = 0; i < 15; ++i) {
-            bool ok;
-            double value = values[i].toDouble(&ok);
-            if(ok) dataBuffers[i].append(value);
+// The scrollbar spans the retained history in samples, one page per window.
+void MainWindow::updateScrollRange()
+{
+    int dataSize = static_cast<int>(withHistory([](const auto &store) { return store.size(); }));
+    int maxPoints = static_cast<int>(windowSizeSec / samplePeriod);
+    hScrollBar->setRange(0, qMax(0, dataSize - maxPoints));
+    hScrollBar->setPageStep(maxPoints);
+    if(autoScrollEnabled && dataSize > maxPoints)
+        hScrollBar->setValue(dataSize - maxPoints);
+}
+
+// Moves the samples the ingest thread queued since the last tick into the
+// history. Returns true if there were any.
+bool MainWindow::drainIngest()
+{
+    if(!ingestRing || ingestRing->channelCount() != history.channelCount()) return false;
+    if(paintedEnd == UNTRACKED) paintedEnd = shownEnd = historyEnd();
+    int64_t now = wall_clock_ns();
+    size_t n = ingestRing->drain([this, now](double time, const double *values) {
+        latency->insert.record(now - static_cast<int64_t>(time * 1e9));
+        if(timeOrigin < 0) {
+            timeOrigin = time;
+            if(archive.isOpen()) archive.setOrigin(time);
+        }
+        if(archive.isOpen() && !archive.append(time - timeOrigin, values)) {
+            qWarning() << "History archive full, keeping history in memory only";
+            archive.close();
+            resetLiveExtrema();
         }
+        if(!archive.isOpen()) history.append(time - timeOrigin, values);
+        // Fed the stored value, so float32 channels agree with the history.
+        withHistory([this](const auto &store) {
+            for(size_t c = 0; c < liveExtrema.size(); ++c)
+                liveExtrema[c].push(store.value(c, store.size() - 1));
+        });
+    });
+    return n > 0;
+}
+
+// Absolute index one past the newest stored sample.
+uint64_t MainWindow::historyEnd() const
+{
+    return withHistory([](const auto &store) { return store.firstIndex() + store.size(); });
+}
+
+// Samples handed to the main pane since its last paint are now on screen.
+void MainWindow::onMainPanePainted()
+{
+    paintTime.record(static_cast<int64_t>(mainPane->lastPaintMicros() * 1000.0));
+    if(paintedEnd == UNTRACKED || shownEnd <= paintedEnd) return;
+    int64_t now = wall_clock_ns();
+    withHistory([this, now](const auto &store) {
+        uint64_t first = store.firstIndex();
+        for(uint64_t i = qMax(paintedEnd, first); i < shownEnd; ++i)
+            latency->paint.record(now - static_cast<int64_t>((timeOrigin + store.time(i - first)) * 1e9));
+    });
+    paintedEnd = shownEnd;
+}
+
+void MainWindow::setPerfOverlay(bool on)
+{
+    perfButton->blockSignals(true);
+    perfButton->setChecked(on);
+    perfButton->blockSignals(false);
+    perfLabel->setVisible(on);
+    if(!on) {
+        perfTimer->stop();
+        return;
+    }
+    perfFrames = ingestCounters->frames.load(std::memory_order_relaxed);
+    perfBytes = ingestCounters->bytes.load(std::memory_order_relaxed);
+    ingestCounters->batchParse.reset();
+    updateTime.reset();
+    paintTime.reset();
+    perfClock.start();
+    perfLabel->setText("Measuring...");
+    perfTimer->start(1000);
+}
 
-        int dataSize = timeBuffer.size();
-        int maxPoints = static_cast<int>(windowSizeSec / 0.02);
-        hScrollBar->setRange(0, qMax(0, dataSize - maxPoints));
-        hScrollBar->setPageStep(maxPoints);
+// Rates since the last refresh, mean/p99 of the costs recorded meanwhile.
+void MainWindow::updatePerfOverlay()
+{
+    double seconds = qMax(1e-3, perfClock.restart() / 1000.0);
+    uint64_t frames = ingestCounters->frames.load(std::memory_order_relaxed);
+    uint64_t bytes = ingestCounters->bytes.load(std::memory_order_relaxed);
+    double frameRate = (frames - perfFrames) / seconds;
+    double kbRate = (bytes - perfBytes) / seconds / 1024.0;
+    perfFrames = frames;
+    perfBytes = bytes;
+
+    const LatencyHistogram &parse = ingestCounters->batchParse;
+    size_t historyBytes = archive.isOpen() ? archive.mappedBytes() : history.memoryBytes();
+    perfLabel->setText(QString("%1 frames/s (%2 KB/s)  Malformed: %3  Parse: %4/%5 us per read  "
+                               "Update: %6/%7 ms  Paint: %8/%9 ms  Queue: %10  History: %11 MB%12")
+                       .arg(frameRate, 0, 'f', 0)
+                       .arg(kbRate, 0, 'f', 0)
+                       .arg(ingestCounters->malformed.load(std::memory_order_relaxed))
+                       .arg(parse.meanNs() / 1e3, 0, 'f', 1)
+                       .arg(parse.quantileNs(0.99) / 1e3, 0, 'f', 1)
+                       .arg(updateTime.meanNs() / 1e6, 0, 'f', 2)
+                       .arg(updateTime.quantileNs(0.99) / 1e6, 0, 'f', 2)
+                       .arg(paintTime.meanNs() / 1e6, 0, 'f', 2)
+                       .arg(paintTime.quantileNs(0.99) / 1e6, 0, 'f', 2)
+                       .arg(ingestRing ? ingestRing->depth() : 0)
+                       .arg(historyBytes / 1048576.0, 0, 'f', 1)
+                       .arg(archive.isOpen() ? " mapped" : ""));
+    ingestCounters->batchParse.reset();
+    updateTime.reset();
+    paintTime.reset();
+}
 
-        if(autoScrollEnabled && dataSize > maxPoints)
-            hScrollBar->setValue(dataSize - maxPoints);
+void MainWindow::updateQueueStatus()
+{
+    size_t depth = ingestRing ? ingestRing->depth() : 0;
+    size_t capacity = ingestRing ? ingestRing->capacity() : 0;
+    quint64 dropped = ingestRing ? ingestRing->droppedSamples() : 0;
+    queueLabel->setText(QString("Ingest queue: %1/%2  Dropped: %3").arg(depth).arg(capacity).arg(dropped));
+}
 
-        updatePlot();
-        updateSplitPlot();
+// Display tick: moves queued samples into the history, catches the scrollbar
+// up with it and redraws each dirty pane once, however many frames arrived
+// since the last tick.
+void MainWindow::onRenderTick()
+{
+    bool arrived = drainIngest();
+    updateQueueStatus();
+    if(arrived) {
+        // Scroll positions index the retained history; keep a scrolled-back
+        // view on the same samples when the oldest chunk is recycled.
+        uint64_t firstIndex = withHistory([](const auto &store) { return store.firstIndex(); });
+        int recycled = static_cast<int>(firstIndex - scrollBase);
+        scrollBase = firstIndex;
+        int scrollPos = hScrollBar->value();
+        hScrollBar->blockSignals(true);
+        updateScrollRange();
+        if(!autoScrollEnabled && recycled > 0)
+            hScrollBar->setValue(qMax(0, scrollPos - recycled));
+        hScrollBar->blockSignals(false);
+        plotDirty = panesDirty = true;
     }
+    if(isMinimized()) return;  // Panes stay dirty until they are visible again
+    if(!plotDirty && !panesDirty) return;
+
+    // One window for all panes; each pane only adds its channel's samples.
+    PlotWindow window;
+    if(currentWindow(window)) {
+        QElapsedTimer timer;
+        timer.start();
+        if(plotDirty) {
+            updatePane(mainPane, window);
+            if(shownEnd != UNTRACKED) {
+                uint64_t end = withHistory([](const auto &store) { return store.firstIndex(); }) + window.end;
+                shownEnd = qMax(shownEnd, end);
+            }
+        }
+        if(panesDirty) {
+            for(PlotPane *pane : panes) updatePane(pane, window);
+        }
+        updateTime.record(timer.nsecsElapsed());
+    }
+    plotDirty = panesDirty = false;
 }
 
 void MainWindow::onComboChanged(int index)
 {
     currentVariable = index;
-    series->setColor(variableColor(index));
-    QList<QAbstractAxis*> axesY = chart->axes(Qt::Vertical);
-    if (!axesY.isEmpty())
-        axesY.first()->setTitleText(getYAxisUnit(index));
-    updatePlot();
+    mainPane->setChannel(index, variableLabel(index), getYAxisUnit(index), variableColor(index));
+    plotDirty = true;
 }
 
 void MainWindow::onWindowSizeChanged(double newSizeSec)
 {
     windowSizeSec = newSizeSec;
-    int dataSize = timeBuffer.size();
-    int maxPoints = static_cast<int>(windowSizeSec / 0.02);
-    hScrollBar->setRange(0, qMax(0, dataSize - maxPoints));
-    hScrollBar->setPageStep(maxPoints);
-    if(autoScrollEnabled && dataSize > maxPoints)
-        hScrollBar->setValue(dataSize - maxPoints);
-    updatePlot();
-    updateSplitPlot();
+    resetLiveExtrema();
+    hScrollBar->blockSignals(true);
+    updateScrollRange();
+    hScrollBar->blockSignals(false);
+    plotDirty = panesDirty = true;
 }
 
 void MainWindow::onScrollBarChanged(int /*value*/)
 {
-    updatePlot();
-    updateSplitPlot();
+    plotDirty = panesDirty = true;
+}
+
+bool MainWindow::channelShown(int channel) const
+{
+    if(channel == currentVariable) return true;
+    for(const PlotPane *pane : panes) {
+        if(pane->channel() == channel) return true;
+    }
+    return false;
 }
 
-void MainWindow::onSplitViewClicked()
+void MainWindow::onAddPaneClicked()
 {
-    if (splitPlotWidget) return;
+    if (panes.size() >= MAX_DASHBOARD_PANES) return;
 
     QStringList varList;
-    for(int i=0; i<15; ++i) {
-        if(i == currentVariable) continue;
+    QVector<int> varChannels;
+    for(int i=0; i<channelNames.size(); ++i) {
+        if(channelShown(i)) continue;
         varList << variableLabel(i);
+        varChannels << i;
     }
+    if(varList.isEmpty()) return;
     bool ok = false;
-    QString selected = QInputDialog::getItem(this, "Select Variable for Split View",
+    QString selected = QInputDialog::getItem(this, "Select Variable for New Pane",
                                              "Variable:", varList, 0, false, &ok);
     if (!ok || selected.isEmpty()) return;
 
-    int varIdx = -1;
-    for(int i=0, j=0; i<15; ++i) {
-        if(i == currentVariable) continue;
-        if(varList[j] == selected) { varIdx = i; break; }
-        ++j;
+    int selectedIdx = varList.indexOf(selected);
+    if(selectedIdx >= 0) addPane(varChannels[selectedIdx]);
+}
+
+// Fills the dashboard with every channel not on screen yet.
+void MainWindow::onAllChannelsClicked()
+{
+    for(int i=0; i<channelNames.size() && panes.size() < MAX_DASHBOARD_PANES; ++i) {
+        if(!channelShown(i)) addPane(i);
     }
-    if(varIdx < 0) return;
+}
 
-    splitVariable = varIdx;
-    splitPlotWidget = new SplitPlotWidget(varIdx, variableLabel(varIdx), getYAxisUnit(varIdx), variableColor(varIdx));
-    splitter->addWidget(splitPlotWidget);
-    splitter->setSizes(QList<int>() << 1 << 1);
-    closeSplitButton->setVisible(true);
-    updateSplitPlot();
+void MainWindow::onClosePanes()
+{
+    for(PlotPane *pane : panes) pane->deleteLater();
+    panes.clear();
+    layoutPanes();
 }
 
-void MainWindow::onCloseSplitView()
+void MainWindow::onPaneCloseRequested(PlotPane *pane)
 {
-    if (!splitPlotWidget) return;
-    splitter->widget(1)->deleteLater();
-    splitPlotWidget = nullptr;
-    splitVariable = -1;
-    closeSplitButton->setVisible(false);
+    panes.removeOne(pane);
+    pane->deleteLater();
+    layoutPanes();
+    panesDirty = true;
 }
 
-void MainWindow::updatePlot()
+void MainWindow::addPane(int channel)
 {
-    if(dataBuffers[currentVariable].isEmpty()) return;
+    PlotPane *pane = new PlotPane(QString(), true);
+    pane->setChannel(channel, variableLabel(channel), getYAxisUnit(channel), variableColor(channel));
+    pane->setMinimumHeight(150);
+    attachSources(pane);
+    pane->setRaster(rasterPlots);
+    connect(pane, &PlotPane::closeRequested, this, &MainWindow::onPaneCloseRequested);
+    panes.append(pane);
+    layoutPanes();
+    panesDirty = true;
+}
 
-    int scrollPos = hScrollBar->value();
-    int dataSize = timeBuffer.size();
-    int bufferSize = dataBuffers[currentVariable].size();
-    int start = qMax(0, scrollPos);
-    int maxPoints = static_cast<int>(windowSizeSec / 0.02);
-    int end = qMin(qMin(dataSize, bufferSize), start + maxPoints);
+// The raster plots pull their points and Y range for the pane's channel.
+void MainWindow::attachSources(PlotPane *pane)
+{
+    pane->rasterPlot()->setSource([this, pane](double from, double to, int columns, QVector<QPointF> &out) {
+        rangePoints(pane->channel(), from, to, columns, out);
+    });
+    pane->rasterPlot()->setRangeSource([this, pane](double from, double to, double &lo, double &hi) {
+        return rangeExtrema(pane->channel(), from, to, lo, hi);
+    });
+}
 
-    QVector<QPointF> points;
-    points.reserve(maxPoints);
-    for(int i = start; i < end; ++i)
-        points.append(QPointF(timeBuffer[i] * 0.02, dataBuffers[currentVariable][i]));
+// Arranges the dashboard panes in a near-square grid.
+void MainWindow::layoutPanes()
+{
+    bool wasVisible = !paneGrid->isHidden();
+    while(paneLayout->count() > 0) delete paneLayout->takeAt(0);
+    int columns = qMax(1, static_cast<int>(std::ceil(std::sqrt(static_cast<double>(panes.size())))));
+    for(int i = 0; i < panes.size(); ++i)
+        paneLayout->addWidget(panes[i], i / columns, i % columns);
+
+    paneGrid->setVisible(!panes.isEmpty());
+    if(!wasVisible && !panes.isEmpty()) splitter->setSizes(QList<int>() << 1 << 1);
+    closePanesButton->setVisible(!panes.isEmpty());
+    addPaneButton->setEnabled(panes.size() < MAX_DASHBOARD_PANES);
+    allChannelsButton->setEnabled(panes.size() < MAX_DASHBOARD_PANES);
+}
 
-    series->replace(points);
+// Redraws one pane for the shared window.
+void MainWindow::updatePane(PlotPane *pane, const PlotWindow &window)
+{
+    int channel = pane->channel();
+    if(channel < 0 || channel >= static_cast<int>(liveExtrema.size())) return;
 
-    QList<QAbstractAxis*> axesX = chart->axes(Qt::Horizontal);
-    QList<QAbstractAxis*> axesY = chart->axes(Qt::Vertical);
-    if(!points.isEmpty()) {
-        if (!axesX.isEmpty())
-            axesX.first()->setRange(points.first().x(), points.last().x());
-        double minY = points.first().y(), maxY = points.first().y();
-        for(const QPointF &pt : points) {
-            if(pt.y() < minY) minY = pt.y();
-            if(pt.y() > maxY) maxY = pt.y();
-        }
-        double yPad = (maxY - minY) * 0.1;
-        if(yPad == 0) yPad = 1.0;
-        if (!axesY.isEmpty())
-            axesY.first()->setRange(minY - yPad, maxY + yPad);
+    if(rasterPlots) {
+        pane->rasterPlot()->setXRange(window.x0, window.rasterX1);
+        pane->rasterPlot()->refresh();
+        return;
     }
+
+    QVector<QPointF> &points = pane->pointBuffer();
+    samplePoints(channel, window.start, window.end, pane->plotColumns(), points);
+    double minY = 0.0, maxY = 0.0;
+    windowExtrema(channel, window.start, window.end, minY, maxY);
+    pane->updateData(window, minY, maxY);
 }
 
-void MainWindow::updateSplitPlot()
+// The window of windowSizeSec starting at the scroll position.
+bool MainWindow::currentWindow(PlotWindow &window) const
 {
-    if (!splitPlotWidget || splitVariable < 0) return;
+    return withHistory([&](const auto &store) {
+        if(store.empty()) return false;
+        window.start = qMin(static_cast<size_t>(qMax(0, hScrollBar->value())), store.size() - 1);
+        window.end = qMin(store.size(), window.start + static_cast<size_t>(windowSizeSec / samplePeriod));
+        window.end = qMax(window.end, window.start + 1);
+        window.x0 = store.time(window.start);
+        window.x1 = store.time(window.end - 1);
+        window.rasterX1 = window.x0 + windowSizeSec;
+        return true;
+    });
+}
 
-    if(dataBuffers[splitVariable].isEmpty()) return;
+// Y extent of samples [start, end) of one channel. The live window comes
+// from the channel's monotonic queues in O(1); any other window from the
+// history's min/max tree or the archive's block index.
+bool MainWindow::windowExtrema(int channel, size_t start, size_t end, double &lo, double &hi) const
+{
+    if(channel < 0 || channel >= static_cast<int>(liveExtrema.size())) return false;
+    const SlidingExtrema &live = liveExtrema[channel];
+    return withHistory([&](const auto &store) {
+        if(end == store.size() && live.full() && end - start == live.window()) {
+            lo = live.min();
+            hi = live.max();
+            return true;
+        }
+        return store.extrema(channel, start, end, lo, hi);
+    });
+}
 
-    int scrollPos = hScrollBar->value();
-    int dataSize = timeBuffer.size();
-    int bufferSize = dataBuffers[splitVariable].size();
-    int start = qMax(0, scrollPos);
-    int maxPoints = static_cast<int>(windowSizeSec / 0.02);
-    int end = qMin(qMin(dataSize, bufferSize), start + maxPoints);
+// Sizes the live queues to the window and refills them from the history.
+void MainWindow::resetLiveExtrema()
+{
+    size_t window = qMax<size_t>(1, static_cast<size_t>(windowSizeSec / samplePeriod));
+    withHistory([this, window](const auto &store) {
+        size_t size = store.size();
+        size_t first = size > window ? size - window : 0;
+        liveExtrema.resize(store.channelCount());
+        for(size_t c = 0; c < liveExtrema.size(); ++c) {
+            liveExtrema[c].reset(window);
+            store.forEach(c, first, size, [&live = liveExtrema[c]](double, double v) { live.push(v); });
+        }
+    });
+}
 
-    QVector<double> x, y;
-    for(int i = start; i < end; ++i) {
-        x.append(timeBuffer[i] * 0.02);
-        y.append(dataBuffers[splitVariable][i]);
+// Samples of one channel with timestamps in [from, to], for PlotWidget.
+void MainWindow::rangePoints(int channel, double from, double to, int columns, QVector<QPointF> &points) const
+{
+    if(channel < 0 || channel >= static_cast<int>(liveExtrema.size())) {
+        points.clear();
+        return;
     }
-    splitPlotWidget->updateData(x, y);
+    withHistory([&](const auto &store) {
+        samplePoints(channel, store.lowerBound(from), store.upperBound(to), columns, points);
+    });
+}
+
+bool MainWindow::rangeExtrema(int channel, double from, double to, double &lo, double &hi) const
+{
+    return withHistory([&](const auto &store) {
+        return windowExtrema(channel, store.lowerBound(from), store.upperBound(to), lo, hi);
+    });
+}
+
+// Samples [start, end) of one channel. Once there are more than the plot has
+// room for, they are M4-decimated to the first, min, max and last sample of
+// each pixel column.
+void MainWindow::samplePoints(int channel, size_t start, size_t end, int columns, QVector<QPointF> &points) const
+{
+    points.clear();
+    if(start >= end) return;
+
+    auto append = [&points](double t, double v) { points.append(QPointF(t, v)); };
+    withHistory([&](const auto &store) {
+        M4Decimator m4(store.time(start), store.time(end - 1), columns);
+        if(end - start <= m4.maxPoints()) {
+            points.reserve(static_cast<int>(end - start));
+            store.forEach(channel, start, end, append);
+            return;
+        }
+        points.reserve(static_cast<int>(m4.maxPoints()));
+        store.forEach(channel, start, end, [&m4, &append](double t, double v) { m4.add(t, v, append); });
+        m4.finish(append);
+    });
 }
@@ -4,27 +4,92 @@
 #define MAINWINDOW_H
 
 #include <QMainWindow>
-#include <QTcpSocket>
 #include <QComboBox>
 #include <QDoubleSpinBox>
 #include <QScrollBar>
 #include <QPushButton>
+#include <QLabel>
+#include <QThread>
 #include <QSplitter>
+#include <QGridLayout>
 #include <QtCharts/QChartView>
 #include <QtCharts/QSplineSeries>
 #include <QColor>
+#include <QByteArray>
+#include <QStringList>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QToolButton>
 
+#include "c37118_decoder.h"
+#include "channel_store.h"
+#include "concentrator.h"
+#include "history_archive.h"
+#include "ingest_worker.h"
+#include "latency_histogram.h"
+#include "perf_counters.h"
+#include "plot_widget.h"
+#include "sliding_extrema.h"
 
 
-class SplitPlotWidget : public QWidget
+// Visible part of the history, computed once per render tick and shared by
+// every pane.
+struct PlotWindow {
+    size_t start = 0;       // History indices [start, end)
+    size_t end = 0;
+    double x0 = 0.0;        // Time of the first sample
+    double x1 = 0.0;        // Time of the last sample (QtCharts X axis)
+    double rasterX1 = 0.0;  // x0 + window size (raster X axis)
+};
+
+// QChartView that reports each paint of its viewport.
+class PaneChartView : public QChartView
 {
     Q_OBJECT
 public:
-    SplitPlotWidget(int variableIndex, QString variableName, QString unit, QColor color, QWidget *parent = nullptr);
-    void updateData(const QVector<double>& x, const QVector<double>& y);
+    using QChartView::QChartView;
+    double lastPaintMicros() const { return paintMicros; }
+
+signals:
+    void painted();
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
 
 private:
-    QChartView *chartView;
+    double paintMicros = 0.0;
+};
+
+// One channel plotted with QtCharts or the raster PlotWidget. The main plot
+// is a pane without a header; dashboard panes have a name and close button.
+class PlotPane : public QWidget
+{
+    Q_OBJECT
+public:
+    PlotPane(const QString &chartTitle, bool closable, QWidget *parent = nullptr);
+    void setChannel(int channel, const QString &name, const QString &unit, const QColor &color);
+    int channel() const { return channelIndex; }
+    int plotColumns() const;
+    void setRaster(bool raster);
+    PlotWidget *rasterPlot() const { return plotWidget; }
+    // Reused across updates so steady-state redraws do not allocate; fill it,
+    // then call updateData().
+    QVector<QPointF> &pointBuffer() { return points; }
+    void updateData(const PlotWindow &window, double minY, double maxY);
+    // Time the visible plot took to paint last.
+    double lastPaintMicros() const;
+
+signals:
+    void closeRequested(PlotPane *pane);
+    // The visible plot, chart or raster, has painted.
+    void painted();
+
+private:
+    int channelIndex = 0;
+    QVector<QPointF> points;
+    QLabel *nameLabel = nullptr;
+    PlotWidget *plotWidget;
+    PaneChartView *chartView;
     QChart *chart;
     QSplineSeries *series;
 };
@@ -34,44 +99,131 @@ class MainWindow : public QMainWindow
     Q_OBJECT
 public:
     MainWindow(QWidget *parent = nullptr);
+    ~MainWindow() override;
+    void setRetention(const Retention &newRetention);
+    void setArchiveDir(const QString &dir);
+    void setRenderRate(int hz);
+    void setRasterPlots(bool raster);
+    void connectPmus(const QStringList &sources, bool concentrate, int waitMs);
+    // Age of the samples at each stage of the data path, from their SOC.
+    std::shared_ptr<PipelineLatency> pipelineLatency() const { return latency; }
+    // Status-bar panel with ingest rate, parse and render cost and memory.
+    void setPerfOverlay(bool on);
 
 private slots:
-    void onReadyRead();
+    void onConfigReceived(const ConfigFrame &cfg, const std::shared_ptr<SampleRing> &ring);
     void onComboChanged(int index);
     void onWindowSizeChanged(double newSizeSec);
     void onScrollBarChanged(int value);
-    void onSplitViewClicked();
-    void onCloseSplitView();
+    void onAddPaneClicked();
+    void onAllChannelsClicked();
+    void onClosePanes();
+    void onPaneCloseRequested(PlotPane *pane);
+    void onRenderTick();
+    void onRendererChanged(int index);
+    void onMainPanePainted();
+    void updatePerfOverlay();
 
 private:
     void setupUI();
-    void updatePlot();
-    void updateSplitPlot();
+    bool currentWindow(PlotWindow &window) const;
+    void updatePane(PlotPane *pane, const PlotWindow &window);
+    void attachSources(PlotPane *pane);
+    bool channelShown(int channel) const;
+    void addPane(int channel);
+    void layoutPanes();
+    bool windowExtrema(int channel, size_t start, size_t end, double &lo, double &hi) const;
+    void resetLiveExtrema();
+    void rangePoints(int channel, double from, double to, int columns, QVector<QPointF> &points) const;
+    bool rangeExtrema(int channel, double from, double to, double &lo, double &hi) const;
+    void samplePoints(int channel, size_t begin, size_t end, int columns, QVector<QPointF> &points) const;
+    bool drainIngest();
+    void updateQueueStatus();
+    uint64_t historyEnd() const;
+    void applyConfig(const ConfigFrame &cfg);
+    void resetHistory(const std::vector<bool> &floatColumns);
+    QByteArray archiveLayout() const;
+    void openArchive();
+    bool loadLatestArchiveLayout();
+    void updateScrollRange();
+    void setDefaultChannels();
+    void populateVariableCombo();
     QString getYAxisUnit(int variableIndex);
     QString variableLabel(int idx) const;
+    // Calls f with the store the plots read: the archive when one is open,
+    // the in-memory history otherwise.
+    template <typename F>
+    auto withHistory(F f) const;
     QColor variableColor(int idx) const;
 
-    QTcpSocket *socket;
     QComboBox *variableCombo;
+    QComboBox *rendererCombo;
     QDoubleSpinBox *windowSpinBox;
     QScrollBar *hScrollBar;
-    QPushButton *splitViewButton;
-    QPushButton *closeSplitButton;
+    QPushButton *addPaneButton;
+    QPushButton *allChannelsButton;
+    QPushButton *closePanesButton;
+    QLabel *queueLabel;
+    QLabel *concentratorLabel;
+    QLabel *perfLabel;
+    QToolButton *perfButton;
 
     QSplitter *splitter;
-    QWidget *mainPlotWidget;
-    SplitPlotWidget *splitPlotWidget = nullptr;
+    PlotPane *mainPane;              // Follows variableCombo
+    QWidget *paneGrid;               // Dashboard panes, beside the main plot
+    QGridLayout *paneLayout;
+    QVector<PlotPane*> panes;
+    bool rasterPlots = false;
 
-    QSplineSeries *series;
-    QChart *chart;
-    QChartView *chartView;
+    // C37.118.2 ingest, or the concentrator, runs on its own thread and hands
+    // samples over in ingestRing, which onRenderTick drains.
+    QThread *ingestThread = nullptr;
+    std::shared_ptr<SampleRing> ingestRing;
+    double timeOrigin = -1.0;        // Timestamp of the first data frame
+    double samplePeriod = 0.02;      // Seconds between frames, from DATA_RATE
 
-    QVector<QVector<double>> dataBuffers;
-    QVector<double> timeBuffer;
+    QStringList channelNames;
+    QStringList channelUnits;
+    ChannelStore history;            // Seconds since timeOrigin and decoded rows
+    Retention retention;
+    std::vector<bool> historyColumns; // float32 storage per channel
+    std::vector<SlidingExtrema> liveExtrema; // Per channel, over the newest window
+    QString archiveRoot;             // One archive per channel layout below it, empty = off
+    HistoryArchive archive;          // Replaces history as the plotted store while open
+    bool layoutKnown = false;        // Channels came from a CFG-2 or an archive, not defaults
     int currentVariable = 0;
-    int splitVariable = -1;
     double windowSizeSec = 2.0;
     bool autoScrollEnabled = true;
+
+    // Presentation: renderTimer drains ingestRing and redraws dirty panes.
+    QTimer *renderTimer;
+    bool plotDirty = false;          // Main pane
+    bool panesDirty = false;         // Dashboard panes
+    uint64_t scrollBase = 0;         // history.firstIndex() at the last tick
+
+    // End-to-end latency. Samples in [paintedEnd, shownEnd) (absolute history
+    // indices) were handed to the main pane and wait for its next paint.
+    static const uint64_t UNTRACKED = ~uint64_t(0);
+    std::shared_ptr<PipelineLatency> latency = std::make_shared<PipelineLatency>();
+    uint64_t paintedEnd = UNTRACKED;
+    uint64_t shownEnd = UNTRACKED;
+
+    // Performance overlay, refreshed by perfTimer while it is shown. The
+    // counters run all the time; the histograms cover one refresh interval.
+    std::shared_ptr<IngestCounters> ingestCounters = std::make_shared<IngestCounters>();
+    LatencyHistogram updateTime;     // Pane updates of one render tick
+    LatencyHistogram paintTime;      // One paint of the main pane
+    QTimer *perfTimer;
+    QElapsedTimer perfClock;         // Since the last refresh
+    uint64_t perfFrames = 0;         // ingestCounters->frames at the last refresh
+    uint64_t perfBytes = 0;
 };
 
+template <typename F>
+auto MainWindow::withHistory(F f) const
+{
+    if(archive.isOpen()) return f(archive);
+    return f(history);
+}
+
 #endif // MAINWINDOW_H
@@ -0,0 +1,32 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+// Counters behind the GUI's performance overlay.
+//
+// An ingest thread counts frames in plain integers while it frames and
+// decodes one socket read, then publishes the batch with a few relaxed atomic
+// adds and records how long the batch took, so a frame costs an increment.
+// Several workers (the concentrator's) can share one IngestCounters. The
+// overlay turns the totals into rates and resets the histogram after each
+// update, so its mean and p99 cover the last interval.
+
+#include <atomic>
+#include <cstdint>
+
+#include "latency_histogram.h"
+
+struct IngestCounters {
+    std::atomic<uint64_t> frames{0};     // Data frames decoded
+    std::atomic<uint64_t> malformed{0};  // CHK failures and data frames that did not decode
+    std::atomic<uint64_t> bytes{0};      // Read from the sockets
+    LatencyHistogram batchParse;         // Framing and decoding one socket read
+
+    void addBatch(uint64_t batchFrames, uint64_t batchMalformed, uint64_t batchBytes, int64_t parseNs) {
+        frames.fetch_add(batchFrames, std::memory_order_relaxed);
+        if (batchMalformed) malformed.fetch_add(batchMalformed, std::memory_order_relaxed);
+        bytes.fetch_add(batchBytes, std::memory_order_relaxed);
+        batchParse.record(parseNs);
+    }
+};
+
+#endif // PERF_COUNTERS_H
@@ -0,0 +1,326 @@
+#include "plot_widget.h"
+
+#include <QElapsedTimer>
+#include <QPainter>
+#include <QResizeEvent>
+
+#include <cmath>
+#include <cstring>
+
+// Margins around the plot area for titles and tick labels.
+static const int MARGIN_LEFT = 64;
+static const int MARGIN_RIGHT = 12;
+static const int MARGIN_TOP = 28;
+static const int MARGIN_BOTTOM = 40;
+
+static const QColor BACKGROUND_COLOR(Qt::white);
+static const QColor GRID_COLOR(225, 225, 225);
+
+// 1-2-5 tick spacing giving about `ticks` intervals over range.
+static double nice_step(double range, int ticks)
+{
+    if(range <= 0 || ticks <= 0) return 1.0;
+    double raw = range / ticks;
+    double magnitude = std::pow(10.0, std::floor(std::log10(raw)));
+    double norm = raw / magnitude;
+    double step = norm < 1.5 ? 1.0 : norm < 3.0 ? 2.0 : norm < 7.0 ? 5.0 : 10.0;
+    return step * magnitude;
+}
+
+static int step_decimals(double step)
+{
+    return qMax(0, static_cast<int>(-std::floor(std::log10(step) + 1e-9)));
+}
+
+PlotWidget::PlotWidget(QWidget *parent)
+    : QWidget(parent)
+{
+    setAttribute(Qt::WA_OpaquePaintEvent);
+}
+
+void PlotWidget::setSource(Source newSource)
+{
+    source = std::move(newSource);
+    invalidate();
+}
+
+void PlotWidget::setRangeSource(RangeSource newRangeSource)
+{
+    rangeSource = std::move(newRangeSource);
+    invalidate();
+}
+
+void PlotWidget::setColor(const QColor &newColor)
+{
+    color = newColor;
+    invalidate();
+}
+
+void PlotWidget::setTitles(const QString &title, const QString &xTitle, const QString &yTitle)
+{
+    titleText = title;
+    xTitleText = xTitle;
+    yTitleText = yTitle;
+    frameDirty = true;
+    update();
+}
+
+void PlotWidget::setXRange(double x0, double x1)
+{
+    viewX0 = x0;
+    viewX1 = x1;
+}
+
+void PlotWidget::invalidate()
+{
+    needFull = true;
+}
+
+QRect PlotWidget::plotRect() const
+{
+    return QRect(MARGIN_LEFT, MARGIN_TOP,
+                 qMax(0, width() - MARGIN_LEFT - MARGIN_RIGHT),
+                 qMax(0, height() - MARGIN_TOP - MARGIN_BOTTOM));
+}
+
+double PlotWidget::xScale() const
+{
+    return drawnSpan > 0 ? plotCache.width() / drawnSpan : 0.0;
+}
+
+double PlotWidget::toPixelY(double y) const
+{
+    return (yMax - y) / (yMax - yMin) * (plotCache.height() - 1);
+}
+
+QPointF PlotWidget::toPixel(const QPointF &point) const
+{
+    return QPointF((point.x() - drawnX0) * xScale(), toPixelY(point.y()));
+}
+
+void PlotWidget::refresh()
+{
+    QRect area = plotRect();
+    if(area.isEmpty() || !source || viewX1 <= viewX0) return;
+
+    double span = viewX1 - viewX0;
+    if(plotCache.size() != area.size() || std::fabs(span - drawnSpan) > span * 1e-9) needFull = true;
+    if(needFull || !appendSegment()) redrawAll();
+    update();
+}
+
+// Incremental path: scrolls the cache by whole pixels and strokes the data
+// to the right of the last point drawn. Returns false if a full redraw is
+// needed instead.
+bool PlotWidget::appendSegment()
+{
+    double scale = xScale();
+    // Round up so the cached right edge never falls short of the view's; the
+    // image lags the view by less than a pixel on the left instead.
+    int shift = static_cast<int>(std::ceil((viewX0 - drawnX0) * scale - 1e-6));
+    if(shift < 0 || shift >= plotCache.width()) return false;
+    // Once the whole view has scrolled past, redraw to refit the Y range.
+    if(unchangedSpan + shift / scale >= drawnSpan) return false;
+
+    double from = haveLast ? lastPoint.x() : drawnX0 + shift / scale;
+    scratch.clear();
+    if(viewX1 > from) {
+        int columns = qMax(1, static_cast<int>(std::ceil((viewX1 - from) * scale)));
+        source(from, viewX1, columns, scratch);
+    }
+    int skip = 0;
+    while(haveLast && skip < scratch.size() && scratch[skip].x() <= lastPoint.x()) ++skip;
+    scratch.remove(0, skip);
+    for(const QPointF &point : scratch) {
+        if(point.y() < yMin || point.y() > yMax) return false;
+    }
+
+    if(shift > 0) {
+        shiftPlot(shift);
+        drawnX0 += shift / scale;
+        unchangedSpan += shift / scale;
+    }
+    strokePoints(haveLast ? &lastPoint : nullptr, scratch);
+    if(!scratch.isEmpty()) {
+        lastPoint = scratch.last();
+        haveLast = true;
+    }
+    return true;
+}
+
+void PlotWidget::redrawAll()
+{
+    QRect area = plotRect();
+    if(plotCache.size() != area.size())
+        plotCache = QImage(area.size(), QImage::Format_RGB32);
+
+    drawnX0 = viewX0;
+    drawnSpan = viewX1 - viewX0;
+    unchangedSpan = 0.0;
+    needFull = false;
+
+    scratch.clear();
+    source(viewX0, viewX1, area.width(), scratch);
+    fitYRange(scratch);
+    clearPlot(0);
+    strokePoints(nullptr, scratch);
+    haveLast = !scratch.isEmpty();
+    if(haveLast) lastPoint = scratch.last();
+}
+
+// Moves the cached pixels `pixels` columns left and clears the strip that
+// opens up on the right.
+void PlotWidget::shiftPlot(int pixels)
+{
+    int keep = plotCache.width() - pixels;
+    size_t pixelBytes = sizeof(quint32);
+    for(int y = 0; y < plotCache.height(); ++y) {
+        uchar *line = plotCache.scanLine(y);
+        std::memmove(line, line + pixels * pixelBytes, keep * pixelBytes);
+    }
+    clearPlot(keep);
+}
+
+// Background and horizontal grid lines from fromColumn to the right edge.
+void PlotWidget::clearPlot(int fromColumn)
+{
+    QPainter painter(&plotCache);
+    QRect strip(fromColumn, 0, plotCache.width() - fromColumn, plotCache.height());
+    painter.fillRect(strip, BACKGROUND_COLOR);
+    painter.setPen(GRID_COLOR);
+    for(double v = std::ceil(yMin / yStep) * yStep; v <= yMax; v += yStep) {
+        int y = qRound(toPixelY(v));
+        painter.drawLine(strip.left(), y, strip.right(), y);
+    }
+}
+
+void PlotWidget::strokePoints(const QPointF *lead, const QVector<QPointF> &points)
+{
+    mapped.clear();
+    if(lead) mapped.append(toPixel(*lead));
+    for(const QPointF &point : points) mapped.append(toPixel(point));
+    if(mapped.isEmpty()) return;
+
+    QPainter painter(&plotCache);
+    painter.setRenderHint(QPainter::Antialiasing);
+    painter.setPen(QPen(color, 1.5));
+    if(mapped.size() == 1) painter.drawPoint(mapped.first());
+    else painter.drawPolyline(mapped.constData(), mapped.size());
+}
+
+// Y range with 10% padding, widened to whole tick steps.
+void PlotWidget::fitYRange(const QVector<QPointF> &points)
+{
+    double lo = 0.0, hi = 1.0;
+    bool haveRange = rangeSource && rangeSource(viewX0, viewX1, lo, hi);
+    if(!haveRange && !points.isEmpty()) {
+        lo = hi = points.first().y();
+        for(const QPointF &point : points) {
+            lo = qMin(lo, point.y());
+            hi = qMax(hi, point.y());
+        }
+        haveRange = true;
+    }
+    if(haveRange) {
+        double pad = (hi - lo) * 0.1;
+        if(pad == 0) pad = 1.0;
+        lo -= pad;
+        hi += pad;
+    }
+    int ticks = qMax(2, plotCache.height() / 50);
+    double step = nice_step(hi - lo, ticks);
+    lo = std::floor(lo / step) * step;
+    hi = std::ceil(hi / step) * step;
+    if(lo != yMin || hi != yMax || step != yStep) {
+        yMin = lo;
+        yMax = hi;
+        yStep = step;
+        frameDirty = true;
+    }
+}
+
+// Everything outside the plot area except the X tick labels.
+void PlotWidget::rebuildFrame()
+{
+    frameCache = QImage(size(), QImage::Format_RGB32);
+    frameCache.fill(palette().window().color());
+    QRect area = plotRect();
+
+    QPainter painter(&frameCache);
+    painter.setPen(palette().windowText().color());
+    QFont bold = font();
+    bold.setBold(true);
+    painter.setFont(bold);
+    painter.drawText(QRect(0, 0, width(), MARGIN_TOP), Qt::AlignCenter, titleText);
+    painter.setFont(font());
+    painter.drawText(QRect(area.left(), height() - 18, area.width(), 18), Qt::AlignCenter, xTitleText);
+
+    if(!plotCache.isNull()) {
+        int decimals = step_decimals(yStep);
+        for(double v = std::ceil(yMin / yStep) * yStep; v <= yMax + yStep * 1e-6; v += yStep) {
+            int y = area.top() + qRound(toPixelY(v));
+            painter.drawLine(area.left() - 5, y, area.left() - 1, y);
+            painter.drawText(QRect(16, y - 8, area.left() - 24, 16), Qt::AlignRight | Qt::AlignVCenter,
+                             QString::number(v, 'f', decimals));
+        }
+    }
+    painter.save();
+    painter.translate(12, area.center().y());
+    painter.rotate(-90);
+    painter.drawText(QRect(-area.height() / 2, -10, area.height(), 20), Qt::AlignCenter, yTitleText);
+    painter.restore();
+
+    painter.drawRect(area.adjusted(-1, -1, 0, 0));
+    frameDirty = false;
+}
+
+const QStaticText &PlotWidget::xLabel(double value)
+{
+    // Labels are re-laid out only when a new value scrolls into view.
+    if(xLabels.size() > 512) xLabels.clear();
+    QString text = QString::number(value, 'f', step_decimals(nice_step(drawnSpan, qMax(2, plotRect().width() / 100))));
+    auto it = xLabels.find(text);
+    if(it == xLabels.end()) {
+        QStaticText label(text);
+        label.prepare(QTransform(), font());
+        it = xLabels.insert(text, label);
+    }
+    return it.value();
+}
+
+void PlotWidget::paintEvent(QPaintEvent * /*event*/)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    if(frameDirty || frameCache.size() != size()) rebuildFrame();
+    QPainter painter(this);
+    painter.drawImage(0, 0, frameCache);
+
+    QRect area = plotRect();
+    if(!plotCache.isNull() && plotCache.size() == area.size()) {
+        painter.drawImage(area.topLeft(), plotCache);
+
+        // X ticks move with every scroll step, so they are drawn here from
+        // cached labels rather than baked into the frame.
+        double scale = xScale();
+        double step = nice_step(drawnSpan, qMax(2, area.width() / 100));
+        painter.setPen(palette().windowText().color());
+        for(double t = std::ceil(drawnX0 / step) * step; t <= drawnX0 + drawnSpan; t += step) {
+            int x = area.left() + qRound((t - drawnX0) * scale);
+            painter.drawLine(x, area.bottom() + 1, x, area.bottom() + 5);
+            const QStaticText &label = xLabel(t);
+            painter.drawStaticText(QPointF(x - label.size().width() / 2, area.bottom() + 7), label);
+        }
+    }
+    paintMicros = timer.nsecsElapsed() / 1000.0;
+    emit painted();
+}
+
+void PlotWidget::resizeEvent(QResizeEvent *event)
+{
+    QWidget::resizeEvent(event);
+    needFull = true;
+    frameDirty = true;
+    refresh();
+}
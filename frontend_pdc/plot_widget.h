@@ -0,0 +1,102 @@
+#ifndef PLOT_WIDGET_H
+#define PLOT_WIDGET_H
+
+// Lightweight raster alternative to QChartView for one streaming series.
+//
+// The series is stroked with QPainter into a cached opaque QImage of the plot
+// area; paintEvent() only blits the caches. Data is pulled through a source
+// callback, already decimated to the pixel columns asked for. While the view
+// scrolls forward (auto-scroll) refresh() shifts the cached pixels left and
+// strokes only the newly arrived segment; everything is redrawn when the
+// view jumps, resizes or the new data leaves the current Y range. The frame,
+// title and Y axis are cached in a second image and X tick labels as
+// QStaticText, so a frame costs two image blits and a handful of labels.
+
+#include <QWidget>
+#include <QColor>
+#include <QHash>
+#include <QImage>
+#include <QPointF>
+#include <QStaticText>
+#include <QString>
+#include <QVector>
+
+#include <functional>
+
+class PlotWidget : public QWidget
+{
+    Q_OBJECT
+public:
+    // Fills out with the points of [from, to] (x ascending), decimated to
+    // about `columns` pixel columns.
+    using Source = std::function<void(double from, double to, int columns, QVector<QPointF> &out)>;
+    // Sets lo/hi to the Y extent of the raw data in [from, to]; false if there
+    // is none. Without one the extent is taken from the decimated points.
+    using RangeSource = std::function<bool(double from, double to, double &lo, double &hi)>;
+
+    explicit PlotWidget(QWidget *parent = nullptr);
+
+    void setSource(Source newSource);
+    void setRangeSource(RangeSource newRangeSource);
+    void setColor(const QColor &newColor);
+    void setTitles(const QString &title, const QString &xTitle, const QString &yTitle);
+
+    // Visible X range; takes effect on the next refresh().
+    void setXRange(double x0, double x1);
+    // Forces a full redraw on the next refresh() (data replaced, not appended).
+    void invalidate();
+    // Brings the cached image up to date with the source and schedules a paint.
+    void refresh();
+
+    double lastPaintMicros() const { return paintMicros; }
+
+signals:
+    void painted();
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
+
+private:
+    QRect plotRect() const;
+    double xScale() const;
+    QPointF toPixel(const QPointF &point) const;
+    double toPixelY(double y) const;
+    void redrawAll();
+    bool appendSegment();
+    void shiftPlot(int pixels);
+    void clearPlot(int fromColumn);
+    void strokePoints(const QPointF *lead, const QVector<QPointF> &points);
+    void fitYRange(const QVector<QPointF> &points);
+    void rebuildFrame();
+    const QStaticText &xLabel(double value);
+
+    Source source;
+    RangeSource rangeSource;
+    QColor color = Qt::red;
+    QString titleText;
+    QString xTitleText;
+    QString yTitleText;
+
+    double viewX0 = 0.0;      // Requested X range
+    double viewX1 = 1.0;
+    double drawnX0 = 0.0;     // X at the left edge of plotCache
+    double drawnSpan = 0.0;   // X range width plotCache was drawn for
+    double yMin = 0.0;
+    double yMax = 1.0;
+    double yStep = 0.5;       // Y tick spacing
+    bool haveLast = false;    // lastPoint is valid
+    QPointF lastPoint;        // Rightmost point stroked so far (data units)
+    double unchangedSpan = 0.0; // X scrolled since the last full redraw
+    bool needFull = true;
+
+    QImage plotCache;         // Plot area: grid and series
+    QImage frameCache;        // Whole widget: background, titles, Y axis
+    bool frameDirty = true;
+    QHash<QString, QStaticText> xLabels;
+    QVector<QPointF> scratch;
+    QVector<QPointF> mapped;
+    double paintMicros = 0.0;
+};
+
+#endif // PLOT_WIDGET_H
@@ -0,0 +1,288 @@
+#ifndef PMU_SIM_ENGINE_H
+#define PMU_SIM_ENGINE_H
+
+// Multi-PMU simulation engine.
+//
+// Hosts N virtual PMUs, each with its own IDCODE, station name, channel
+// counts and reporting rate. PMUs are split into contiguous shards, one per
+// worker thread; on every reporting tick each worker generates random
+// measurements for its due PMUs and encodes them into a per-shard frame arena
+// that is allocated once up front. encodeTick() returns views into those
+// arenas, which stay valid until the next tick.
+//
+// PMUs with the same reporting rate form a rate group; callers pass a bitmask
+// of the groups that are due so mixed-rate setups share one engine.
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "c37118_layout.h"
+#include "data_frame_encoder.h"
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+struct VirtualPmuConfig {
+    uint16_t idCode = 1;
+    std::string stationName;
+    uint16_t dataRate = 50;
+    float nominalFreq = 50.0f;
+    uint16_t phnmr = 3;
+    uint16_t annmr = 4;
+    uint16_t dgnmr = 0;
+    bool floatFmt = true;
+    bool polarFmt = true;
+};
+
+struct EncodedFrame {
+    const unsigned char* data;
+    size_t len;
+    size_t pmuIndex;
+};
+
+// xorshift64*: thread-local, allocation-free and far cheaper than rand().
+struct SimRng {
+    uint64_t state = 0x9E3779B97F4A7C15ULL;
+
+    uint32_t next() {
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return static_cast<uint32_t>((state * 0x2545F4914F6CDD1DULL) >> 32);
+    }
+
+    float uniform(float min_val, float max_val) {
+        return min_val + (next() * (1.0f / 4294967296.0f)) * (max_val - min_val);
+    }
+};
+
+class PmuSimEngine
+{
+public:
+    static constexpr size_t MAX_RATE_GROUPS = 64;
+    static constexpr float DEG_TO_RAD = 3.14159265358979323846f / 180.0f;
+
+    // workerCount 0 encodes on the calling thread.
+    PmuSimEngine(std::vector<VirtualPmuConfig> configs, unsigned workerCount, bool pinWorkers)
+        : pmus(std::move(configs))
+    {
+        layouts.reserve(pmus.size());
+        for (const auto& cfg : pmus) {
+            layouts.push_back(make_data_frame_layout(cfg.phnmr, cfg.annmr, cfg.dgnmr, cfg.floatFmt, cfg.polarFmt));
+            auto it = std::find(groupRates.begin(), groupRates.end(), cfg.dataRate);
+            if (it == groupRates.end()) {
+                groupRates.push_back(cfg.dataRate);
+                it = groupRates.end() - 1;
+            }
+            pmuGroup.push_back(static_cast<size_t>(it - groupRates.begin()));
+        }
+        groupRates.resize(std::min(groupRates.size(), MAX_RATE_GROUPS));
+
+        unsigned shardCount = std::max(1u, std::min<unsigned>(workerCount, static_cast<unsigned>(pmus.size())));
+        shards.resize(shardCount);
+        size_t perShard = (pmus.size() + shardCount - 1) / shardCount;
+        for (unsigned s = 0; s < shardCount; ++s) {
+            Shard& shard = shards[s];
+            shard.first = std::min(pmus.size(), s * perShard);
+            shard.last = std::min(pmus.size(), shard.first + perShard);
+            shard.rng.state ^= (static_cast<uint64_t>(s) + 1) * 0xD1B54A32D192ED03ULL;
+
+            size_t arenaSize = 0;
+            size_t scratch = 0;
+            for (size_t i = shard.first; i < shard.last; ++i) {
+                shard.offsets.push_back(arenaSize);
+                arenaSize += layouts[i].frameSize;
+                scratch = std::max<size_t>(scratch, 2u * pmus[i].phnmr + pmus[i].annmr);
+            }
+            shard.arena.resize(arenaSize);
+            shard.values.resize(scratch);
+            size_t maxDigital = 0;
+            for (size_t i = shard.first; i < shard.last; ++i)
+                maxDigital = std::max<size_t>(maxDigital, pmus[i].dgnmr);
+            shard.digitals.resize(maxDigital);
+        }
+
+        // Frame views per rate group, in PMU order, built once.
+        groupFrames.resize(groupRates.size());
+        for (size_t i = 0; i < pmus.size(); ++i) {
+            if (pmuGroup[i] >= groupRates.size()) continue;
+            const Shard& shard = shards[shardOf(i)];
+            const unsigned char* data = shard.arena.data() + shard.offsets[i - shard.first];
+            groupFrames[pmuGroup[i]].push_back({data, layouts[i].frameSize, i});
+        }
+        tickFrames.reserve(pmus.size());
+
+        if (workerCount == 0) return;
+        unsigned cpuCount = std::max(1u, std::thread::hardware_concurrency());
+        for (unsigned s = 0; s < shards.size(); ++s) {
+            shards[s].thread = std::thread([this, s]() { workerLoop(shards[s]); });
+            if (pinWorkers) {
+                // Leave CPU 0 to the network thread when there is room.
+                unsigned cpu = (cpuCount > 1) ? 1 + s % (cpuCount - 1) : 0;
+                pinThread(shards[s].thread, cpu);
+            }
+        }
+        threaded = true;
+    }
+
+    ~PmuSimEngine() {
+        if (!threaded) return;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+            ++generation;
+        }
+        startCv.notify_all();
+        for (Shard& shard : shards)
+            if (shard.thread.joinable()) shard.thread.join();
+    }
+
+    PmuSimEngine(const PmuSimEngine&) = delete;
+    PmuSimEngine& operator=(const PmuSimEngine&) = delete;
+
+    size_t pmuCount() const { return pmus.size(); }
+    const VirtualPmuConfig& pmu(size_t i) const { return pmus[i]; }
+    const DataFrameLayout& layout(size_t i) const { return layouts[i]; }
+    size_t workerCount() const { return threaded ? shards.size() : 0; }
+
+    const std::vector<uint16_t>& rateGroups() const { return groupRates; }
+    size_t rateGroupOf(size_t pmuIndex) const { return pmuGroup[pmuIndex]; }
+
+    // Returns the index of the PMU with this IDCODE, or pmuCount() if none.
+    size_t findPmu(uint16_t idCode) const {
+        for (size_t i = 0; i < pmus.size(); ++i)
+            if (pmus[i].idCode == idCode) return i;
+        return pmus.size();
+    }
+
+    // Generates and encodes one report, stamped soc/fracsec, for every PMU in
+    // the rate groups set in dueGroups. Blocks until all shards are done.
+    const std::vector<EncodedFrame>& encodeTick(uint64_t dueGroups, uint32_t soc, uint32_t fracsec) {
+        tickGroups = dueGroups;
+        tickSoc = soc;
+        tickFracsec = fracsec;
+
+        if (threaded) {
+            std::unique_lock<std::mutex> lock(mutex);
+            pendingShards = shards.size();
+            ++generation;
+            startCv.notify_all();
+            doneCv.wait(lock, [this]() { return pendingShards == 0; });
+        }
+        else {
+            encodeShard(shards[0]);
+        }
+
+        tickFrames.clear();
+        for (size_t g = 0; g < groupFrames.size(); ++g) {
+            if (dueGroups & (uint64_t(1) << g))
+                tickFrames.insert(tickFrames.end(), groupFrames[g].begin(), groupFrames[g].end());
+        }
+        return tickFrames;
+    }
+
+private:
+    struct Shard {
+        size_t first = 0;
+        size_t last = 0;
+        std::vector<size_t> offsets;        // Frame offset in arena, per PMU
+        std::vector<unsigned char> arena;   // Encoded frames of this shard
+        std::vector<float> values;          // Phasor + analog scratch
+        std::vector<uint16_t> digitals;
+        SimRng rng;
+        std::thread thread;
+        uint64_t seenGeneration = 0;
+    };
+
+    size_t shardOf(size_t pmuIndex) const {
+        for (size_t s = 0; s < shards.size(); ++s)
+            if (pmuIndex < shards[s].last) return s;
+        return shards.size() - 1;
+    }
+
+    static void pinThread(std::thread& thread, unsigned cpu) {
+#ifdef __linux__
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set);
+#else
+        (void)thread;
+        (void)cpu;
+#endif
+    }
+
+    void workerLoop(Shard& shard) {
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                startCv.wait(lock, [&]() { return generation != shard.seenGeneration; });
+                shard.seenGeneration = generation;
+                if (stopping) return;
+            }
+            encodeShard(shard);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (--pendingShards == 0) doneCv.notify_one();
+            }
+        }
+    }
+
+    void encodeShard(Shard& shard) {
+        for (size_t i = shard.first; i < shard.last; ++i) {
+            if (pmuGroup[i] >= groupRates.size() || !(tickGroups & (uint64_t(1) << pmuGroup[i]))) continue;
+            const VirtualPmuConfig& cfg = pmus[i];
+            SimRng& rng = shard.rng;
+
+            uint16_t stat = 0;
+            stat |= (1 << 15); // Data valid
+            stat |= (1 << 14); // PMU sync
+
+            float* phasors = shard.values.data();
+            float nominal_mag = 230.0f; // Nominal voltage magnitude
+            for (uint16_t p = 0; p < cfg.phnmr; ++p) {
+                phasors[2 * p] = nominal_mag + rng.uniform(-5.0f, 5.0f);
+                phasors[2 * p + 1] = rng.uniform(-180.0f, 180.0f) * DEG_TO_RAD; // Angle in radians
+            }
+            float freq = cfg.nominalFreq + rng.uniform(-0.05f, 0.05f);
+            float rocof = rng.uniform(-0.5f, 0.5f);
+            float* analogs = phasors + 2 * cfg.phnmr;
+            for (uint16_t a = 0; a < cfg.annmr; ++a)
+                analogs[a] = rng.uniform(0.0f, 10.0f);
+
+            unsigned char* out = shard.arena.data() + shard.offsets[i - shard.first];
+            encode_data_frame(out, layouts[i], cfg.idCode, tickSoc, tickFracsec, stat,
+                              phasors, freq, rocof, analogs, shard.digitals.data(), cfg.nominalFreq);
+        }
+    }
+
+    std::vector<VirtualPmuConfig> pmus;
+    std::vector<DataFrameLayout> layouts;
+    std::vector<size_t> pmuGroup;
+    std::vector<uint16_t> groupRates;
+    std::vector<std::vector<EncodedFrame>> groupFrames;
+    std::vector<EncodedFrame> tickFrames;
+    std::vector<Shard> shards;
+    bool threaded = false;
+
+    // Tick parameters, published to workers under `mutex`.
+    uint64_t tickGroups = 0;
+    uint32_t tickSoc = 0;
+    uint32_t tickFracsec = 0;
+
+    std::mutex mutex;
+    std::condition_variable startCv;
+    std::condition_variable doneCv;
+    uint64_t generation = 0;
+    size_t pendingShards = 0;
+    bool stopping = false;
+};
+
+#endif // PMU_SIM_ENGINE_H
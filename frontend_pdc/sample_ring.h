@@ -0,0 +1,85 @@
+#ifndef SAMPLE_RING_H
+#define SAMPLE_RING_H
+
+// Lock-free single-producer/single-consumer queue of decoded samples, the
+// handoff from the ingest thread to the GUI.
+//
+// A sample is a fixed-width row: its timestamp followed by one value per
+// channel. Rows live in one preallocated array of a power-of-two row count,
+// so push() and drain() copy doubles and touch two atomics; nothing is
+// allocated or locked. The producer owns tail, the consumer head; each side
+// also keeps a cached copy of the other's index and only reloads it when the
+// ring looks full (or empty), so the shared cache lines move rarely. A push
+// into a full ring drops the sample and counts it instead of waiting.
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+class SampleRing
+{
+public:
+    // channels values per row; capacity is rounded up to a power of two.
+    SampleRing(size_t channels, size_t capacity)
+        : width(channels + 1) {
+        rows = 1;
+        while (rows < capacity) rows <<= 1;
+        data.resize(rows * width);
+    }
+
+    size_t channelCount() const { return width - 1; }
+    size_t capacity() const { return rows; }
+
+    // Producer only. False (and counted) if the ring is full.
+    bool push(double time, const double* values) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - cachedHead == rows) {
+            cachedHead = head.load(std::memory_order_acquire);
+            if (t - cachedHead == rows) {
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+        }
+        double* row = &data[(t & (rows - 1)) * width];
+        row[0] = time;
+        std::memcpy(row + 1, values, (width - 1) * sizeof(double));
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer only. Calls f(time, values) for every queued row, oldest first,
+    // and returns how many there were.
+    template <typename F>
+    size_t drain(F f) {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == cachedTail) cachedTail = tail.load(std::memory_order_acquire);
+        size_t n = cachedTail - h;
+        for (size_t i = h; i != cachedTail; ++i) {
+            const double* row = &data[(i & (rows - 1)) * width];
+            f(row[0], row + 1);
+        }
+        head.store(cachedTail, std::memory_order_release);
+        return n;
+    }
+
+    // Either thread; approximate while the other side is running.
+    size_t depth() const {
+        size_t h = head.load(std::memory_order_acquire);  // First, so tail >= h
+        return tail.load(std::memory_order_acquire) - h;
+    }
+    uint64_t droppedSamples() const { return dropped.load(std::memory_order_relaxed); }
+
+private:
+    size_t width;
+    size_t rows;
+    std::vector<double> data;
+    alignas(64) std::atomic<size_t> tail{0};
+    size_t cachedHead = 0;  // Producer only
+    alignas(64) std::atomic<size_t> head{0};
+    size_t cachedTail = 0;  // Consumer only
+    alignas(64) std::atomic<uint64_t> dropped{0};
+};
+
+#endif // SAMPLE_RING_H
@@ -0,0 +1,192 @@
+#ifndef SIM_FRAMES_H
+#define SIM_FRAMES_H
+
+// Frames of the PMU simulator other than data frames: the CFG-2 it announces
+// for each virtual PMU and the command frames it receives. Kept out of
+// backend.cpp so the benchmark suite can time them without the server.
+
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <vector>
+
+#include "async_logger.h"
+#include "c37118_layout.h"
+#include "crc_ccitt.h"
+#include "pmu_sim_engine.h"
+
+// Nominal system frequency implied by a reporting rate.
+inline float nominal_frequency(uint16_t dataRate) {
+    return (dataRate % 60 == 0 && dataRate % 50 != 0) ? 60.0f : 50.0f;
+}
+
+inline void append_uint16_be(std::vector<unsigned char>& buffer, uint16_t value) {
+    buffer.push_back((value >> 8) & 0xFF);
+    buffer.push_back(value & 0xFF);
+}
+
+inline void append_int16_be(std::vector<unsigned char>& buffer, int16_t value) {
+    append_uint16_be(buffer, static_cast<uint16_t>(value));
+}
+
+inline void append_uint32_be(std::vector<unsigned char>& buffer, uint32_t value) {
+    buffer.push_back((value >> 24) & 0xFF);
+    buffer.push_back((value >> 16) & 0xFF);
+    buffer.push_back((value >> 8) & 0xFF);
+    buffer.push_back(value & 0xFF);
+}
+
+inline void append_float32_be(std::vector<unsigned char>& buffer, float value) {
+    union {
+        float f;
+        uint32_t i;
+    } u;
+    u.f = value;
+    append_uint32_be(buffer, u.i);
+}
+
+inline void append_bytes(std::vector<unsigned char>& buffer, const void* data, size_t length) {
+    const unsigned char* byte_data = static_cast<const unsigned char*>(data);
+    buffer.insert(buffer.end(), byte_data, byte_data + length);
+}
+
+inline std::vector<unsigned char> create_config_frame2(
+    uint16_t pmuId,
+    uint32_t timeBase,
+    uint16_t numPmu,
+    const std::string& stnName,
+    uint16_t dataRate,
+    uint16_t phnmr,
+    uint16_t annmr,
+    uint16_t dgnmr,
+    bool floatFmt, bool polarFmt)
+{
+    std::vector<unsigned char> frame;
+    frame.reserve(300);
+
+    frame.push_back(SYNC_CFG2);
+    frame.push_back(TYPE_CFG2);
+    append_uint16_be(frame, 0); // Placeholder for FRAMESIZE
+    append_uint16_be(frame, pmuId);
+    time_t now_soc = time(NULL);
+    append_uint32_be(frame, static_cast<uint32_t>(now_soc));
+    append_uint32_be(frame, 0); // FRACSEC
+
+    append_uint32_be(frame, timeBase);
+    append_uint16_be(frame, numPmu);
+
+    std::string fixedStnName = stnName;
+    fixedStnName.resize(16, ' ');
+    append_bytes(frame, fixedStnName.c_str(), 16);
+    append_uint16_be(frame, pmuId);
+
+    append_uint16_be(frame, data_frame_format(floatFmt, polarFmt));
+
+    append_uint16_be(frame, phnmr);
+    append_uint16_be(frame, annmr);
+    append_uint16_be(frame, dgnmr);
+
+    for (uint16_t i = 0; i < phnmr; ++i) {
+        std::string name = "Phasor " + std::to_string(i + 1);
+        name.resize(16, ' ');
+        append_bytes(frame, name.c_str(), 16);
+    }
+    for (uint16_t i = 0; i < annmr; ++i) {
+        std::string name = "Analog " + std::to_string(i + 1);
+        name.resize(16, ' ');
+        append_bytes(frame, name.c_str(), 16);
+    }
+    for (uint16_t i = 0; i < 16 * dgnmr; ++i) {
+        std::string name = "Digital " + std::to_string(i / 16 + 1) + "." + std::to_string(i % 16);
+        name.resize(16, ' ');
+        append_bytes(frame, name.c_str(), 16);
+    }
+
+    for (uint16_t i = 0; i < phnmr; ++i) {
+        uint32_t phunit = (i == 0) ? 0x00000001 : 0x01000001; // Volt: 1V, Current: 0.01A
+        append_uint32_be(frame, phunit);
+    }
+
+    for (uint16_t i = 0; i < annmr; ++i) {
+        append_uint32_be(frame, 0x00000064); // 100 units
+    }
+
+    for (uint16_t i = 0; i < dgnmr; ++i) {
+        append_uint32_be(frame, 0x0000FFFF); // Normal state 0, all bits valid
+    }
+
+    uint16_t fnom_code = (nominal_frequency(dataRate) == 50.0f) ? 1 : 0; // Bit 0 set: 50 Hz
+    append_uint16_be(frame, fnom_code);
+    append_uint16_be(frame, 0); // CFGCNT
+    append_uint16_be(frame, dataRate);
+
+    uint16_t frameSize = static_cast<uint16_t>(frame.size() + 2);
+    frame[2] = (frameSize >> 8) & 0xFF;
+    frame[3] = frameSize & 0xFF;
+
+    uint16_t crc = calculate_crc(frame.data(), frame.size());
+    append_uint16_be(frame, crc);
+
+    return frame;
+}
+
+// CMD word of a command frame as received. Standard frames carry SOC/FRACSEC
+// before CMD; compact 10-byte frames from older clients have CMD right after
+// IDCODE.
+inline uint16_t command_code(const unsigned char* cmdFrame, size_t frameSize) {
+    return load_be16(cmdFrame + (frameSize >= 18 ? 14 : 6));
+}
+
+// cmdFrame is one complete frame with a verified CHK, as produced by
+// StreamFramer. pmuId is set to the addressed IDCODE, a hosted PMU or 0xFFFF
+// (all PMUs). Returns false, after logging, when the frame is not a command
+// or addresses a PMU this process does not host; the caller ignores it.
+inline bool processCommandFrame(const unsigned char* cmdFrame, size_t frameSize, const PmuSimEngine& engine,
+                         uint16_t& pmuId, uint16_t& command) {
+    command = 0;
+    pmuId = 0xFFFF;
+    PMU_LOG_HEX(LogLevel::Debug, "Command frame", cmdFrame, frameSize);
+
+    if (cmdFrame[0] != SYNC_CMD || cmdFrame[1] != TYPE_CMD) {
+        PMU_LOG_ERROR("Invalid command frame header, ignored.");
+        return false;
+    }
+
+    uint16_t receivedPMUId = (static_cast<uint16_t>(cmdFrame[4]) << 8) | cmdFrame[5];
+    PMU_LOG_DEBUG("Received PMU ID: {}", receivedPMUId);
+    if (receivedPMUId != 0xFFFF && engine.findPmu(receivedPMUId) == engine.pmuCount()) {
+        PMU_LOG_ERROR("PMU ID mismatch: {} is not hosted here, command ignored.", receivedPMUId);
+        return false;
+    }
+    pmuId = receivedPMUId;
+
+    command = command_code(cmdFrame, frameSize);
+    PMU_LOG_DEBUG("Command Code: 0x{}", LogHex{command});
+
+    switch (command) {
+    case CMD_TURN_OFF_TX:
+        PMU_LOG_INFO("Turn Off Data Transmission.");
+        break;
+    case CMD_TURN_ON_TX:
+        PMU_LOG_INFO("Turn On Data Transmission.");
+        break;
+    case CMD_SEND_HDR:
+        PMU_LOG_INFO("Send Header Frame.");
+        break;
+    case CMD_SEND_CFG1:
+        PMU_LOG_INFO("Send CFG-1 Frame (using CFG-2).");
+        break;
+    case CMD_SEND_CFG2:
+        /* case 0x67F2:
+             std::cout << "[PMU] Send CFG-2 Frame (0x67F2 handled).\n";
+             command = CMD_SEND_CFG2;
+             break;*/
+    default:
+        PMU_LOG_INFO("Send CFG-2 Frame (0x67F2 handled).");
+        command = CMD_SEND_CFG2;
+        break;
+    }
+    return true;
+}
+
+#endif // SIM_FRAMES_H
@@ -0,0 +1,335 @@
+#ifndef SIM_METRICS_H
+#define SIM_METRICS_H
+
+// Prometheus metrics of the PMU simulator (--metrics-port).
+//
+// Every thread that counts owns a MetricsShard and is its only writer, so an
+// update is a relaxed load and store of counters no other thread writes: no
+// locked instruction and no cache line bouncing between the send path and
+// the scraper. The HTTP listener runs on its own thread, bound to localhost,
+// and sums all shards with relaxed loads for every GET /metrics; a scrape
+// that races an update sees it or not, never a torn value.
+//
+// Per-client send backlogs belong to the network thread's client table, so
+// that thread publishes a snapshot of them (publishClients()) about once a
+// second; that hand-over is the only lock the metrics take.
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "c37118_layout.h"
+#include "socket_compat.h"
+#include "socket_poller.h"
+
+inline int64_t metrics_clock_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Monotonic counter with a single writer.
+class MetricCounter
+{
+public:
+    void add(uint64_t n = 1) { value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed); }
+    uint64_t get() const { return value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> value{0};
+};
+
+// Duration histogram with a single writer, exported in seconds.
+class MetricHistogram
+{
+public:
+    static constexpr std::array<int64_t, 13> BOUNDS_US = {5, 10, 20, 50, 100, 200, 500,
+                                                           1000, 2000, 5000, 10000, 20000, 50000};
+    static const size_t BUCKETS = BOUNDS_US.size() + 1;  // The last one is +Inf
+
+    void record(int64_t ns) {
+        if (ns < 0) ns = 0;
+        size_t b = 0;
+        while (b < BOUNDS_US.size() && ns > BOUNDS_US[b] * 1000) ++b;
+        counts[b].add();
+        sumNs.add(static_cast<uint64_t>(ns));
+    }
+
+    uint64_t bucket(size_t b) const { return counts[b].get(); }
+    uint64_t sum() const { return sumNs.get(); }
+
+private:
+    std::array<MetricCounter, BUCKETS> counts;
+    MetricCounter sumNs;
+};
+
+enum class Transport { Tcp, Udp, Count };
+
+// Command kinds counted separately; everything else is "other".
+enum class CommandKind { TurnOffTx, TurnOnTx, SendHdr, SendCfg1, SendCfg2, SendCfg3, Extended, Other, Count };
+
+inline CommandKind command_kind(uint16_t command) {
+    switch (command) {
+    case CMD_TURN_OFF_TX: return CommandKind::TurnOffTx;
+    case CMD_TURN_ON_TX: return CommandKind::TurnOnTx;
+    case CMD_SEND_HDR: return CommandKind::SendHdr;
+    case CMD_SEND_CFG1: return CommandKind::SendCfg1;
+    case CMD_SEND_CFG2: return CommandKind::SendCfg2;
+    case 0x0006: return CommandKind::SendCfg3;
+    case 0x0008: return CommandKind::Extended;
+    default: return CommandKind::Other;
+    }
+}
+
+// Everything one thread counts; aligned so shards never share a line.
+struct alignas(64) MetricsShard {
+    explicit MetricsShard(size_t pmuCount) : pmuFrames(new MetricCounter[pmuCount]) {}
+
+    std::unique_ptr<MetricCounter[]> pmuFrames;  // Per PMU index, frames handed to subscribers
+    std::array<MetricCounter, size_t(Transport::Count)> bytesSent;
+    std::array<MetricHistogram, size_t(Transport::Count)> sendLatency;  // One send call
+    MetricCounter sendErrors;
+    MetricHistogram jitter;                      // Tick sent after its nominal instant
+    std::array<MetricCounter, size_t(CommandKind::Count)> commands;
+    MetricCounter crcFailures;                   // Received command frames with a bad CHK
+    MetricCounter framesShed;                    // Dropped from client queues (--overload)
+    MetricCounter overloadDisconnects;
+};
+
+struct ClientBacklog {
+    std::string peer;
+    uint64_t bytes = 0;
+    uint64_t frames = 0;  // Data frames queued
+    uint64_t shed = 0;    // Data frames shed since it connected
+};
+
+class SimMetrics
+{
+public:
+    explicit SimMetrics(std::vector<uint16_t> pmuIdCodes) : idCodes(std::move(pmuIdCodes)) {}
+    ~SimMetrics() { stop(); }
+
+    SimMetrics(const SimMetrics&) = delete;
+    SimMetrics& operator=(const SimMetrics&) = delete;
+
+    // A shard for the calling thread; all shards are added before start().
+    MetricsShard& addShard() {
+        shards.push_back(std::make_unique<MetricsShard>(idCodes.size()));
+        return *shards.back();
+    }
+
+    void publishClients(std::vector<ClientBacklog>& clients) {
+        std::lock_guard<std::mutex> lock(clientMutex);
+        clientBacklog.swap(clients);
+    }
+
+    // Listens on 127.0.0.1:port and serves scrapes on a new thread.
+    bool start(uint16_t port) {
+        listenSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if (listenSocket == INVALID_SOCKET) return false;
+#ifndef _WIN32
+        int reuse = 1;
+        setsockopt(listenSocket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+#endif
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = htons(port);
+        if (bind(listenSocket, (struct sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR ||
+            listen(listenSocket, 16) == SOCKET_ERROR || !set_nonblocking(listenSocket, true) ||
+            !poller.valid() || !poller.add(listenSocket)) {
+            closesocket(listenSocket);
+            listenSocket = INVALID_SOCKET;
+            return false;
+        }
+        stopping.store(false);
+        server = std::thread([this]() { serve(); });
+        return true;
+    }
+
+    void stop() {
+        if (!server.joinable()) return;
+        stopping.store(true);
+        server.join();
+        closesocket(listenSocket);
+        listenSocket = INVALID_SOCKET;
+    }
+
+    // Exposition text of the sum of all shards.
+    std::string render() const {
+        std::string out;
+        out.reserve(4096 + idCodes.size() * 48);
+
+        header(out, "pmu_sim_frames_sent_total", "counter",
+               "Data frames of each PMU queued for TCP subscribers or sent to UDP destinations.");
+        for (size_t i = 0; i < idCodes.size(); ++i) {
+            uint64_t n = 0;
+            for (const auto& shard : shards) n += shard->pmuFrames[i].get();
+            appendf(out, "pmu_sim_frames_sent_total{idcode=\"%u\"} %llu\n", idCodes[i], ull(n));
+        }
+
+        header(out, "pmu_sim_bytes_sent_total", "counter", "Bytes written to data sockets.");
+        for (size_t t = 0; t < size_t(Transport::Count); ++t) {
+            uint64_t n = 0;
+            for (const auto& shard : shards) n += shard->bytesSent[t].get();
+            appendf(out, "pmu_sim_bytes_sent_total{transport=\"%s\"} %llu\n", TRANSPORT_NAMES[t], ull(n));
+        }
+
+        header(out, "pmu_sim_send_errors_total", "counter", "Sends that failed and dropped the client.");
+        appendf(out, "pmu_sim_send_errors_total %llu\n", ull(sum(&MetricsShard::sendErrors)));
+
+        header(out, "pmu_sim_send_seconds", "histogram",
+               "Duration of one send call: a client's gather write, or one UDP flush.");
+        for (size_t t = 0; t < size_t(Transport::Count); ++t) {
+            std::string labels = std::string("transport=\"") + TRANSPORT_NAMES[t] + "\"";
+            histogram(out, "pmu_sim_send_seconds", labels, [t](const MetricsShard& s) -> const MetricHistogram& {
+                return s.sendLatency[t];
+            });
+        }
+
+        header(out, "pmu_sim_schedule_jitter_seconds", "histogram",
+               "Delay of each reporting tick after its nominal instant.");
+        histogram(out, "pmu_sim_schedule_jitter_seconds", "",
+                  [](const MetricsShard& s) -> const MetricHistogram& { return s.jitter; });
+
+        header(out, "pmu_sim_commands_total", "counter", "Command frames received, by command.");
+        for (size_t c = 0; c < size_t(CommandKind::Count); ++c) {
+            uint64_t n = 0;
+            for (const auto& shard : shards) n += shard->commands[c].get();
+            appendf(out, "pmu_sim_commands_total{command=\"%s\"} %llu\n", COMMAND_NAMES[c], ull(n));
+        }
+
+        header(out, "pmu_sim_crc_failures_total", "counter", "Received frames discarded for a bad CHK.");
+        appendf(out, "pmu_sim_crc_failures_total %llu\n", ull(sum(&MetricsShard::crcFailures)));
+
+        header(out, "pmu_sim_frames_shed_total", "counter", "Data frames dropped from the queues of slow clients.");
+        appendf(out, "pmu_sim_frames_shed_total %llu\n", ull(sum(&MetricsShard::framesShed)));
+        header(out, "pmu_sim_overload_disconnects_total", "counter", "Clients disconnected for falling behind.");
+        appendf(out, "pmu_sim_overload_disconnects_total %llu\n", ull(sum(&MetricsShard::overloadDisconnects)));
+
+        std::lock_guard<std::mutex> lock(clientMutex);
+        header(out, "pmu_sim_clients", "gauge", "Connected TCP clients.");
+        appendf(out, "pmu_sim_clients %zu\n", clientBacklog.size());
+        header(out, "pmu_sim_client_backlog_bytes", "gauge", "Bytes queued for a TCP client and not yet sent.");
+        for (const ClientBacklog& c : clientBacklog)
+            appendf(out, "pmu_sim_client_backlog_bytes{peer=\"%s\"} %llu\n", c.peer.c_str(), ull(c.bytes));
+        header(out, "pmu_sim_client_backlog_frames", "gauge", "Data frames queued for a TCP client.");
+        for (const ClientBacklog& c : clientBacklog)
+            appendf(out, "pmu_sim_client_backlog_frames{peer=\"%s\"} %llu\n", c.peer.c_str(), ull(c.frames));
+        header(out, "pmu_sim_client_frames_shed", "gauge", "Data frames shed from a TCP client's queue since it connected.");
+        for (const ClientBacklog& c : clientBacklog)
+            appendf(out, "pmu_sim_client_frames_shed{peer=\"%s\"} %llu\n", c.peer.c_str(), ull(c.shed));
+        return out;
+    }
+
+private:
+    static constexpr const char* TRANSPORT_NAMES[] = {"tcp", "udp"};
+    static constexpr const char* COMMAND_NAMES[] = {"turn_off_tx", "turn_on_tx", "send_hdr", "send_cfg1",
+                                                    "send_cfg2", "send_cfg3", "extended", "other"};
+    static const size_t MAX_REQUEST = 8192;
+
+    static unsigned long long ull(uint64_t v) { return static_cast<unsigned long long>(v); }
+
+    template <typename... Args>
+    static void appendf(std::string& out, const char* format, Args... args) {
+        char line[256];
+        int n = std::snprintf(line, sizeof(line), format, args...);
+        if (n > 0) out.append(line, std::min(static_cast<size_t>(n), sizeof(line) - 1));
+    }
+
+    static void header(std::string& out, const char* name, const char* type, const char* help) {
+        appendf(out, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+    }
+
+    uint64_t sum(MetricCounter MetricsShard::*counter) const {
+        uint64_t n = 0;
+        for (const auto& shard : shards) n += ((*shard).*counter).get();
+        return n;
+    }
+
+    template <typename Select>
+    void histogram(std::string& out, const char* name, const std::string& labels, Select select) const {
+        std::string sep = labels.empty() ? "" : ",";
+        uint64_t cumulative = 0;
+        uint64_t sumNs = 0;
+        for (size_t b = 0; b < MetricHistogram::BUCKETS; ++b) {
+            for (const auto& shard : shards) cumulative += select(*shard).bucket(b);
+            if (b < MetricHistogram::BOUNDS_US.size())
+                appendf(out, "%s_bucket{%s%sle=\"%g\"} %llu\n", name, labels.c_str(), sep.c_str(),
+                        MetricHistogram::BOUNDS_US[b] / 1e6, ull(cumulative));
+            else
+                appendf(out, "%s_bucket{%s%sle=\"+Inf\"} %llu\n", name, labels.c_str(), sep.c_str(), ull(cumulative));
+        }
+        for (const auto& shard : shards) sumNs += select(*shard).sum();
+        std::string braces = labels.empty() ? "" : "{" + labels + "}";
+        appendf(out, "%s_sum%s %.9f\n", name, braces.c_str(), sumNs / 1e9);
+        appendf(out, "%s_count%s %llu\n", name, braces.c_str(), ull(cumulative));
+    }
+
+    void serve() {
+        std::vector<PollEvent> events;
+        while (!stopping.load()) {
+            if (poller.wait(events, 200) < 0) return;
+            if (!events.empty()) acceptScrapes();
+        }
+    }
+
+    // Answers each pending connection in turn; scrapes are rare and local.
+    void acceptScrapes() {
+        while (true) {
+            SOCKET s = accept(listenSocket, nullptr, nullptr);
+            if (s == INVALID_SOCKET) return;
+            set_nonblocking(s, false);
+#ifdef _WIN32
+            DWORD timeout = 2000;
+#else
+            timeval timeout{2, 0};
+#endif
+            setsockopt(s, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&timeout), sizeof(timeout));
+            setsockopt(s, SOL_SOCKET, SO_SNDTIMEO, reinterpret_cast<const char*>(&timeout), sizeof(timeout));
+            answer(s);
+            closesocket(s);
+        }
+    }
+
+    void answer(SOCKET s) const {
+        std::string request;
+        char buffer[1024];
+        while (request.find("\r\n\r\n") == std::string::npos && request.size() < MAX_REQUEST) {
+            int n = recv(s, buffer, sizeof(buffer), 0);
+            if (n <= 0) return;
+            request.append(buffer, static_cast<size_t>(n));
+        }
+        bool metrics = request.compare(0, 13, "GET /metrics ") == 0 || request.compare(0, 6, "GET / ") == 0;
+        std::string body = metrics ? render() : "Not found; metrics are at /metrics\n";
+        std::string response = std::string(metrics ? "HTTP/1.1 200 OK\r\n" : "HTTP/1.1 404 Not Found\r\n") +
+                               "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+                               "Content-Length: " + std::to_string(body.size()) + "\r\n"
+                               "Connection: close\r\n\r\n" + body;
+        size_t sent = 0;
+        while (sent < response.size()) {
+            int n = send(s, response.data() + sent, static_cast<int>(response.size() - sent), MSG_NOSIGNAL);
+            if (n <= 0) return;
+            sent += static_cast<size_t>(n);
+        }
+    }
+
+    std::vector<uint16_t> idCodes;
+    std::vector<std::unique_ptr<MetricsShard>> shards;
+    mutable std::mutex clientMutex;
+    std::vector<ClientBacklog> clientBacklog;
+    SOCKET listenSocket = INVALID_SOCKET;
+    SocketPoller poller;
+    std::thread server;
+    std::atomic<bool> stopping{false};
+};
+
+#endif // SIM_METRICS_H
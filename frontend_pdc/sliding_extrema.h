@@ -0,0 +1,84 @@
+#ifndef SLIDING_EXTREMA_H
+#define SLIDING_EXTREMA_H
+
+// Min and max of the last N values of a stream in O(1) amortized per value.
+//
+// Two monotonic queues hold the candidates: values that can still become the
+// window minimum (ascending) or maximum (descending). A new value evicts every
+// candidate it dominates from the back, and candidates that slid out of the
+// window leave from the front, so the fronts are always the window extrema.
+// The queues are fixed rings of N entries; nothing is allocated per value.
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class SlidingExtrema
+{
+public:
+    // Empties the window and sets its length in values.
+    void reset(size_t window) {
+        span = window > 0 ? window : 1;
+        lows.reset(span);
+        highs.reset(span);
+        pushed = 0;
+    }
+
+    void push(double v) {
+        uint64_t expired = pushed >= span ? pushed - span + 1 : 0;
+        lows.push(pushed, v, expired, [](double kept, double in) { return kept < in; });
+        highs.push(pushed, v, expired, [](double kept, double in) { return kept > in; });
+        ++pushed;
+    }
+
+    size_t window() const { return span; }
+    // True once a full window of values has been pushed.
+    bool full() const { return pushed >= span; }
+    bool empty() const { return pushed == 0; }
+    double min() const { return lows.front(); }
+    double max() const { return highs.front(); }
+
+private:
+    class MonotonicQueue
+    {
+    public:
+        void reset(size_t capacity) {
+            entries.assign(capacity, Entry());
+            head = size = 0;
+        }
+
+        // keeps(kept, in): whether a queued value survives the arrival of in.
+        template <typename Keeps>
+        void push(uint64_t index, double v, uint64_t expired, Keeps keeps) {
+            while (size > 0 && entries[head].index < expired) pop_front();
+            while (size > 0 && !keeps(back().value, v)) --size;
+            entries[(head + size) % entries.size()] = {index, v};
+            ++size;
+        }
+
+        double front() const { return entries[head].value; }
+
+    private:
+        struct Entry {
+            uint64_t index = 0;
+            double value = 0.0;
+        };
+
+        const Entry& back() const { return entries[(head + size - 1) % entries.size()]; }
+        void pop_front() {
+            head = (head + 1) % entries.size();
+            --size;
+        }
+
+        std::vector<Entry> entries;
+        size_t head = 0;
+        size_t size = 0;
+    };
+
+    size_t span = 1;
+    uint64_t pushed = 0;
+    MonotonicQueue lows;
+    MonotonicQueue highs;
+};
+
+#endif // SLIDING_EXTREMA_H
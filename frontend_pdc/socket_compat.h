@@ -0,0 +1,131 @@
+#ifndef SOCKET_COMPAT_H
+#define SOCKET_COMPAT_H
+
+// Minimal BSD socket / Winsock portability layer for the PMU simulator.
+// Code is written against the Winsock names (SOCKET, INVALID_SOCKET,
+// closesocket, ...) which are mapped onto POSIX on other platforms.
+
+#ifdef _WIN32
+#define _WINSOCK_DEPRECATED_NO_WARNINGS
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "ws2_32.lib")
+
+using socklen_t = int;
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+inline int socket_last_error() { return WSAGetLastError(); }
+inline bool socket_would_block(int err) { return err == WSAEWOULDBLOCK; }
+
+inline bool socket_startup() {
+    WSADATA wsaData;
+    return WSAStartup(MAKEWORD(2, 2), &wsaData) == 0;
+}
+
+inline void socket_cleanup() { WSACleanup(); }
+
+// One buffer of a gather send.
+using IoSlice = WSABUF;
+
+inline void set_io_slice(IoSlice& slice, const void* data, size_t len) {
+    slice.buf = static_cast<char*>(const_cast<void*>(data));
+    slice.len = static_cast<ULONG>(len);
+}
+
+// Sends the slices in order. A non-blocking socket stops at the first
+// would-block. Returns the bytes sent or SOCKET_ERROR.
+inline long long send_gather(SOCKET s, IoSlice* slices, size_t count) {
+    DWORD sent = 0;
+    if (WSASend(s, slices, static_cast<DWORD>(count), &sent, 0, nullptr, nullptr) != 0)
+        return socket_would_block(WSAGetLastError()) ? 0 : SOCKET_ERROR;
+    return sent;
+}
+
+inline bool set_nonblocking(SOCKET s, bool enable) {
+    u_long mode = enable ? 1 : 0;
+    return ioctlsocket(s, FIONBIO, &mode) == 0;
+}
+
+#else
+#include <arpa/inet.h>
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+using SOCKET = int;
+const SOCKET INVALID_SOCKET = -1;
+const int SOCKET_ERROR = -1;
+const int SD_SEND = SHUT_WR;
+
+inline int closesocket(SOCKET s) { return close(s); }
+inline int socket_last_error() { return errno; }
+inline bool socket_would_block(int err) { return err == EAGAIN || err == EWOULDBLOCK; }
+
+inline bool socket_startup() {
+    // A peer closing mid-send must surface as EPIPE, not kill the process.
+    std::signal(SIGPIPE, SIG_IGN);
+    return true;
+}
+
+inline void socket_cleanup() {}
+
+// One buffer of a gather send.
+using IoSlice = iovec;
+
+inline void set_io_slice(IoSlice& slice, const void* data, size_t len) {
+    slice.iov_base = const_cast<void*>(data);
+    slice.iov_len = len;
+}
+
+// Sends the slices in order, IOV_MAX at a time, resuming after partial
+// writes. A non-blocking socket stops at the first would-block, with the
+// slices advanced past what went out. Returns the bytes sent or SOCKET_ERROR.
+inline long long send_gather(SOCKET s, IoSlice* slices, size_t count) {
+    const size_t MAX_SLICES = 1024;
+    long long total = 0;
+    while (count > 0) {
+        msghdr msg{};
+        msg.msg_iov = slices;
+        msg.msg_iovlen = count < MAX_SLICES ? count : MAX_SLICES;
+        ssize_t n = sendmsg(s, &msg, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return socket_would_block(errno) ? total : SOCKET_ERROR;
+        }
+        total += n;
+        size_t left = static_cast<size_t>(n);
+        while (count > 0 && left >= slices->iov_len) {
+            left -= slices->iov_len;
+            ++slices;
+            --count;
+        }
+        if (left > 0) {
+            slices->iov_base = static_cast<char*>(slices->iov_base) + left;
+            slices->iov_len -= left;
+        }
+    }
+    return total;
+}
+
+inline bool set_nonblocking(SOCKET s, bool enable) {
+    int flags = fcntl(s, F_GETFL, 0);
+    if (flags < 0) return false;
+    flags = enable ? (flags | O_NONBLOCK) : (flags & ~O_NONBLOCK);
+    return fcntl(s, F_SETFL, flags) == 0;
+}
+#endif
+
+inline bool set_tcp_nodelay(SOCKET s, bool enable) {
+    int flag = enable ? 1 : 0;
+    return setsockopt(s, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&flag), sizeof(flag)) == 0;
+}
+
+#endif // SOCKET_COMPAT_H
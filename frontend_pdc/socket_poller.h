@@ -0,0 +1,158 @@
+#ifndef SOCKET_POLLER_H
+#define SOCKET_POLLER_H
+
+// Readiness notification for the PMU server. Linux uses epoll, so the cost of
+// a wait is proportional to the number of ready sockets rather than the number
+// of connected clients. Other platforms fall back to poll()/WSAPoll().
+
+#include <cstdint>
+#include <vector>
+
+#include "socket_compat.h"
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#elif !defined(_WIN32)
+#include <poll.h>
+#endif
+
+struct PollEvent {
+    SOCKET sock = INVALID_SOCKET;
+    bool readable = false;
+    bool writable = false;
+    bool hangup = false;  // Peer closed or socket error
+};
+
+class SocketPoller
+{
+public:
+    SocketPoller() {
+#ifdef __linux__
+        epollFd = epoll_create1(EPOLL_CLOEXEC);
+#endif
+    }
+
+    ~SocketPoller() {
+#ifdef __linux__
+        if (epollFd >= 0) close(epollFd);
+#endif
+    }
+
+    SocketPoller(const SocketPoller&) = delete;
+    SocketPoller& operator=(const SocketPoller&) = delete;
+
+    bool valid() const {
+#ifdef __linux__
+        return epollFd >= 0;
+#else
+        return true;
+#endif
+    }
+
+    bool add(SOCKET s, bool wantWrite = false) {
+#ifdef __linux__
+        epoll_event ev{};
+        ev.events = epollMask(wantWrite);
+        ev.data.fd = s;
+        return epoll_ctl(epollFd, EPOLL_CTL_ADD, s, &ev) == 0;
+#else
+        pollfd pfd{};
+        pfd.fd = s;
+        pfd.events = pollMask(wantWrite);
+        fds.push_back(pfd);
+        return true;
+#endif
+    }
+
+    bool modify(SOCKET s, bool wantWrite) {
+#ifdef __linux__
+        epoll_event ev{};
+        ev.events = epollMask(wantWrite);
+        ev.data.fd = s;
+        return epoll_ctl(epollFd, EPOLL_CTL_MOD, s, &ev) == 0;
+#else
+        for (auto& pfd : fds) {
+            if (pfd.fd == s) {
+                pfd.events = pollMask(wantWrite);
+                return true;
+            }
+        }
+        return false;
+#endif
+    }
+
+    void remove(SOCKET s) {
+#ifdef __linux__
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, s, nullptr);
+#else
+        for (size_t i = 0; i < fds.size(); ++i) {
+            if (fds[i].fd == s) {
+                fds[i] = fds.back();
+                fds.pop_back();
+                break;
+            }
+        }
+#endif
+    }
+
+    // Waits up to timeoutMs (-1 = forever) and fills `events` with the ready
+    // sockets. Returns the number of events, or -1 on error.
+    int wait(std::vector<PollEvent>& events, int timeoutMs) {
+        events.clear();
+#ifdef __linux__
+        epoll_event ready[MAX_EVENTS];
+        int n = epoll_wait(epollFd, ready, MAX_EVENTS, timeoutMs);
+        if (n < 0) return (errno == EINTR) ? 0 : -1;
+        for (int i = 0; i < n; ++i) {
+            PollEvent ev;
+            ev.sock = ready[i].data.fd;
+            ev.readable = (ready[i].events & EPOLLIN) != 0;
+            ev.writable = (ready[i].events & EPOLLOUT) != 0;
+            ev.hangup = (ready[i].events & (EPOLLHUP | EPOLLERR)) != 0;
+            events.push_back(ev);
+        }
+        return n;
+#else
+        if (fds.empty()) return 0;
+#ifdef _WIN32
+        int n = WSAPoll(fds.data(), static_cast<ULONG>(fds.size()), timeoutMs);
+#else
+        int n = poll(fds.data(), fds.size(), timeoutMs);
+        if (n < 0 && errno == EINTR) return 0;
+#endif
+        if (n <= 0) return n;
+        for (const auto& pfd : fds) {
+            if (pfd.revents == 0) continue;
+            PollEvent ev;
+            ev.sock = pfd.fd;
+            ev.readable = (pfd.revents & POLLIN) != 0;
+            ev.writable = (pfd.revents & POLLOUT) != 0;
+            ev.hangup = (pfd.revents & (POLLHUP | POLLERR | POLLNVAL)) != 0;
+            events.push_back(ev);
+        }
+        return static_cast<int>(events.size());
+#endif
+    }
+
+private:
+#ifdef __linux__
+    static const int MAX_EVENTS = 256;
+
+    static uint32_t epollMask(bool wantWrite) {
+        return EPOLLIN | EPOLLRDHUP | (wantWrite ? EPOLLOUT : 0u);
+    }
+
+    int epollFd = -1;
+#else
+#ifdef _WIN32
+    using pollfd = WSAPOLLFD;
+#endif
+    static short pollMask(bool wantWrite) {
+        return static_cast<short>(POLLIN | (wantWrite ? POLLOUT : 0));
+    }
+
+    std::vector<pollfd> fds;
+#endif
+};
+
+#endif // SOCKET_POLLER_H
@@ -0,0 +1,661 @@
+// Regression tests for the simulator's frames and its header-only building
+// blocks. No framework: every test is a function in TESTS, CHECK records a
+// failure with its line and the program exits with 1 if any check failed.
+//
+// Build: qmake tests.pro && make, or
+//        g++ -std=c++17 -O2 -I.. sim_tests.cpp -o sim_tests -lpthread
+// Run:   ./sim_tests [name-substring]
+
+#include "c37118_decoder.h"
+#include "c37118_framer.h"
+#include "channel_store.h"
+#include "frame_publisher.h"
+#include "frame_scheduler.h"
+#include "sim_frames.h"
+#include "sim_metrics.h"
+#include "sliding_extrema.h"
+#include "time_aligner.h"
+#include "udp_sender.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+int failures = 0;
+
+#define CHECK(cond)                                                                      \
+    do {                                                                                 \
+        if (!(cond)) {                                                                   \
+            std::fprintf(stderr, "  %s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); \
+            ++failures;                                                                  \
+        }                                                                                \
+    } while (0)
+
+std::vector<unsigned char> command_bytes(uint16_t idCode, uint16_t command) {
+    std::vector<unsigned char> frame(COMMAND_FRAME_SIZE);
+    build_command_frame(frame.data(), idCode, command, 1700000000u);
+    return frame;
+}
+
+bool same_frame(const FrameView& view, const std::vector<unsigned char>& frame) {
+    return view.size == frame.size() && std::memcmp(view.data, frame.data(), frame.size()) == 0;
+}
+
+// Frames coalesced in one read come out one by one; a frame split over reads
+// comes out once its last byte is in.
+void framer_coalesced_and_split() {
+    StreamFramer framer(4096);
+    std::vector<unsigned char> a = command_bytes(1, CMD_TURN_ON_TX), b = command_bytes(2, CMD_SEND_CFG2);
+    std::vector<unsigned char> both = a;
+    both.insert(both.end(), b.begin(), b.end());
+    CHECK(framer.append(both.data(), both.size()) == both.size());
+    FrameView frame;
+    CHECK(framer.next(frame) && same_frame(frame, a));
+    CHECK(framer.next(frame) && same_frame(frame, b));
+    CHECK(!framer.next(frame) && framer.buffered() == 0);
+
+    // Received straight into the ring, 7 bytes and then the rest.
+    std::memcpy(framer.writePtr(), a.data(), 7);
+    framer.commit(7);
+    CHECK(!framer.next(frame) && framer.buffered() == 7);
+    std::memcpy(framer.writePtr(), a.data() + 7, a.size() - 7);
+    framer.commit(a.size() - 7);
+    CHECK(framer.next(frame) && same_frame(frame, a));
+    CHECK(framer.framesExtracted() == 3 && framer.bytesSkipped() == 0 && framer.crcErrors() == 0);
+}
+
+// Bytes before SYNC, and a SYNC byte whose frame type is impossible, are
+// skipped until a frame starts.
+void framer_skips_garbage() {
+    StreamFramer framer(4096);
+    std::vector<unsigned char> stream = {0x01, 0x02, SYNC_CMD, 0xFF, 0x03};
+    std::vector<unsigned char> a = command_bytes(1, CMD_TURN_OFF_TX);
+    stream.insert(stream.end(), a.begin(), a.end());
+    framer.append(stream.data(), stream.size());
+    FrameView frame;
+    CHECK(framer.next(frame) && same_frame(frame, a));
+    CHECK(framer.bytesSkipped() == 5 && framer.crcErrors() == 0);
+}
+
+// A bad CHK costs one byte, not the whole claimed frame: a valid frame that
+// starts inside it is still found.
+void framer_bad_chk_skips_one_byte() {
+    StreamFramer framer(4096);
+    std::vector<unsigned char> inner = command_bytes(3, CMD_TURN_ON_TX);
+    std::vector<unsigned char> outer = {SYNC_CMD, TYPE_CMD, 0, 28};
+    outer.insert(outer.end(), inner.begin(), inner.end());
+    outer.resize(26, 0);
+    uint16_t chk = calculate_crc(outer.data(), outer.size()) ^ 0x0101;
+    outer.push_back(static_cast<unsigned char>(chk >> 8));
+    outer.push_back(static_cast<unsigned char>(chk));
+    framer.append(outer.data(), outer.size());
+    FrameView frame;
+    CHECK(framer.next(frame) && same_frame(frame, inner));
+    CHECK(framer.crcErrors() == 1 && framer.bytesSkipped() == 4);
+}
+
+// A frame that wraps around the end of the ring comes out whole.
+void framer_frame_wraps_ring() {
+    StreamFramer framer(64);
+    CHECK(framer.capacity() == 64);
+    std::vector<unsigned char> a = command_bytes(1, CMD_SEND_HDR);
+    FrameView frame;
+    for (int i = 0; i < 3; ++i) {  // 54 of 64 bytes consumed
+        framer.append(a.data(), a.size());
+        CHECK(framer.next(frame) && same_frame(frame, a));
+    }
+    std::vector<unsigned char> b = command_bytes(0xFFFF, CMD_SEND_CFG1);
+    CHECK(framer.writable() == 10);
+    CHECK(framer.append(b.data(), b.size()) == b.size());
+    CHECK(framer.next(frame) && same_frame(frame, b));
+    CHECK(framer.framesExtracted() == 4 && framer.buffered() == 0);
+}
+
+// CFG-2 of a PMU with digital words decodes back to the announced layout.
+void cfg2_digitals_round_trip() {
+    for (uint16_t dgnmr : {0, 1, 3}) {
+        std::vector<unsigned char> frame = create_config_frame2(7, 1000000, 1, "DIGITALS", 50, 3, 2, dgnmr, true, true);
+        CHECK(load_be16(frame.data() + 2) == frame.size());
+        CHECK(calculate_crc(frame.data(), frame.size() - 2) == load_be16(frame.data() + frame.size() - 2));
+
+        ConfigFrame cfg;
+        CHECK(parse_config_frame(frame.data(), frame.size(), cfg));
+        if (cfg.pmus.size() != 1) {
+            CHECK(cfg.pmus.size() == 1);
+            continue;
+        }
+        const PmuBlockConfig& pmu = cfg.pmus[0];
+        CHECK(pmu.idCode == 7);
+        CHECK(pmu.stationName == "DIGITALS");
+        CHECK(pmu.phasorNames.size() == 3 && pmu.analogNames.size() == 2);
+        CHECK(pmu.digitalNames.size() == 16u * dgnmr);
+        if (dgnmr > 0) {
+            CHECK(pmu.digitalNames.front() == "Digital 1.0");
+            CHECK(pmu.digitalNames.back() == "Digital " + std::to_string(dgnmr) + ".15");
+        }
+        CHECK(pmu.nominalFreq == 50.0f);
+        CHECK(cfg.dataRate == 50);
+    }
+}
+
+// Without a pollable timer descriptor the deadline is kept with the poll
+// timeout instead of blocking the poller forever.
+void deadline_timer_without_descriptor() {
+    DeadlineTimer timer;
+    timer.releaseHandle();
+    CHECK(timer.handle() == INVALID_SOCKET);
+    CHECK(timer.pollTimeoutMs(realtime_ns()) == -1);  // Disarmed
+
+    int64_t now = realtime_ns();
+    timer.arm(now + 250000000);
+    int timeout = timer.pollTimeoutMs(now);
+    CHECK(timeout >= 249 && timeout <= 250);
+    timer.arm(now - 1000);
+    CHECK(timer.pollTimeoutMs(now) == 0);
+    timer.disarm();
+    CHECK(timer.pollTimeoutMs(now) == -1);
+}
+
+// A tick published in place is queued by reference into the caller's
+// storage, frame by frame when its frames are not back to back.
+void publish_in_place_references_storage() {
+    std::vector<unsigned char> storage(400);
+    for (size_t i = 0; i < storage.size(); ++i) storage[i] = static_cast<unsigned char>(i);
+    const unsigned char* base = storage.data();
+    std::vector<EncodedFrame> gapped = {{base + 16, 40, 0}, {base + 72, 50, 1}};  // Record headers between
+    std::vector<EncodedFrame> packed = {{base + 200, 40, 0}, {base + 240, 50, 1}};
+
+    FramePublisher publisher;
+    FrameQueue all, second;
+    std::vector<char> both = {1, 1}, one = {0, 1};
+    std::vector<IoSlice> slices;
+
+    publisher.publishInPlace(gapped, base, storage.size());
+    publisher.enqueueTick(all, both, 2);
+    publisher.enqueueTick(second, one, 1);
+    CHECK(all.bytes() == 90 && all.frames() == 2 && all.rangeCount() == 2);
+    CHECK(second.bytes() == 50 && second.frames() == 1);
+    CHECK(all.gather(slices) == 2);
+#ifdef _WIN32
+    CHECK(reinterpret_cast<const unsigned char*>(slices[1].buf) == base + 72);
+#else
+    CHECK(static_cast<const unsigned char*>(slices[1].iov_base) == base + 72);
+#endif
+
+    publisher.publishInPlace(packed, base, storage.size());
+    publisher.enqueueTick(all, both, 2);
+    CHECK(all.bytes() == 180 && all.rangeCount() == 3);  // One range for the packed tick
+    CHECK(all.dropNewest(publisher.tick()) == 2 && all.bytes() == 90);
+
+    // A copied tick after in-place ones owns its bytes again.
+    unsigned char copied[30] = {7};
+    publisher.publish({{copied, 30, 0}});
+    CHECK(publisher.tick().data()[0] == 7 && publisher.tick().size() == 30);
+    all.consume(90);
+    second.consume(50);
+    CHECK(all.empty() && second.empty());
+}
+
+// A CFG-2 handed out late carries the time it was asked for, with a valid
+// CHK, and leaves the shared encoding untouched.
+void config_frame_restamped() {
+    FramePublisher publisher;
+    publisher.setConfigFrames({create_config_frame2(9, 1000000, 1, "STAMP", 50, 2, 1, 1, true, true)});
+    const FrameRef& shared = publisher.configFrame(0);
+    std::vector<unsigned char> original(shared.data(), shared.data() + shared.size());
+
+    FrameRef stamped = publisher.configFrameAt(0, 2000000000u, 0xAB123456u);
+    CHECK(stamped.size() == original.size());
+    CHECK(load_be32(stamped.data() + 6) == 2000000000u);
+    CHECK(load_be32(stamped.data() + 10) == 0x00123456u);  // Time quality cleared
+    CHECK(calculate_crc(stamped.data(), stamped.size() - 2) == load_be16(stamped.data() + stamped.size() - 2));
+    CHECK(std::memcmp(stamped.data() + 14, original.data() + 14, original.size() - 16) == 0);
+    CHECK(std::memcmp(shared.data(), original.data(), original.size()) == 0);
+
+    ConfigFrame cfg;
+    CHECK(parse_config_frame(stamped.data(), stamped.size(), cfg) && cfg.pmus.size() == 1);
+}
+
+// Commands are counted by the CMD word received, before processCommandFrame()
+// turns every unknown one into SEND_CFG2.
+void command_kinds_from_received_word() {
+    std::vector<VirtualPmuConfig> pmus(1);
+    pmus[0].idCode = 1;
+    PmuSimEngine engine(pmus, 0, false);
+    pmuLogger.setLevel(LogLevel::Off);
+
+    const struct {
+        uint16_t code;
+        CommandKind kind;
+        uint16_t processed;
+    } cases[] = {
+        {CMD_TURN_OFF_TX, CommandKind::TurnOffTx, CMD_TURN_OFF_TX},
+        {CMD_TURN_ON_TX, CommandKind::TurnOnTx, CMD_TURN_ON_TX},
+        {CMD_SEND_HDR, CommandKind::SendHdr, CMD_SEND_HDR},
+        {CMD_SEND_CFG1, CommandKind::SendCfg1, CMD_SEND_CFG1},
+        {CMD_SEND_CFG2, CommandKind::SendCfg2, CMD_SEND_CFG2},
+        {0x0006, CommandKind::SendCfg3, CMD_SEND_CFG2},
+        {0x0008, CommandKind::Extended, CMD_SEND_CFG2},
+        {0x1234, CommandKind::Other, CMD_SEND_CFG2},
+    };
+    for (const auto& c : cases) {
+        unsigned char frame[COMMAND_FRAME_SIZE];
+        build_command_frame(frame, 1, c.code, 1700000000u);
+        CHECK(command_kind(command_code(frame, sizeof(frame))) == c.kind);
+
+        uint16_t pmuId = 0, command = 0;
+        CHECK(processCommandFrame(frame, sizeof(frame), engine, pmuId, command));
+        CHECK(pmuId == 1 && command == c.processed);
+
+        // Compact 10-byte frame: CMD right after IDCODE.
+        unsigned char compact[10] = {SYNC_CMD, TYPE_CMD, 0, 10, 0, 1};
+        store_be16(compact + 6, c.code);
+        store_be16(compact + 8, calculate_crc(compact, 8));
+        CHECK(command_kind(command_code(compact, sizeof(compact))) == c.kind);
+    }
+    pmuLogger.setLevel(LogLevel::Info);
+}
+
+// A command for an IDCODE this process does not host, or one that is not a
+// command frame, is rejected instead of being answered for every PMU.
+void commands_for_unhosted_pmu_rejected() {
+    std::vector<VirtualPmuConfig> pmus(3);
+    for (size_t i = 0; i < pmus.size(); ++i) pmus[i].idCode = static_cast<uint16_t>(i + 1);
+    PmuSimEngine engine(pmus, 0, false);
+    pmuLogger.setLevel(LogLevel::Off);
+
+    unsigned char frame[COMMAND_FRAME_SIZE];
+    uint16_t pmuId = 0, command = 0;
+    build_command_frame(frame, 2, CMD_TURN_ON_TX, 1700000000u);
+    CHECK(processCommandFrame(frame, sizeof(frame), engine, pmuId, command));
+    CHECK(pmuId == 2 && command == CMD_TURN_ON_TX);
+    build_command_frame(frame, 0xFFFF, CMD_SEND_CFG2, 1700000000u);
+    CHECK(processCommandFrame(frame, sizeof(frame), engine, pmuId, command));
+    CHECK(pmuId == 0xFFFF && command == CMD_SEND_CFG2);
+
+    for (uint16_t code : {CMD_TURN_OFF_TX, CMD_TURN_ON_TX, CMD_SEND_CFG2, uint16_t(0x1234)}) {
+        build_command_frame(frame, 42, code, 1700000000u);
+        CHECK(!processCommandFrame(frame, sizeof(frame), engine, pmuId, command));
+        CHECK(command == 0);
+    }
+    build_command_frame(frame, 1, CMD_TURN_ON_TX, 1700000000u);
+    frame[1] = 0x01;  // Data frame type
+    CHECK(!processCommandFrame(frame, sizeof(frame), engine, pmuId, command));
+    pmuLogger.setLevel(LogLevel::Info);
+}
+
+// A UDP destination given a PMU selection only receives those PMUs' frames;
+// one without a selection receives all of them.
+void udp_destinations_get_their_pmus() {
+    UdpDataSender sender;
+    CHECK(sender.open(0, 1));
+    SOCKET some = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP), all = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    sockaddr_in someAddr{}, allAddr{};
+    for (auto* entry : {&someAddr, &allAddr}) {
+        entry->sin_family = AF_INET;
+        entry->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    }
+    CHECK(bind(some, (struct sockaddr*)&someAddr, sizeof(someAddr)) == 0);
+    CHECK(bind(all, (struct sockaddr*)&allAddr, sizeof(allAddr)) == 0);
+    socklen_t len = sizeof(someAddr);
+    getsockname(some, (struct sockaddr*)&someAddr, &len);
+    len = sizeof(allAddr);
+    getsockname(all, (struct sockaddr*)&allAddr, &len);
+    set_nonblocking(some, true);
+    set_nonblocking(all, true);
+
+    sender.addDestination(someAddr, {0, 1, 0});
+    sender.addDestination(allAddr);
+    unsigned char frames[3][20];
+    for (unsigned char i = 0; i < 3; ++i) {
+        std::memset(frames[i], i, sizeof(frames[i]));
+        sender.queue(frames[i], sizeof(frames[i]), i);
+    }
+    CHECK(sender.flush() == 4);
+    CHECK(sender.flushedBytes() == 80);
+
+    auto received = [](SOCKET sock) {
+        std::string tags;
+        unsigned char buf[64];
+        while (recv(sock, (char*)buf, sizeof(buf), 0) == 20) tags += char('0' + buf[0]);
+        return tags;
+    };
+    CHECK(received(some) == "1");
+    CHECK(received(all) == "012");
+
+    sender.addDestination(someAddr, {1, 0, 1});  // New selection replaces the old one
+    sender.removeDestination(allAddr);
+    for (unsigned char i = 0; i < 3; ++i) sender.queue(frames[i], sizeof(frames[i]), i);
+    CHECK(sender.flush() == 2 && sender.destinationCount() == 1);
+    CHECK(received(some) == "02");
+    closesocket(some);
+    closesocket(all);
+}
+
+// A reader slightly slower than the ticks never drains its queue; the ranges
+// it has been sent must still be reclaimed.
+void lagging_reader_queue_stays_bounded() {
+    unsigned char a[90] = {0}, b[90] = {0};
+    std::vector<EncodedFrame> frames = {{a, 90, 0}, {b, 90, 1}};
+    std::vector<char> both = {1, 1};
+    FramePublisher publisher;
+    FrameQueue queue;
+    size_t maxHeld = 0;
+    for (int tick = 0; tick < 200000; ++tick) {
+        publisher.publish(frames);
+        publisher.enqueueTick(queue, both, 2);
+        queue.dropOldest(600, publisher.tick());
+        queue.consume(std::min<size_t>(170, queue.bytes()));
+        maxHeld = std::max(maxHeld, queue.capacityRanges());
+        if (queue.empty()) break;
+    }
+    CHECK(!queue.empty());
+    CHECK(queue.bytes() <= 600 + 180);
+    CHECK(maxHeld <= 2 * 64 + 16);
+    CHECK(publisher.bufferCount() < 16);  // Sent ticks went back to the pool
+}
+
+// TimeAligner rows as drain() hands them out.
+struct AlignedRow {
+    uint64_t index;
+    std::vector<double> values;
+    size_t reported;
+};
+
+std::vector<AlignedRow> drain_rows(TimeAligner& aligner, int64_t nowNs) {
+    std::vector<AlignedRow> rows;
+    aligner.drain(nowNs, [&](double seconds, const double* row, size_t reported) {
+        uint64_t index = static_cast<uint64_t>(seconds * aligner.framesPerSecond() + 0.5);
+        rows.push_back({index, std::vector<double>(row, row + aligner.rowWidth()), reported});
+    });
+    return rows;
+}
+
+// Every column of PMU pmu's block carries index * 100 + pmu.
+TimeAligner::Insert report(TimeAligner& aligner, size_t pmu, size_t width, uint64_t index, int64_t nowNs) {
+    return aligner.insert(pmu, index, nowNs, [&](double* block) {
+        for (size_t c = 0; c < width; ++c) block[c] = double(index * 100 + pmu);
+    });
+}
+
+const uint64_t ALIGN_START = 1700000000ull * 50;
+const int64_t ALIGN_WAIT_NS = 100000000;
+
+// Rows come out complete and in frame order, however the reports arrive.
+void time_aligner_rows_in_order() {
+    const std::vector<size_t> widths = {1, 2, 1};
+    TimeAligner aligner(widths, 50, ALIGN_WAIT_NS);
+    CHECK(aligner.rowWidth() == 4);
+
+    // Frame 1 completes before frame 0.
+    for (size_t pmu : {2, 0, 1})
+        CHECK(report(aligner, pmu, widths[pmu], ALIGN_START + 1, 0) == TimeAligner::Insert::Accepted);
+    CHECK(report(aligner, 1, widths[1], ALIGN_START, 0) == TimeAligner::Insert::Accepted);
+    CHECK(report(aligner, 0, widths[0], ALIGN_START, 0) == TimeAligner::Insert::Accepted);
+    CHECK(report(aligner, 0, widths[0], ALIGN_START, 0) == TimeAligner::Insert::Duplicate);
+    CHECK(drain_rows(aligner, 1000).empty());
+
+    CHECK(report(aligner, 2, widths[2], ALIGN_START, 0) == TimeAligner::Insert::Accepted);
+    for (uint64_t k = ALIGN_START + 2; k < ALIGN_START + 10; ++k)
+        for (size_t pmu = 0; pmu < widths.size(); ++pmu) report(aligner, pmu, widths[pmu], k, 0);
+    std::vector<AlignedRow> rows = drain_rows(aligner, 1000);
+    CHECK(rows.size() == 10);
+    for (size_t r = 0; r < rows.size(); ++r) {
+        uint64_t k = ALIGN_START + r;
+        CHECK(rows[r].index == k && rows[r].reported == 3);
+        CHECK(rows[r].values == std::vector<double>({k * 100.0, k * 100.0 + 1, k * 100.0 + 1, k * 100.0 + 2}));
+    }
+    CHECK(aligner.completeFrames() == 10 && aligner.partialFrames() == 0);
+    CHECK(aligner.pmuStats(0).received.load() == 10 && aligner.pmuStats(0).duplicate.load() == 1);
+    for (size_t pmu = 0; pmu < widths.size(); ++pmu) CHECK(aligner.pmuStats(pmu).missing.load() == 0);
+}
+
+// A report of a frame already emitted is counted as late, not emitted again.
+void time_aligner_late_report() {
+    TimeAligner aligner({1, 1}, 50, ALIGN_WAIT_NS);
+    for (uint64_t k = ALIGN_START; k < ALIGN_START + 3; ++k) {
+        report(aligner, 0, 1, k, 0);
+        report(aligner, 1, 1, k, 0);
+    }
+    CHECK(drain_rows(aligner, 0).size() == 3);
+    CHECK(report(aligner, 1, 1, ALIGN_START + 1, 0) == TimeAligner::Insert::Late);
+    CHECK(report(aligner, 1, 1, ALIGN_START - 100, 0) == TimeAligner::Insert::Late);  // Before the window
+    CHECK(aligner.pmuStats(1).late.load() == 2 && aligner.pmuStats(0).late.load() == 0);
+    CHECK(drain_rows(aligner, 0).empty());
+}
+
+// A frame a PMU never reports goes out once the wait has passed since its
+// first report, with that PMU's previous values and counted as missing.
+void time_aligner_wait_timeout() {
+    TimeAligner aligner({1, 1, 1}, 50, ALIGN_WAIT_NS);
+    for (size_t pmu = 0; pmu < 3; ++pmu) report(aligner, pmu, 1, ALIGN_START, 0);
+    CHECK(drain_rows(aligner, 0).size() == 1);
+
+    report(aligner, 0, 1, ALIGN_START + 1, 1000);
+    report(aligner, 2, 1, ALIGN_START + 1, 5000);
+    CHECK(drain_rows(aligner, 1000 + ALIGN_WAIT_NS - 1).empty());
+    std::vector<AlignedRow> rows = drain_rows(aligner, 1000 + ALIGN_WAIT_NS);
+    CHECK(rows.size() == 1);
+    if (rows.size() == 1) {
+        uint64_t k = ALIGN_START + 1;
+        CHECK(rows[0].index == k && rows[0].reported == 2);
+        CHECK(rows[0].values == std::vector<double>({k * 100.0, (k - 1) * 100.0 + 1, k * 100.0 + 2}));
+    }
+    CHECK(aligner.partialFrames() == 1 && aligner.completeFrames() == 1);
+    CHECK(aligner.pmuStats(1).missing.load() == 1 && aligner.pmuStats(0).missing.load() == 0);
+    CHECK(aligner.maxLatencyNs() == ALIGN_WAIT_NS);
+    CHECK(report(aligner, 1, 1, ALIGN_START + 1, 0) == TimeAligner::Insert::Late);
+}
+
+// A report far beyond the window is dropped as early but moves the window up
+// to it, so the reports of that time are accepted from then on.
+void time_aligner_window_jump() {
+    TimeAligner aligner({1, 1}, 50, ALIGN_WAIT_NS);
+    for (size_t pmu = 0; pmu < 2; ++pmu) report(aligner, pmu, 1, ALIGN_START, 0);
+    CHECK(drain_rows(aligner, 0).size() == 1);
+
+    uint64_t far = ALIGN_START + 10 * aligner.windowFrames();
+    CHECK(report(aligner, 0, 1, far, 0) == TimeAligner::Insert::Early);
+    CHECK(aligner.pmuStats(0).early.load() == 1);
+    CHECK(drain_rows(aligner, 0).empty());
+
+    CHECK(report(aligner, 0, 1, far, 0) == TimeAligner::Insert::Accepted);
+    CHECK(report(aligner, 1, 1, far, 0) == TimeAligner::Insert::Accepted);
+    CHECK(report(aligner, 1, 1, ALIGN_START + 1, 0) == TimeAligner::Insert::Late);
+    std::vector<AlignedRow> rows = drain_rows(aligner, 0);
+    CHECK(rows.size() == 1);
+    if (rows.size() == 1) CHECK(rows[0].index == far && rows[0].reported == 2);
+    CHECK(aligner.completeFrames() == 2);
+}
+
+// Ingest threads insert concurrently with the consumer draining; every frame
+// comes out once, complete, in order and with each PMU's own values.
+void time_aligner_concurrent_inserters() {
+    const size_t threads = 4, pmusPerThread = 8, pmus = threads * pmusPerThread;
+    TimeAligner aligner(std::vector<size_t>(pmus, 2), 50, 10 * int64_t(1000000000));
+    const uint64_t frames = aligner.windowFrames() / 2;  // Inside the first window: no report is early
+
+    std::atomic<size_t> running{threads};
+    std::vector<std::thread> ingest;
+    for (size_t t = 0; t < threads; ++t) {
+        ingest.emplace_back([&, t]() {
+            for (uint64_t k = ALIGN_START; k < ALIGN_START + frames; ++k)
+                for (size_t p = 0; p < pmusPerThread; ++p)
+                    report(aligner, t * pmusPerThread + p, 2, k, aligner_clock_ns());
+            running.fetch_sub(1);
+        });
+    }
+    std::vector<AlignedRow> rows;
+    while (true) {
+        bool last = running.load() == 0;
+        std::vector<AlignedRow> more = drain_rows(aligner, aligner_clock_ns());
+        rows.insert(rows.end(), more.begin(), more.end());
+        if (last) break;
+        std::this_thread::yield();
+    }
+    for (std::thread& t : ingest) t.join();
+
+    CHECK(rows.size() == frames);
+    bool ordered = true, complete = true, values = true;
+    for (size_t r = 0; r < rows.size(); ++r) {
+        uint64_t k = ALIGN_START + r;
+        ordered = ordered && rows[r].index == k;
+        complete = complete && rows[r].reported == pmus;
+        for (size_t c = 0; c < rows[r].values.size(); ++c)
+            values = values && rows[r].values[c] == double(k * 100 + c / 2);
+    }
+    CHECK(ordered && complete && values);
+    CHECK(aligner.completeFrames() == frames && aligner.partialFrames() == 0);
+    for (size_t p = 0; p < pmus; ++p) {
+        const TimeAligner::PmuStats& st = aligner.pmuStats(p);
+        CHECK(st.received.load() == frames && st.late.load() == 0 && st.early.load() == 0 && st.missing.load() == 0);
+    }
+}
+
+// Deterministic values in [lo, hi).
+struct TestRandom {
+    uint64_t state = 88172645463325252ull;
+
+    double next(double lo, double hi) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return lo + (hi - lo) * double(state >> 11) / double(uint64_t(1) << 53);
+    }
+    size_t below(size_t n) { return static_cast<size_t>(next(0, double(n))); }
+};
+
+bool brute_extrema(const ChannelStore& store, size_t channel, size_t begin, size_t end, double& lo, double& hi) {
+    end = std::min(end, store.size());
+    if (begin >= end) return false;
+    lo = hi = store.value(channel, begin);
+    for (size_t i = begin; i < end; ++i) {
+        lo = std::min(lo, store.value(channel, i));
+        hi = std::max(hi, store.value(channel, i));
+    }
+    return true;
+}
+
+// The segment tree answers like a scan over the samples after the ring has
+// wrapped, with chunks dropped and recycled under stale leaves, and for
+// windows that start and end inside blocks.
+void channel_store_extrema_match_scan() {
+    const size_t chunkBytes = ChannelStore::CHUNK_SAMPLES * (2 * sizeof(double) + sizeof(float));
+    Retention retention;
+    retention.seconds = 0;
+    retention.maxBytes = 3 * chunkBytes;
+    ChannelStore store;
+    store.configure({true, false}, 0.02, retention);
+    CHECK(store.capacity() == 3 * ChannelStore::CHUNK_SAMPLES);
+
+    // Large values first: they sit in the leaves of the chunks recycled later.
+    TestRandom random;
+    const size_t total = 2 * store.capacity() + ChannelStore::CHUNK_SAMPLES / 2 + 77;
+    for (size_t i = 0; i < total; ++i) {
+        bool old = i < store.capacity();
+        double row[2] = {random.next(old ? 1000 : -1, old ? 2000 : 1), random.next(old ? -2000 : -1, old ? -1000 : 1)};
+        store.append(i * 0.02, row);
+    }
+    CHECK(store.size() <= store.capacity() && store.firstIndex() + store.size() == total);
+    CHECK(store.firstIndex() > 0);
+
+    const size_t n = store.size(), block = ChannelStore::EXTREMA_BLOCK;
+    std::vector<std::pair<size_t, size_t>> ranges = {
+        {0, n}, {0, 1}, {n - 1, n}, {5, 5}, {n, n + 10}, {0, n + 100},
+        {block - 1, block + 1}, {block, 3 * block}, {block + 3, 40 * block - 3},
+        {ChannelStore::CHUNK_SAMPLES - 10, ChannelStore::CHUNK_SAMPLES + 10},  // Across a chunk boundary
+        {n - ChannelStore::CHUNK_SAMPLES / 2 - 5, n},                           // Into the partial last chunk
+    };
+    for (int r = 0; r < 300; ++r) {
+        size_t a = random.below(n), b = random.below(n + 1);
+        ranges.push_back({std::min(a, b), std::max(a, b)});
+    }
+    size_t mismatches = 0;
+    for (const auto& range : ranges) {
+        for (size_t c = 0; c < store.channelCount(); ++c) {
+            double lo = 0, hi = 0, expectLo = 0, expectHi = 0;
+            bool found = store.extrema(c, range.first, range.second, lo, hi);
+            bool expected = brute_extrema(store, c, range.first, range.second, expectLo, expectHi);
+            if (found != expected || (found && (lo != expectLo || hi != expectHi))) ++mismatches;
+        }
+    }
+    CHECK(mismatches == 0);
+    double lo = 0, hi = 0;
+    CHECK(store.extrema(0, 0, n, lo, hi) && lo >= -1 && hi < 1);  // Nothing left from the recycled chunks
+}
+
+// The monotonic queues track the extrema of the last N values like a scan.
+void sliding_extrema_match_scan() {
+    TestRandom random;
+    for (size_t window : {1, 5, 64}) {
+        SlidingExtrema extrema;
+        extrema.reset(window);
+        CHECK(extrema.empty() && !extrema.full() && extrema.window() == window);
+        std::vector<double> values;
+        size_t mismatches = 0;
+        for (size_t i = 0; i < 2000; ++i) {
+            // Random values, then ramps that keep every candidate queued.
+            double v = i < 1000 ? random.next(-10, 10) : i < 1500 ? double(i) : -double(i);
+            values.push_back(v);
+            extrema.push(v);
+            size_t from = values.size() > window ? values.size() - window : 0;
+            double lo = *std::min_element(values.begin() + from, values.end());
+            double hi = *std::max_element(values.begin() + from, values.end());
+            if (extrema.min() != lo || extrema.max() != hi || extrema.full() != (values.size() >= window))
+                ++mismatches;
+        }
+        CHECK(mismatches == 0);
+
+        extrema.reset(window);
+        extrema.push(42.0);
+        CHECK(!extrema.empty() && extrema.min() == 42.0 && extrema.max() == 42.0);
+    }
+}
+
+struct TestCase {
+    const char* name;
+    void (*run)();
+};
+
+const TestCase TESTS[] = {
+    {"framer_coalesced_and_split", framer_coalesced_and_split},
+    {"framer_skips_garbage", framer_skips_garbage},
+    {"framer_bad_chk_skips_one_byte", framer_bad_chk_skips_one_byte},
+    {"framer_frame_wraps_ring", framer_frame_wraps_ring},
+    {"cfg2_digitals_round_trip", cfg2_digitals_round_trip},
+    {"deadline_timer_without_descriptor", deadline_timer_without_descriptor},
+    {"publish_in_place_references_storage", publish_in_place_references_storage},
+    {"config_frame_restamped", config_frame_restamped},
+    {"command_kinds_from_received_word", command_kinds_from_received_word},
+    {"commands_for_unhosted_pmu_rejected", commands_for_unhosted_pmu_rejected},
+    {"udp_destinations_get_their_pmus", udp_destinations_get_their_pmus},
+    {"lagging_reader_queue_stays_bounded", lagging_reader_queue_stays_bounded},
+    {"time_aligner_rows_in_order", time_aligner_rows_in_order},
+    {"time_aligner_late_report", time_aligner_late_report},
+    {"time_aligner_wait_timeout", time_aligner_wait_timeout},
+    {"time_aligner_window_jump", time_aligner_window_jump},
+    {"time_aligner_concurrent_inserters", time_aligner_concurrent_inserters},
+    {"channel_store_extrema_match_scan", channel_store_extrema_match_scan},
+    {"sliding_extrema_match_scan", sliding_extrema_match_scan},
+};
+
+} // namespace
+
+int main(int argc, char** argv) {
+    const char* filter = argc > 1 ? argv[1] : "";
+    int run = 0;
+    for (const TestCase& test : TESTS) {
+        if (!std::strstr(test.name, filter)) continue;
+        int before = failures;
+        test.run();
+        std::fprintf(stderr, "%s %s\n", failures == before ? "PASS" : "FAIL", test.name);
+        ++run;
+    }
+    std::fprintf(stderr, "%d test(s), %d failed check(s)\n", run, failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,13 @@
+# Regression tests of the simulator and the header-only modules (see
+# sim_tests.cpp), a console program without Qt. Run ./sim_tests.
+TEMPLATE = app
+CONFIG += c++17 console
+CONFIG -= app_bundle qt
+
+TARGET = sim_tests
+INCLUDEPATH += ..
+unix: LIBS += -lpthread
+win32: LIBS += -lws2_32
+
+SOURCES += \
+    sim_tests.cpp \
@@ -0,0 +1,306 @@
+#ifndef TIME_ALIGNER_H
+#define TIME_ALIGNER_H
+
+// Time alignment of many PMU streams into combined rows, the core of the
+// concentrator.
+//
+// Reports are bucketed by frame index, round(timestamp * rate), into a ring
+// of slots; slot k % N holds frame k while k lies in the window of N frames
+// starting at the oldest one not yet emitted. Each PMU owns a fixed block of
+// columns in a slot's row. Any number of ingest threads insert() reports
+// concurrently without locks: a writer pins the slot with one CAS on its
+// state word (frame index, closed flag, writers in flight), fills its own
+// block, sets its bit and unpins. The single consumer calls drain(), which
+// takes slots in frame order and hands out a row as soon as every PMU has
+// reported, or once the wait time has passed since the first report of that
+// frame, so the added latency is bounded by the wait plus the drain period.
+// Emitting closes the slot (later reports of that frame count as late),
+// waits for writers still in flight, which only copy a block, and reassigns
+// the slot to the frame N later.
+//
+// A PMU missing from an emitted row keeps its previous values in the row and
+// is counted as missing. Frames beyond the window are dropped as early; a
+// report more than N frames ahead advances the window, emitting what it
+// holds.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+// Clock of the insert() and drain() timestamps.
+inline int64_t aligner_clock_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+class TimeAligner
+{
+public:
+    enum class Insert { Accepted, Late, Early, Duplicate };
+
+    // Per-PMU counters, written by the ingest threads and the consumer.
+    struct alignas(64) PmuStats {
+        std::atomic<uint64_t> received{0};   // Accepted reports
+        std::atomic<uint64_t> late{0};       // Arrived after their frame was emitted
+        std::atomic<uint64_t> missing{0};    // Frames emitted without this PMU
+        std::atomic<uint64_t> early{0};      // Ahead of the window, dropped
+        std::atomic<uint64_t> duplicate{0};  // Second report of one frame
+    };
+
+    // widths[i] values per report of PMU i; a frame is waited for at most
+    // waitNs after its first report.
+    TimeAligner(const std::vector<size_t>& widths, uint32_t framesPerSecond, int64_t waitNs)
+        : rate(std::max<uint32_t>(1, framesPerSecond)), wait(waitNs), stats(widths.size()) {
+        for (size_t w : widths) {
+            offsets.push_back(width);
+            blockWidths.push_back(w);
+            width += w;
+        }
+        // Room for two wait periods of frames plus reordering slack.
+        size_t frames = static_cast<size_t>(waitNs / (1000000000 / rate) + 1);
+        slotCount = 16;
+        while (slotCount < 2 * frames + 8) slotCount <<= 1;
+        words = (widths.size() + 63) / 64;
+        slots.reset(new Slot[slotCount]);
+        for (size_t s = 0; s < slotCount; ++s) {
+            slots[s].present.reset(new std::atomic<uint64_t>[words]);
+            for (size_t w = 0; w < words; ++w) slots[s].present[w].store(0, std::memory_order_relaxed);
+            slots[s].row.assign(width, 0.0);
+        }
+        lastRow.assign(width, 0.0);
+    }
+
+    TimeAligner(const TimeAligner&) = delete;
+    TimeAligner& operator=(const TimeAligner&) = delete;
+
+    size_t pmuCount() const { return stats.size(); }
+    size_t rowWidth() const { return width; }
+    uint32_t framesPerSecond() const { return rate; }
+    size_t windowFrames() const { return slotCount; }
+    const PmuStats& pmuStats(size_t pmu) const { return stats[pmu]; }
+
+    // Frame index of a SOC/FRACSEC timestamp, rounded to the nearest frame.
+    uint64_t frameIndex(uint32_t soc, uint32_t fracsec, uint32_t timeBase) const {
+        return uint64_t(soc) * rate + (uint64_t(fracsec) * rate + timeBase / 2) / timeBase;
+    }
+
+    double frameSeconds(uint64_t index) const {
+        return static_cast<double>(index / rate) + static_cast<double>(index % rate) / rate;
+    }
+
+    // Any thread. fill(double* block) writes the PMU's widths[pmu] values.
+    template <typename Fill>
+    Insert insert(size_t pmu, uint64_t index, int64_t nowNs, Fill fill) {
+        PmuStats& st = stats[pmu];
+        uint64_t base = origin.load(std::memory_order_acquire);
+        if (base == UNSET) {
+            uint64_t first = index > slotCount / 4 ? index - slotCount / 4 : 0;
+            origin.compare_exchange_strong(base, first, std::memory_order_acq_rel);
+            base = origin.load(std::memory_order_acquire);
+        }
+        uint64_t seen = highest.load(std::memory_order_relaxed);
+        while (index > seen && !highest.compare_exchange_weak(seen, index, std::memory_order_relaxed)) {}
+        if (index < base) {
+            st.late.fetch_add(1, std::memory_order_relaxed);
+            return Insert::Late;
+        }
+
+        Slot& slot = slots[index & (slotCount - 1)];
+        uint64_t state = slot.state.load(std::memory_order_acquire);
+        while (true) {
+            if (state == UNASSIGNED) {
+                slot.state.compare_exchange_strong(state, pack(firstIndexOf(index & (slotCount - 1), base)),
+                                                   std::memory_order_acq_rel);
+                state = slot.state.load(std::memory_order_acquire);
+                continue;
+            }
+            uint64_t tag = state >> TAG_SHIFT;
+            if (tag > index || (tag == index && (state & CLOSED))) {
+                st.late.fetch_add(1, std::memory_order_relaxed);
+                return Insert::Late;
+            }
+            if (tag < index) {
+                st.early.fetch_add(1, std::memory_order_relaxed);
+                return Insert::Early;
+            }
+            if (slot.state.compare_exchange_weak(state, state + 1, std::memory_order_acquire))
+                break;
+        }
+
+        uint64_t bit = uint64_t(1) << (pmu & 63);
+        if (slot.present[pmu >> 6].fetch_or(bit, std::memory_order_relaxed) & bit) {
+            slot.state.fetch_sub(1, std::memory_order_release);
+            st.duplicate.fetch_add(1, std::memory_order_relaxed);
+            return Insert::Duplicate;
+        }
+        fill(slot.row.data() + offsets[pmu]);
+        int64_t none = 0;
+        slot.firstReportNs.compare_exchange_strong(none, nowNs, std::memory_order_relaxed);
+        slot.reported.fetch_add(1, std::memory_order_relaxed);
+        slot.state.fetch_sub(1, std::memory_order_release);
+        st.received.fetch_add(1, std::memory_order_relaxed);
+        return Insert::Accepted;
+    }
+
+    // Consumer only. Calls f(seconds, row, reported) for every frame that is
+    // complete or has waited long enough, oldest first; returns the count.
+    template <typename F>
+    size_t drain(int64_t nowNs, F f) {
+        uint64_t base = origin.load(std::memory_order_acquire);
+        if (base == UNSET) return 0;
+        if (next == UNSET) next = base;
+
+        size_t emitted = 0;
+        while (true) {
+            // A report far ahead of the window (a gap, a clock step) moves the
+            // window up to it instead of walking every frame in between.
+            uint64_t top = highest.load(std::memory_order_relaxed);
+            if (top >= next + 2 * slotCount) {
+                for (size_t i = 0; i < slotCount; ++i, ++next)
+                    emitted += close(next, nowNs, f, false);
+                next = top - slotCount / 4;
+                for (size_t s = 0; s < slotCount; ++s) {
+                    seal(slots[s]);
+                    reassign(slots[s], firstIndexOf(s, next));
+                }
+                continue;
+            }
+
+            // Frames are emitted in order, so the oldest frame with reports
+            // decides; empty frames before it go with it.
+            uint64_t due = UNSET;
+            for (uint64_t k = next; k < next + slotCount; ++k) {
+                Slot& slot = slotAt(k);
+                size_t reported = slot.reported.load(std::memory_order_relaxed);
+                if (reported == 0) continue;
+                bool timedOut = nowNs - slot.firstReportNs.load(std::memory_order_relaxed) >= wait;
+                if (reported >= stats.size() || timedOut || top >= k + slotCount) due = k;
+                break;
+            }
+            if (due == UNSET) {
+                if (top < next + slotCount) return emitted;
+                due = next;  // The window is full of empty frames
+            }
+            for (; next <= due; ++next)
+                emitted += close(next, nowNs, f);
+        }
+    }
+
+    uint64_t completeFrames() const { return complete; }
+    uint64_t partialFrames() const { return partial; }
+    uint64_t emptyFrames() const { return empty; }
+    int64_t maxLatencyNs() const { return latencyMax; }
+    double meanLatencyNs() const { return latencyCount ? double(latencySum) / latencyCount : 0.0; }
+    void resetLatency() {
+        latencyMax = 0;
+        latencySum = 0;
+        latencyCount = 0;
+    }
+
+private:
+    static const uint64_t UNSET = ~uint64_t(0);
+    static const uint64_t UNASSIGNED = ~uint64_t(0);
+    static const int TAG_SHIFT = 17;
+    static const uint64_t CLOSED = uint64_t(1) << 16;
+    static const uint64_t WRITERS = CLOSED - 1;
+
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> state{UNASSIGNED};  // Frame index << 17 | closed << 16 | writers
+        std::atomic<size_t> reported{0};
+        std::atomic<int64_t> firstReportNs{0};
+        std::unique_ptr<std::atomic<uint64_t>[]> present;  // Bit per PMU
+        std::vector<double> row;
+    };
+
+    static uint64_t pack(uint64_t index) { return index << TAG_SHIFT; }
+
+    // Frame held by slot s in the window starting at frame start.
+    uint64_t firstIndexOf(size_t s, uint64_t start) const {
+        uint64_t k = start - (start & (slotCount - 1)) + s;
+        return k < start ? k + slotCount : k;
+    }
+
+    Slot& slotAt(uint64_t index) {
+        Slot& slot = slots[index & (slotCount - 1)];
+        uint64_t state = UNASSIGNED;
+        slot.state.compare_exchange_strong(state, pack(index), std::memory_order_acq_rel);
+        return slot;
+    }
+
+    // Emits frame index if anything reported it and hands the slot on to the
+    // frame slotCount later. Returns 1 if a row was emitted.
+    template <typename F>
+    size_t close(uint64_t index, int64_t nowNs, F& f, bool countEmpty = true) {
+        Slot& slot = slotAt(index);
+        if ((slot.state.load(std::memory_order_relaxed) >> TAG_SHIFT) != index) return 0;  // Only the consumer retags
+        seal(slot);
+
+        size_t reported = slot.reported.load(std::memory_order_relaxed);
+        if (reported > 0) {
+            for (size_t p = 0; p < stats.size(); ++p) {
+                if (slot.present[p >> 6].load(std::memory_order_relaxed) & (uint64_t(1) << (p & 63)))
+                    std::memcpy(lastRow.data() + offsets[p], slot.row.data() + offsets[p],
+                                blockWidths[p] * sizeof(double));
+                else
+                    stats[p].missing.fetch_add(1, std::memory_order_relaxed);
+            }
+            int64_t latency = nowNs - slot.firstReportNs.load(std::memory_order_relaxed);
+            latencyMax = std::max(latencyMax, latency);
+            latencySum += latency;
+            ++latencyCount;
+            ++(reported >= stats.size() ? complete : partial);
+            f(frameSeconds(index), static_cast<const double*>(lastRow.data()), reported);
+            started = true;
+        }
+        else if (started && countEmpty) {  // Not the slack before the first report, nor a gap
+            ++empty;
+            for (PmuStats& st : stats) st.missing.fetch_add(1, std::memory_order_relaxed);
+        }
+        reassign(slot, index + slotCount);
+        return reported > 0 ? 1 : 0;
+    }
+
+    // Turns later writers away and waits for those in flight.
+    static void seal(Slot& slot) {
+        uint64_t state = slot.state.fetch_or(CLOSED, std::memory_order_acq_rel);
+        while (state & WRITERS)
+            state = slot.state.load(std::memory_order_acquire);
+    }
+
+    void reassign(Slot& slot, uint64_t index) {
+        for (size_t w = 0; w < words; ++w) slot.present[w].store(0, std::memory_order_relaxed);
+        slot.reported.store(0, std::memory_order_relaxed);
+        slot.firstReportNs.store(0, std::memory_order_relaxed);
+        slot.state.store(pack(index), std::memory_order_release);
+    }
+
+    uint32_t rate;
+    int64_t wait;
+    size_t width = 0;
+    size_t words = 0;
+    size_t slotCount = 0;
+    std::vector<size_t> offsets;       // First column of each PMU's block
+    std::vector<size_t> blockWidths;
+    std::vector<PmuStats> stats;
+    std::unique_ptr<Slot[]> slots;
+    alignas(64) std::atomic<uint64_t> origin{UNSET};   // First frame of the initial window
+    alignas(64) std::atomic<uint64_t> highest{0};      // Newest frame index reported
+
+    // Consumer only.
+    uint64_t next = UNSET;             // Oldest frame not emitted
+    std::vector<double> lastRow;
+    bool started = false;
+    uint64_t complete = 0;
+    uint64_t partial = 0;
+    uint64_t empty = 0;
+    int64_t latencyMax = 0;
+    int64_t latencySum = 0;
+    uint64_t latencyCount = 0;
+};
+
+#endif // TIME_ALIGNER_H
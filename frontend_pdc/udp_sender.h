@@ -0,0 +1,193 @@
+#ifndef UDP_SENDER_H
+#define UDP_SENDER_H
+
+// Batched UDP transmitter for C37.118.2 data frames.
+//
+// Frames are queued by pointer during a reporting tick, tagged with the index
+// of the PMU they belong to, and flush() sends each of them to every
+// destination (unicast or multicast) that wants that PMU. On Linux the whole
+// frames x destinations matrix goes out through sendmmsg() in as few system
+// calls as possible; other platforms fall back to one sendto() per datagram.
+// Queued frame buffers must stay valid until flush() returns.
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+#include "socket_compat.h"
+
+#ifdef __linux__
+#include <sys/uio.h>
+#endif
+
+inline bool same_endpoint(const sockaddr_in& a, const sockaddr_in& b) {
+    return a.sin_addr.s_addr == b.sin_addr.s_addr && a.sin_port == b.sin_port;
+}
+
+class UdpDataSender
+{
+public:
+    UdpDataSender() = default;
+    ~UdpDataSender() { close(); }
+
+    UdpDataSender(const UdpDataSender&) = delete;
+    UdpDataSender& operator=(const UdpDataSender&) = delete;
+
+    // bindPort 0 binds an ephemeral port. multicastTtl applies to multicast
+    // destinations only.
+    bool open(uint16_t bindPort, int multicastTtl) {
+        sock = ::socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        if (sock == INVALID_SOCKET) return false;
+
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = INADDR_ANY;
+        addr.sin_port = htons(bindPort);
+        if (bind(sock, (struct sockaddr*)&addr, sizeof(addr)) == SOCKET_ERROR) {
+            close();
+            return false;
+        }
+
+        // Room for a full tick of frames so a burst is not dropped locally.
+        int sndbuf = 4 * 1024 * 1024;
+        setsockopt(sock, SOL_SOCKET, SO_SNDBUF, reinterpret_cast<const char*>(&sndbuf), sizeof(sndbuf));
+
+#ifdef _WIN32
+        DWORD ttl = static_cast<DWORD>(multicastTtl);
+#else
+        unsigned char ttl = static_cast<unsigned char>(multicastTtl);
+#endif
+        setsockopt(sock, IPPROTO_IP, IP_MULTICAST_TTL, reinterpret_cast<const char*>(&ttl), sizeof(ttl));
+        return true;
+    }
+
+    void close() {
+        if (sock != INVALID_SOCKET) {
+            closesocket(sock);
+            sock = INVALID_SOCKET;
+        }
+    }
+
+    SOCKET socket() const { return sock; }
+
+    // Sends every PMU's frames to addr, or only those of the PMU indices set
+    // in pmus when it is given. Adding an existing destination replaces its
+    // PMU selection.
+    void addDestination(const sockaddr_in& addr, const std::vector<char>& pmus = {}) {
+        auto it = std::find_if(destinations.begin(), destinations.end(),
+                               [&](const Destination& d) { return same_endpoint(d.addr, addr); });
+        if (it == destinations.end())
+            destinations.push_back({addr, pmus});
+        else
+            it->pmus = pmus;
+    }
+
+    void removeDestination(const sockaddr_in& addr) {
+        destinations.erase(std::remove_if(destinations.begin(), destinations.end(),
+                                          [&](const Destination& d) { return same_endpoint(d.addr, addr); }),
+                           destinations.end());
+    }
+
+    size_t destinationCount() const { return destinations.size(); }
+
+    void queue(const unsigned char* data, size_t len, size_t pmuIndex) {
+        pending.push_back({data, len, pmuIndex});
+    }
+
+    // Sends every queued frame to every destination that wants its PMU.
+    // Returns the number of datagrams handed to the kernel; failures are
+    // added to sendErrors(). flushedBytes() is what they carried together.
+    size_t flush() {
+        size_t sent = 0;
+        lastBytes = 0;
+        if (sock == INVALID_SOCKET || destinations.empty()) {
+            pending.clear();
+            return 0;
+        }
+
+#ifdef __linux__
+        iovs.resize(pending.size() * destinations.size());
+        msgs.resize(iovs.size());
+        size_t m = 0;
+        for (const auto& frame : pending) {
+            for (auto& dest : destinations) {
+                if (!dest.wants(frame.pmuIndex)) continue;
+                lastBytes += frame.len;
+                iovs[m].iov_base = const_cast<unsigned char*>(frame.data);
+                iovs[m].iov_len = frame.len;
+                std::memset(&msgs[m], 0, sizeof(mmsghdr));
+                msgs[m].msg_hdr.msg_name = &dest.addr;
+                msgs[m].msg_hdr.msg_namelen = sizeof(dest.addr);
+                msgs[m].msg_hdr.msg_iov = &iovs[m];
+                msgs[m].msg_hdr.msg_iovlen = 1;
+                ++m;
+            }
+        }
+
+        const size_t total = m;
+        size_t offset = 0;
+        while (offset < total) {
+            unsigned int batch = static_cast<unsigned int>(std::min<size_t>(total - offset, MAX_BATCH));
+            int n = sendmmsg(sock, &msgs[offset], batch, 0);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                // Skip the datagram the kernel refused and keep going.
+                ++errors;
+                ++offset;
+                continue;
+            }
+            offset += static_cast<size_t>(n);
+            sent += static_cast<size_t>(n);
+        }
+#else
+        for (const auto& frame : pending) {
+            for (const auto& dest : destinations) {
+                if (!dest.wants(frame.pmuIndex)) continue;
+                lastBytes += frame.len;
+                int n = sendto(sock, reinterpret_cast<const char*>(frame.data), static_cast<int>(frame.len), 0,
+                               reinterpret_cast<const sockaddr*>(&dest.addr), sizeof(dest.addr));
+                if (n == SOCKET_ERROR)
+                    ++errors;
+                else
+                    ++sent;
+            }
+        }
+#endif
+        pending.clear();
+        return sent;
+    }
+
+    size_t sendErrors() const { return errors; }
+    size_t flushedBytes() const { return lastBytes; }
+
+private:
+    struct Destination {
+        sockaddr_in addr;
+        std::vector<char> pmus;  // Per PMU index: wanted; empty = every PMU
+
+        bool wants(size_t pmuIndex) const {
+            return pmus.empty() || (pmuIndex < pmus.size() && pmus[pmuIndex]);
+        }
+    };
+
+    struct PendingFrame {
+        const unsigned char* data;
+        size_t len;
+        size_t pmuIndex;
+    };
+
+    SOCKET sock = INVALID_SOCKET;
+    std::vector<Destination> destinations;
+    std::vector<PendingFrame> pending;
+    size_t errors = 0;
+    size_t lastBytes = 0;
+
+#ifdef __linux__
+    static constexpr size_t MAX_BATCH = 1024; // UIO_MAXIOV
+    std::vector<mmsghdr> msgs;
+    std::vector<iovec> iovs;
+#endif
+};
+
+#endif // UDP_SENDER_H